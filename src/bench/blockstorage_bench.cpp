@@ -0,0 +1,75 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/nwchunk.h>
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+// Block read latency of the chunk's palette storage against a flat array, for palettes of each index width,
+// in x-major order (as meshing reads) and in random order (as scattered World::getBlock calls do).
+// Usage: blockstorage_bench
+
+namespace
+{
+    constexpr size_t Count = Chunk::Size() * Chunk::Size() * Chunk::Size();
+    using Storage = PalettedBlockStorage<Count>;
+
+    template <class Get>
+    double nsPerRead(const std::vector<uint32_t>& order, Get get)
+    {
+        using namespace std::chrono;
+        uint32_t sum = 0;
+        const auto start = steady_clock::now();
+        // Each index depends on the previous read, so reads cannot overlap and loop invariant loads cannot be hoisted
+        for (int round = 0; round < 32; ++round)
+            for (auto index : order)
+                sum += get((index ^ (sum & 1)) & (Count - 1)).getData();
+        const double ns = duration<double, std::nano>(steady_clock::now() - start).count() / (order.size() * 32.0);
+        // Keep the reads
+        if (sum == 0x12345678)
+            std::printf(" ");
+        return ns;
+    }
+}
+
+int main()
+{
+    std::vector<uint32_t> sequential(Count), shuffled(Count);
+    for (uint32_t i = 0; i < Count; ++i)
+        sequential[i] = shuffled[i] = i;
+    std::mt19937 rng(1);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    std::printf("distinct  bits  KiB   storage seq  flat seq  storage random  flat random  (ns per read)\n");
+    for (uint32_t distinct : { 1u, 2u, 12u, 200u, 1000u })
+    {
+        std::vector<BlockData> flat(Count);
+        for (auto&& block : flat)
+            block = BlockData(rng() % distinct + 1);
+        Storage storage;
+        storage.assign(flat.data());
+        std::printf("%8u  %4d  %3zu  %11.2f  %8.2f  %14.2f  %11.2f\n", distinct, storage.getBitsPerBlock(), storage.getMemoryUsage() / 1024,
+                    nsPerRead(sequential, [&](uint32_t i) { return storage.get(i); }),
+                    nsPerRead(sequential, [&](uint32_t i) { return flat[i]; }),
+                    nsPerRead(shuffled, [&](uint32_t i) { return storage.get(i); }),
+                    nsPerRead(shuffled, [&](uint32_t i) { return flat[i]; }));
+    }
+    return 0;
+}
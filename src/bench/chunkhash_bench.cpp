@@ -0,0 +1,104 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/nwchunk.h>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+
+// Shard load spread, probe length and lookup latency of the chunk map under both chunk hashes, for
+// player-centred chunk cubes of radius 4 to 32 away from the origin, as sortChunkLoadUnloadList loads them.
+// Lookups run in shuffled order; misses look just above the cube.
+// Usage: chunkhash_bench [max radius]
+
+namespace
+{
+    struct Entry
+    {
+        Vec3i pos;
+        const Vec3i& getPosition() const noexcept { return pos; }
+    };
+
+    struct Release
+    {
+        void operator()(Entry* entry) const { delete entry; }
+    };
+
+    template <class Lookup>
+    double nsPerLookup(const std::vector<Vec3i>& positions, Lookup lookup)
+    {
+        using namespace std::chrono;
+        const int rounds = int(std::max<size_t>(1, (1 << 22) / positions.size()));
+        size_t found = 0;
+        const auto start = steady_clock::now();
+        for (int round = 0; round < rounds; ++round)
+            for (auto&& pos : positions)
+                found += lookup(pos) != nullptr;
+        const double ns = duration<double, std::nano>(steady_clock::now() - start).count() / (double(positions.size()) * rounds);
+        if (found == 1)
+            std::printf(" ");
+        return ns;
+    }
+
+    template <class Hasher>
+    void measure(const char* name, const Vec3i& center, int maxRadius)
+    {
+        std::printf("%s\nradius   chunks  shard load min/avg/max  avg probe  hit ns  miss ns\n", name);
+        for (int radius = 4; radius <= maxRadius; radius *= 2)
+        {
+            ConcurrentChunkMap<Entry, Release, Hasher> map(1024);
+            std::vector<Vec3i> positions, misses;
+            for (int x = -radius; x <= radius; x++)
+                for (int y = -radius; y <= radius; y++)
+                    for (int z = -radius; z <= radius; z++)
+                    {
+                        positions.push_back(center + Vec3i(x, y, z));
+                        map.insert(positions.back(), new Entry{ positions.back() }, Release());
+                        misses.push_back(positions.back() + Vec3i(0, 2 * radius + 1, 0));
+                    }
+            std::mt19937 rng(radius);
+            std::shuffle(positions.begin(), positions.end(), rng);
+            std::shuffle(misses.begin(), misses.end(), rng);
+
+            size_t shards = 0, live = 0, probes = 0, minLoad = SIZE_MAX, maxLoad = 0;
+            map.forEachShardStats([&](size_t, size_t, size_t entries, size_t probeSum)
+            {
+                ++shards;
+                live += entries;
+                probes += probeSum;
+                minLoad = std::min(minLoad, entries);
+                maxLoad = std::max(maxLoad, entries);
+            });
+            const double hit = nsPerLookup(positions, [&](const Vec3i& pos) { return map.find(pos); });
+            const double miss = nsPerLookup(misses, [&](const Vec3i& pos) { return map.find(pos); });
+            std::printf("%6d  %7zu  %6zu/%6.0f/%6zu  %9.2f  %6.1f  %7.1f\n", radius, live, minLoad, double(live) / shards, maxLoad,
+                        double(probes) / live, hit, miss);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int maxRadius = argc > 1 ? std::atoi(argv[1]) : 32;
+    const Vec3i center(1000, 4, -1000);
+    measure<LinearChunkHasher>("LinearChunkHasher", center, maxRadius);
+    measure<MixedChunkHasher>("MixedChunkHasher", center, maxRadius);
+    return 0;
+}
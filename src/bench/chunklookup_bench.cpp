@@ -0,0 +1,93 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <plugin/pluginmanager.h>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// World::getBlock throughput for random block positions around a player, resolving the chunk through
+// the chunk map alone and through the player's chunk pointer array first. The third column unloads and
+// reloads a chunk every `churn` lookups, which invalidates the whole array, as a moving player does.
+// Usage: chunklookup_bench [lookups] [churn]
+
+namespace
+{
+    // Million getBlock calls per second over `blocks`. churn (0 = none) unloads and reloads a chunk every churn calls.
+    template <class Lookup>
+    double rate(World& world, const std::vector<Vec3i>& blocks, size_t churn, Lookup lookup)
+    {
+        using namespace std::chrono;
+        size_t sum = 0;
+        const auto start = steady_clock::now();
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            if (churn && i % churn == churn - 1)
+            {
+                const Vec3i pos = World::getChunkPos(blocks[i]);
+                world.deleteChunk(pos);
+                world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world, BlockData(1, 0, 0))));
+            }
+            sum += lookup(blocks[i]).getID();
+        }
+        const double seconds = duration<double>(steady_clock::now() - start).count();
+        world.getChunks().collect();
+        if (sum == 0)
+            std::abort();
+        return blocks.size() / seconds / 1e6;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t lookups = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : (1 << 22);
+    const size_t churn = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    PluginManager plugins;
+    BlockManager blocks;
+    std::printf("radius  chunks  map only  pointer array  with churn  (M getBlock/s, churn every %zu)\n", churn);
+    for (int radius : { 2, 4, 8, ChunkManager::Cache::Radius })
+    {
+        World world("bench", plugins, blocks);
+        const Vec3i center(1000, 4, -1000);
+        std::mt19937 random(1);
+        for (int x = -radius; x <= radius; x++)
+            for (int y = -radius; y <= radius; y++)
+                for (int z = -radius; z <= radius; z++)
+                {
+                    const Vec3i pos = center + Vec3i(x, y, z);
+                    Chunk* chunk = world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world, BlockData(1, 0, 0))));
+                    // Not uniform, so reads go through the packed storage
+                    for (int i = 0; i < 64; ++i)
+                        chunk->setBlock(Vec3i(random() % Chunk::Size(), random() % Chunk::Size(), random() % Chunk::Size()), BlockData(2, 0, 0));
+                }
+        std::vector<Vec3i> positions(lookups);
+        const int range = (2 * radius + 1) * Chunk::Size();
+        for (auto&& pos : positions)
+            pos = (center - Vec3i(radius)) * Chunk::Size() + Vec3i(random() % range, random() % range, random() % range);
+        ChunkManager::Cache cache;
+        cache.setCenter(center);
+        const double map = rate(world, positions, 0, [&](const Vec3i& pos) { return world.getBlock(pos); });
+        const double cached = rate(world, positions, 0, [&](const Vec3i& pos) { return world.getBlock(pos, cache); });
+        const double churned = rate(world, positions, churn, [&](const Vec3i& pos) { return world.getBlock(pos, cache); });
+        std::printf("%6d  %6zu  %8.1f  %13.1f  %10.1f\n", radius, world.getChunkCount(), map, cached, churned);
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/nwchunk.h>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+// Chunk map lookup throughput for a player-centred chunk set, with readers racing a writer that keeps
+// loading and unloading chunks at the edge of the set. Compared against an unordered_map behind a mutex.
+// chunkhash_bench covers single threaded lookup latency and shard load.
+// Usage: chunkmap_bench [radius] [max reader threads]
+
+namespace
+{
+    struct Entry
+    {
+        Vec3i pos;
+        const Vec3i& getPosition() const noexcept { return pos; }
+    };
+
+    struct Release
+    {
+        void operator()(Entry* entry) const { delete entry; }
+    };
+
+    using Map = ConcurrentChunkMap<Entry, Release, ChunkHasher>;
+
+    class LockedMap
+    {
+    public:
+        Entry* find(const Vec3i& pos) const
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto iter = mMap.find(pos);
+            return iter == mMap.end() ? nullptr : iter->second.get();
+        }
+        void insert(const Vec3i& pos, Entry* entry)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mMap[pos].reset(entry);
+        }
+        void erase(const Vec3i& pos)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mMap.erase(pos);
+        }
+        void collect() {}
+    private:
+        mutable std::mutex mMutex;
+        std::unordered_map<Vec3i, std::unique_ptr<Entry>, ChunkHasher> mMap;
+    };
+
+    void insert(Map& map, const Vec3i& pos) { map.insert(pos, new Entry{ pos }, Release()); }
+    void insert(LockedMap& map, const Vec3i& pos) { map.insert(pos, new Entry{ pos }); }
+
+    // Loads every chunk within radius of center, returns the positions shuffled
+    template <class M>
+    std::vector<Vec3i> fill(M& map, const Vec3i& center, int radius)
+    {
+        std::vector<Vec3i> positions;
+        for (int x = -radius; x <= radius; x++)
+            for (int y = -radius; y <= radius; y++)
+                for (int z = -radius; z <= radius; z++)
+                {
+                    positions.push_back(center + Vec3i(x, y, z));
+                    insert(map, positions.back());
+                }
+        std::shuffle(positions.begin(), positions.end(), std::mt19937(1));
+        return positions;
+    }
+
+    // Million lookups per second summed over `readers` threads, while one writer unloads and reloads
+    // the chunks of the outermost shell one at a time, collecting after each
+    template <class M>
+    double throughput(M& map, const std::vector<Vec3i>& positions, const Vec3i& center, int radius, int readers)
+    {
+        using namespace std::chrono;
+        std::vector<Vec3i> shell;
+        for (auto&& pos : positions)
+            if (center.chebyshevDistance(pos) == radius)
+                shell.push_back(pos);
+        std::atomic<bool> stop{ false };
+        std::atomic<size_t> lookups{ 0 };
+        std::thread writer([&]
+        {
+            for (size_t i = 0; !stop; i = (i + 1) % shell.size())
+            {
+                map.erase(shell[i]);
+                map.collect();
+                insert(map, shell[i]);
+            }
+        });
+        std::vector<std::thread> threads;
+        const auto start = steady_clock::now();
+        for (int t = 0; t < readers; ++t)
+            threads.emplace_back([&, t]
+            {
+                size_t count = 0, hits = 0;
+                for (size_t i = t * 7919; !stop;)
+                {
+                    // Pinned per batch, as a reader would be for one unit of work
+                    EpochReclaimer::Guard guard;
+                    for (size_t end = count + 256; count < end; i = (i + 1) % positions.size(), ++count)
+                        hits += map.find(positions[i]) != nullptr;
+                }
+                lookups += count;
+                if (hits == 0)
+                    std::abort();
+            });
+        std::this_thread::sleep_for(milliseconds(500));
+        stop = true;
+        for (auto&& thread : threads)
+            thread.join();
+        writer.join();
+        return lookups / duration<double>(steady_clock::now() - start).count() / 1e6;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int radius = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int maxReaders = argc > 2 ? std::atoi(argv[2]) : std::max(1, int(std::thread::hardware_concurrency()));
+    const Vec3i center(1000, 4, -1000);
+
+    Map map(1024);
+    auto positions = fill(map, center, radius);
+    LockedMap locked;
+    fill(locked, center, radius);
+    std::printf("readers  chunk map  locked unordered_map  (M lookups/s, one writer unloading and reloading)\n");
+    for (int readers = 1; readers <= maxReaders; readers *= 2)
+        std::printf("%7d  %9.1f  %20.1f\n", readers, throughput(map, positions, center, radius, readers),
+                    throughput(locked, positions, center, radius, readers));
+    return 0;
+}
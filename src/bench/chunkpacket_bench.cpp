@@ -0,0 +1,174 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <plugin/pluginmanager.h>
+#include <network/chunkpacket.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "terrain.h"
+
+// Chunk packets of generated terrain: bytes and ns per chunk encoding and decoding the way the connections did
+// before ChunkPacket and through it, then packet size, compression ratio and throughput of each codec over the
+// chunks that aren't uniform. Every packet is decoded and checked against its chunk.
+// Usage: chunkpacket_bench [chunks]
+
+namespace
+{
+    constexpr size_t BlockCount = Chunk::Size() * Chunk::Size() * Chunk::Size();
+
+    double ns(std::chrono::steady_clock::duration time, double count)
+    {
+        return std::chrono::duration<double, std::nano>(time).count() / count;
+    }
+
+    bool sameBlocks(const Chunk& a, const Chunk* b)
+    {
+        static std::vector<BlockData> expected(BlockCount), actual(BlockCount);
+        if (!b || a.getPosition() != b->getPosition())
+            return false;
+        a.getBlocks(expected.data());
+        b->getBlocks(actual.data());
+        return expected == actual;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t limit = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+    if (limit == 0)
+    {
+        std::printf("Usage: chunkpacket_bench [chunks (default 256)]\n");
+        return 1;
+    }
+    PluginManager plugins;
+    BlockManager types;
+    Terrain::registerBlocks(types);
+    Terrain::useGenerator();
+    World world("bench", plugins, types);
+
+    // Columns of chunks around the surface, spreading out until there are enough
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    Vec3i pos;
+    for (int radius = 0; chunks.size() < limit; ++radius)
+        for (pos.x = -radius; pos.x <= radius; ++pos.x)
+            for (pos.z = -radius; pos.z <= radius; ++pos.z)
+                if (std::max(std::abs(pos.x), std::abs(pos.z)) == radius)
+                    for (pos.y = -4; pos.y <= 1 && chunks.size() < limit; ++pos.y)
+                        chunks.emplace_back(new Chunk(pos, world));
+    size_t uniform = 0;
+    for (auto&& chunk : chunks)
+        uniform += chunk->isUniform();
+    std::printf("%zu chunks, %zu uniform\n", chunks.size(), uniform);
+
+    using namespace std::chrono;
+    const double count = static_cast<double>(chunks.size());
+    steady_clock::duration oldEncode{}, newEncode{}, oldDecode{}, newDecode{};
+    size_t bytes = 0, failures = 0;
+    flatbuffers::FlatBufferBuilder oldBuilder, newBuilder;
+    for (auto&& chunk : chunks)
+    {
+        const s2c::Vec3 packetPos(chunk->getPosition().conv<s2c::Vec3>());
+        // Before: a vector of the blocks, copied again into the builder, then into the BitStream sent.
+        // RakNet copies the payload into its packet once more either way, which is left out.
+        auto start = steady_clock::now();
+        {
+            oldBuilder.Clear();
+            if (chunk->isUniform())
+                s2c::FinishChunkBuffer(oldBuilder, s2c::CreateChunk(oldBuilder, &packetPos, 0, chunk->getBlock(Vec3i(0, 0, 0)).getData()));
+            else
+            {
+                std::vector<int> blocks(BlockCount);
+                chunk->getBlocks(reinterpret_cast<BlockData*>(blocks.data()));
+                std::vector<int> copy = blocks;
+                s2c::FinishChunkBuffer(oldBuilder, s2c::CreateChunkDirect(oldBuilder, &packetPos, &copy));
+            }
+            std::vector<uint8_t> bitStream(oldBuilder.GetBufferPointer(), oldBuilder.GetBufferPointer() + oldBuilder.GetSize());
+        }
+        auto mid = steady_clock::now();
+        ChunkPacket::encode(newBuilder, *chunk);
+        auto end = steady_clock::now();
+        oldEncode += mid - start;
+        newEncode += end - mid;
+        // Message and packet ids
+        bytes += newBuilder.GetSize() + 3;
+
+        // Before: element by element into a chunk made by the generator, then packed
+        const s2c::Chunk* packet = s2c::GetChunk(newBuilder.GetBufferPointer());
+        start = steady_clock::now();
+        {
+            std::unique_ptr<Chunk> decoded(new Chunk(chunk->getPosition(), world));
+            if (!packet->blocks())
+                decoded->fill(BlockData(packet->uniform()));
+            else
+            {
+                std::vector<BlockData> blocks(BlockCount);
+                for (size_t i = 0; i < BlockCount; ++i)
+                    blocks[i] = BlockData(packet->blocks()->Get(static_cast<flatbuffers::uoffset_t>(i)));
+                decoded->setBlocks(blocks.data());
+            }
+        }
+        mid = steady_clock::now();
+        std::unique_ptr<Chunk> decoded = ChunkPacket::decode(*packet, world, types.size());
+        end = steady_clock::now();
+        oldDecode += mid - start;
+        newDecode += end - mid;
+        failures += !sameBlocks(*chunk, decoded.get());
+    }
+    std::printf("raw packets: %.0f bytes per chunk\n"
+                "  encode: before %8.0f ns per chunk, ChunkPacket %8.0f ns\n"
+                "  decode: before %8.0f ns per chunk, ChunkPacket %8.0f ns\n",
+                bytes / count, ns(oldEncode, count), ns(newEncode, count), ns(oldDecode, count), ns(newDecode, count));
+
+    // Uniform chunks are a few bytes whatever the codec: measure the others
+    if (uniform == chunks.size())
+        return failures ? 1 : 0;
+    const double blockBytes = double(chunks.size() - uniform) * BlockCount * sizeof(BlockData);
+    size_t rawBytes = 0;
+    for (ChunkCodec codec : { ChunkCodec::Raw, ChunkCodec::PaletteRle })
+    {
+        size_t codecBytes = 0;
+        steady_clock::duration encodeTime{}, decodeTime{};
+        for (auto&& chunk : chunks)
+        {
+            if (chunk->isUniform())
+                continue;
+            auto start = steady_clock::now();
+            ChunkPacket::encode(newBuilder, *chunk, codec);
+            auto mid = steady_clock::now();
+            std::unique_ptr<Chunk> decoded = ChunkPacket::decode(*s2c::GetChunk(newBuilder.GetBufferPointer()), world, types.size());
+            auto end = steady_clock::now();
+            encodeTime += mid - start;
+            decodeTime += end - mid;
+            codecBytes += newBuilder.GetSize();
+            failures += !sameBlocks(*chunk, decoded.get());
+        }
+        if (codec == ChunkCodec::Raw)
+            rawBytes = codecBytes;
+        // Throughput in terms of the blocks carried, 128 KiB a chunk
+        std::printf("codec %d: %8.0f bytes per chunk, ratio %6.1f, encode %7.0f MB/s, decode %7.0f MB/s\n",
+                    static_cast<int>(codec), double(codecBytes) / (chunks.size() - uniform), double(rawBytes) / codecBytes,
+                    blockBytes / duration<double, std::micro>(encodeTime).count(),
+                    blockBytes / duration<double, std::micro>(decodeTime).count());
+    }
+    if (failures)
+        std::printf("%zu packets decoded differently\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunkneighbourhood.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/chunkrenderer.h>
+#include <renderer/greedymesher.h>
+#include <renderer/chunkmeshbuilder.h>
+#include <random>
+#include <bitset>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include "terrain.h"
+
+// Meshes generated terrain one quad per face and with faces merged, comparing quads and time per chunk,
+// then remeshing after single block edits, sorting translucent quads, at each level of detail, through
+// a mesh builder pool of 1 up to [threads] workers, and the whole view out to [distance] chunks with and
+// without levels of detail. Every block type is a cube textured by its id.
+// Usage: mesh_bench [chunks] [threads] [distance]
+
+namespace
+{
+    // Most smooth lighting and occlusion may add to merged meshing time, in percent
+    constexpr double LightingBudget = 50.0;
+
+    double ms(std::chrono::steady_clock::duration time, double count)
+    {
+        return std::chrono::duration<double, std::milli>(time).count() / count;
+    }
+
+    size_t vertexCount(const ChunkMesh& mesh)
+    {
+        size_t vertices = 0;
+        for (auto&& section : mesh.data)
+            vertices += section.packedOpaque.size() + section.packedTranslucent.size() +
+                        (section.opaque.size() + section.translucent.size()) / mesh.format.vertexAttributeCount;
+        return vertices;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t limit = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    const size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency() / 2);
+    const int maxDistance = argc > 3 ? std::atoi(argv[3]) : 16;
+    PluginManager plugins;
+    BlockManager types;
+    Terrain::registerBlocks(types);
+    Terrain::useGenerator();
+    for (size_t id = 1; id < types.size(); ++id)
+    {
+        size_t tiles[6] = { id, id, id, id, id, id };
+        BlockRendererManager::setBlockRenderer(id, std::make_shared<DefaultBlockRenderer>(tiles));
+    }
+
+    // Columns of chunks around the surface, one ring wider than the chunks meshed so all their neighbours are loaded
+    World world("bench", plugins, types);
+    int radius = 0;
+    while ((2 * radius + 1) * (2 * radius + 1) * 4 < static_cast<int>(limit))
+        ++radius;
+    std::vector<Vec3i> targets;
+    Vec3i pos;
+    for (pos.x = -radius - 1; pos.x <= radius + 1; ++pos.x)
+        for (pos.y = -4; pos.y <= 1; ++pos.y)
+            for (pos.z = -radius - 1; pos.z <= radius + 1; ++pos.z)
+            {
+                world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world)));
+                if (targets.size() < limit && pos.x * pos.x <= radius * radius && pos.z * pos.z <= radius * radius && pos.y > -4 && pos.y < 1)
+                    targets.push_back(pos);
+            }
+    const ChunkManager& chunks = world.getChunks();
+    auto snapshot = [&chunks](const Vec3i& pos, int lod = 0) { return ChunkSnapshot(ChunkNeighbourhood(chunks, pos), lod); };
+
+    using namespace std::chrono;
+    const double count = static_cast<double>(targets.size());
+    VertexArray faces0(262144, VertexFormat(2, 3, 0, 3)), faces1(262144, VertexFormat(2, 3, 0, 3));
+    VertexArray merged0(262144, GreedyMesher::format()), merged1(262144, GreedyMesher::format());
+    size_t faceVertices = 0, mergedVertices = 0, flatVertices = 0;
+    steady_clock::duration faceTime{}, mergedTime{}, flatTime{};
+    for (auto&& pos : targets)
+    {
+        const ChunkSnapshot chunk = snapshot(pos);
+        faces0.clear(), faces1.clear(), merged0.clear(), merged1.clear();
+        auto start = steady_clock::now();
+        ChunkRenderer::buildFaces(chunk, faces0, faces1);
+        auto mid = steady_clock::now();
+        GreedyMesher::build(chunk, merged0, merged1);
+        auto end = steady_clock::now();
+        faceTime += mid - start;
+        mergedTime += end - mid;
+        faceVertices += faces0.getVertexCount() + faces1.getVertexCount();
+        mergedVertices += merged0.getVertexCount() + merged1.getVertexCount();
+        // The same without smooth lighting, for its cost
+        merged0.clear(), merged1.clear();
+        start = steady_clock::now();
+        GreedyMesher::build(chunk, merged0, merged1, true, Vec3i(0, 0, 0), Vec3i(Chunk::Size(), Chunk::Size(), Chunk::Size()), false);
+        flatTime += steady_clock::now() - start;
+        flatVertices += merged0.getVertexCount() + merged1.getVertexCount();
+    }
+    std::printf("%zu chunks\n", targets.size());
+    std::printf("  per face: %.0f quads, %.0f vertices, %.3f ms per chunk\n", faceVertices / 4 / count, faceVertices / count, ms(faceTime, count));
+    std::printf("  merged:   %.0f quads, %.0f vertices, %.3f ms per chunk\n", mergedVertices / 4 / count, mergedVertices / count, ms(mergedTime, count));
+    std::printf("  lighting: flat %.0f quads, %.3f ms per chunk; smooth lighting and occlusion cost %.0f%% meshing time (budget %.0f%%)\n",
+                flatVertices / 4 / count, ms(flatTime, count),
+                (duration<double>(mergedTime).count() / duration<double>(flatTime).count() - 1.0) * 100.0, LightingBudget);
+
+    // A random block edit in each chunk: remesh the sections its dirty cells fall in, against the whole chunk
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> coordinate(0, Chunk::Size() - 1);
+    for (bool packed : { false, true })
+    {
+        steady_clock::duration fullTime{}, partialTime{};
+        size_t partialSections = 0;
+        for (auto&& pos : targets)
+        {
+            const ChunkSnapshot chunk = snapshot(pos);
+            const Vec3i block(coordinate(random), coordinate(random), coordinate(random));
+            const unsigned sections = ChunkMesh::getSections(Chunk::getCellMask(block - Vec3i(1, 1, 1), block + Vec3i(2, 2, 2)));
+            auto start = steady_clock::now();
+            ChunkRenderer::buildMesh(chunk, true, packed);
+            auto mid = steady_clock::now();
+            ChunkRenderer::buildMesh(chunk, true, packed, sections);
+            auto end = steady_clock::now();
+            fullTime += mid - start;
+            partialTime += end - mid;
+            partialSections += std::bitset<32>(sections).count();
+        }
+        std::printf("  remesh:   %s, block edit %.1f of %d sections, %.3f ms per chunk, full rebuild %.3f ms\n",
+                    packed ? "packed" : "floats", partialSections / count, ChunkMesh::SectionCount, ms(partialTime, count), ms(fullTime, count));
+    }
+
+    // Sorting translucent quads back to front, from eyes around and inside each chunk
+    size_t translucentQuads = 0, sorts = 0;
+    steady_clock::duration sortTime{};
+    std::uniform_real_distribution<float> eyeCoordinate(-float(Chunk::Size()), 2.0f * Chunk::Size());
+    std::vector<uint32_t> order;
+    for (auto&& pos : targets)
+    {
+        const ChunkMesh mesh = ChunkRenderer::buildMesh(snapshot(pos), true, true);
+        for (int i = 0; i < 8; ++i)
+        {
+            const Vec3f eye(eyeCoordinate(random), eyeCoordinate(random), eyeCoordinate(random));
+            auto start = steady_clock::now();
+            for (auto&& section : mesh.data)
+                QuadSorter::sort(section.centroids, eye, order);
+            sortTime += steady_clock::now() - start;
+            ++sorts;
+        }
+        for (auto&& section : mesh.data)
+            translucentQuads += section.centroids.size();
+    }
+    std::printf("  sort:     %.0f translucent quads, %.1f us per chunk sort\n", translucentQuads / count,
+                duration<double, std::micro>(sortTime).count() / sorts);
+
+    // Levels of detail: vertexes per chunk at each, one quad per face (the client's default) and merged
+    for (int lod = 0; lod < 4; ++lod)
+    {
+        size_t vertices[2] = {};
+        steady_clock::duration time[2] = {};
+        for (bool merge : { false, true })
+            for (auto&& pos : targets)
+            {
+                const ChunkSnapshot chunk = snapshot(pos, lod);
+                auto start = steady_clock::now();
+                vertices[merge] += vertexCount(ChunkRenderer::buildMesh(chunk, merge, false));
+                time[merge] += steady_clock::now() - start;
+            }
+        std::printf("  lod %d:    %dx blocks, per face %.0f vertices %.3f ms, merged %.0f vertices %.3f ms per chunk\n", lod, 1 << lod,
+                    vertices[0] / count, ms(time[0], count), vertices[1] / count, ms(time[1], count));
+    }
+
+    // The same chunks through the builder, snapshots taken here as the client does, on 1, 2, 4... threads
+    for (size_t n = 1;; n = std::min(n * 2, threads))
+    {
+        ChunkMeshBuilder builder;
+        builder.start(n);
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < targets.size(); ++i)
+            builder.request(std::unique_ptr<ChunkSnapshot>(new ChunkSnapshot(ChunkNeighbourhood(chunks, targets[i]))),
+                            true, true, ChunkMesh::AllSections, static_cast<int>(i));
+        const auto queued = steady_clock::now();
+        size_t received = 0, bytes = 0;
+        while (received < targets.size())
+        {
+            auto meshes = builder.poll(SIZE_MAX);
+            if (meshes.empty())
+                std::this_thread::yield();
+            received += meshes.size();
+            for (auto&& mesh : meshes)
+                bytes += mesh.getSize();
+        }
+        const auto end = steady_clock::now();
+        builder.stop();
+        std::printf("  builder:  %zu threads, snapshots %.3f ms per chunk, %.0f chunks/s, %.1f KiB per mesh\n", n,
+                    ms(queued - start, count), count / duration<double>(end - start).count(), bytes / count / 1024);
+        if (n >= threads)
+            break;
+    }
+
+    // The whole view at growing render distances: every chunk of the layers above within the distance,
+    // meshed one quad per face at full resolution and at the level of the client's default rings
+    const int rings[3] = { 4, 8, 12 };
+    for (int distance = 2; distance <= maxDistance; distance *= 2)
+    {
+        for (pos.x = -distance - 1; pos.x <= distance + 1; ++pos.x)
+            for (pos.y = -4; pos.y <= 1; ++pos.y)
+                for (pos.z = -distance - 1; pos.z <= distance + 1; ++pos.z)
+                    if (!world.isChunkLoaded(pos))
+                        world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world)));
+        size_t chunks = 0, full = 0, withLod = 0;
+        for (pos.x = -distance; pos.x <= distance; ++pos.x)
+            for (pos.y = -3; pos.y <= 0; ++pos.y)
+                for (pos.z = -distance; pos.z <= distance; ++pos.z)
+                {
+                    const int d = Vec3i(0, 0, 0).chebyshevDistance(pos);
+                    if (d > distance)
+                        continue;
+                    int lod = 0;
+                    while (lod < 3 && d >= rings[lod])
+                        ++lod;
+                    ++chunks;
+                    full += vertexCount(ChunkRenderer::buildMesh(snapshot(pos), false, false));
+                    withLod += vertexCount(ChunkRenderer::buildMesh(snapshot(pos, lod), false, false));
+                }
+        std::printf("  distance %d: %zu chunks, %.2fM vertices at full resolution, %.2fM with levels of detail\n",
+                    distance, chunks, full / 1e6, withLod / 1e6);
+    }
+    return 0;
+}
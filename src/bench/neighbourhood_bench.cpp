@@ -0,0 +1,98 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunkneighbourhood.h>
+#include <plugin/pluginmanager.h>
+#include <array>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Reading the 6 neighbours of every block of a chunk through World::getBlock, through World::getBlock
+// with a chunk pointer array, and through a ChunkNeighbourhood resolved once.
+// Usage: neighbourhood_bench [rounds]
+
+int main(int argc, char** argv)
+{
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    constexpr std::array<Vec3i, 6> delta
+    {
+        Vec3i(1, 0, 0), Vec3i(-1, 0, 0), Vec3i(0, 1, 0),
+        Vec3i(0,-1, 0), Vec3i(0, 0, 1), Vec3i(0, 0,-1)
+    };
+    constexpr int blocks = Chunk::Size() * Chunk::Size() * Chunk::Size();
+    PluginManager plugins;
+    BlockManager types;
+    World world("bench", plugins, types);
+    const Vec3i center(-20, 3, 700);
+    std::mt19937 random(1);
+    Vec3i d;
+    for (d.x = -1; d.x <= 1; ++d.x)
+        for (d.y = -1; d.y <= 1; ++d.y)
+            for (d.z = -1; d.z <= 1; ++d.z)
+            {
+                Chunk* chunk = world.insertChunk(center + d, ChunkManager::data_t(new Chunk(center + d, world, BlockData(1, 0, 0))));
+                for (int i = 0; i < 512; ++i)
+                    chunk->setBlock(Vec3i(random() % Chunk::Size(), random() % Chunk::Size(), random() % Chunk::Size()), BlockData(random() % 4, 0, 0));
+            }
+
+    using namespace std::chrono;
+    ChunkManager::Cache cache;
+    cache.setCenter(center);
+    const Vec3i base = center * Chunk::Size();
+    size_t sumWorld = 0, sumCache = 0, sumView = 0;
+    double worldNs = 0, cacheNs = 0, viewNs = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        Vec3i pos;
+        auto start = steady_clock::now();
+        for (pos.x = 0; pos.x < Chunk::Size(); ++pos.x)
+            for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+                for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+                    for (auto&& p : delta)
+                        sumWorld += world.getBlock(base + pos + p).getID();
+        auto mid = steady_clock::now();
+        for (pos.x = 0; pos.x < Chunk::Size(); ++pos.x)
+            for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+                for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+                    for (auto&& p : delta)
+                        sumCache += world.getBlock(base + pos + p, cache).getID();
+        auto mid2 = steady_clock::now();
+        const ChunkNeighbourhood chunks(world.getChunks(), center);
+        for (pos.x = 0; pos.x < Chunk::Size(); ++pos.x)
+            for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+                for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+                    for (auto&& p : delta)
+                        sumView += chunks.get(pos + p).getID();
+        auto end = steady_clock::now();
+        worldNs += duration<double, std::nano>(mid - start).count();
+        cacheNs += duration<double, std::nano>(mid2 - mid).count();
+        viewNs += duration<double, std::nano>(end - mid2).count();
+    }
+    if (sumWorld != sumView || sumCache != sumView)
+    {
+        std::printf("Sums differ: %zu %zu %zu\n", sumWorld, sumCache, sumView);
+        return 1;
+    }
+    std::printf("ns per block (6 neighbour reads): World::getBlock %.1f, with chunk pointer array %.1f, ChunkNeighbourhood %.1f\n",
+                worldNs / blocks / rounds, cacheNs / blocks / rounds, viewNs / blocks / rounds);
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "terrain.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Terrain height throughput in columns per second: getHeight per column against getHeightTile per chunk column.
+// Usage: worldgen_bench [chunk columns]
+
+int main(int argc, char** argv)
+{
+    using namespace std::chrono;
+    const int count = argc > 1 ? std::atoi(argv[1]) : 2000;
+    const int side = 45;
+    int heights[NWChunkSize * NWChunkSize];
+    long long sumColumn = 0, sumTile = 0;
+
+    auto start = steady_clock::now();
+    for (int c = 0; c < count; c++)
+    {
+        const int x = (c % side - side / 2) * NWChunkSize, z = (c / side - side / 2) * NWChunkSize;
+        for (int i = 0; i < NWChunkSize; i++)
+            for (int j = 0; j < NWChunkSize; j++)
+                sumColumn += WorldGen::getHeight(x + i, z + j);
+    }
+    auto mid = steady_clock::now();
+    for (int c = 0; c < count; c++)
+    {
+        WorldGen::getHeightTile((c % side - side / 2) * NWChunkSize, (c / side - side / 2) * NWChunkSize, heights);
+        for (int h : heights)
+            sumTile += h;
+    }
+    auto end = steady_clock::now();
+
+    const double columns = double(count) * NWChunkSize * NWChunkSize;
+    std::printf("getHeight     %8.1f M columns/s\ngetHeightTile %8.1f M columns/s%s\n",
+                columns / duration<double>(mid - start).count() / 1e6, columns / duration<double>(end - mid).count() / 1e6,
+                sumColumn == sumTile ? "" : "  (heights differ!)");
+    return sumColumn == sumTile ? 0 : 1;
+}
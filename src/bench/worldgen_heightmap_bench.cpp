@@ -0,0 +1,114 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "terrain.h"
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+// HeightMap hit rate and what it saves, for the chunks a player loads: a cube of chunks around the player
+// nearest first, as sortChunkLoadUnloadList orders them, then the new chunks of each step while walking.
+// Every chunk is generated through the plugin's generator. Its heights are also taken from a HeightMap as
+// large as the plugin's and from one that keeps nothing, which is what generation cost before the cache.
+// Usage: worldgen_heightmap_bench [load radius] [steps walked]
+
+namespace
+{
+    // Chunks within radius of center that were not within radius of previous, nearest first
+    std::vector<NWvec3i> loadOrder(const NWvec3i& center, const NWvec3i* previous, int radius)
+    {
+        auto inRange = [radius](const NWvec3i& a, const NWvec3i& b)
+        {
+            return std::abs(a.x - b.x) <= radius && std::abs(a.y - b.y) <= radius && std::abs(a.z - b.z) <= radius;
+        };
+        std::vector<NWvec3i> chunks;
+        for (int x = -radius; x <= radius; x++)
+            for (int y = -radius; y <= radius; y++)
+                for (int z = -radius; z <= radius; z++)
+                {
+                    const NWvec3i pos{ center.x + x, center.y + y, center.z + z };
+                    if (!previous || !inRange(pos, *previous))
+                        chunks.push_back(pos);
+                }
+        auto distance = [&center](const NWvec3i& p)
+        {
+            return (p.x - center.x) * (p.x - center.x) + (p.y - center.y) * (p.y - center.y) + (p.z - center.z) * (p.z - center.z);
+        };
+        std::stable_sort(chunks.begin(), chunks.end(), [&](const NWvec3i& a, const NWvec3i& b) { return distance(a) < distance(b); });
+        return chunks;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const int radius = argc > 1 ? std::atoi(argv[1]) : 6;
+    const int steps = argc > 2 ? std::atoi(argv[2]) : 16;
+    std::vector<NWvec3i> chunks;
+    NWvec3i center{ 0, 0, 0 };
+    chunks = loadOrder(center, nullptr, radius);
+    for (int step = 0; step < steps; step++)
+    {
+        const NWvec3i previous = center;
+        ++center.x;
+        const auto added = loadOrder(center, &previous, radius);
+        chunks.insert(chunks.end(), added.begin(), added.end());
+    }
+
+    using namespace std::chrono;
+    int heights[NWChunkSize * NWChunkSize];
+    long long sumCached = 0, sumUncached = 0;
+    HeightMap cached(4096), uncached(0);
+    auto start = steady_clock::now();
+    for (auto&& pos : chunks)
+    {
+        cached.get(pos.x, pos.z, heights);
+        sumCached += heights[0];
+    }
+    const double cachedTime = secondsSince(start);
+    start = steady_clock::now();
+    for (auto&& pos : chunks)
+    {
+        uncached.get(pos.x, pos.z, heights);
+        sumUncached += heights[0];
+    }
+    const double uncachedTime = secondsSince(start);
+    std::vector<NWblockdata> blocks(NWChunkSize * NWChunkSize * NWChunkSize);
+    start = steady_clock::now();
+    for (auto&& pos : chunks)
+        generator(&pos, blocks.data(), 15);
+    const double generateTime = secondsSince(start);
+
+    const auto stats = cached.getStats();
+    const double n = double(chunks.size());
+    std::printf("%zu chunks (radius %d, %d steps), %zu columns\n", chunks.size(), radius, steps, stats.size);
+    std::printf("hit rate %.1f%% (%llu hits, %llu misses)\n", 100.0 * stats.hits / (stats.hits + stats.misses),
+                (unsigned long long)stats.hits, (unsigned long long)stats.misses);
+    std::printf("heights per chunk: cached %.0f ns, uncached %.0f ns\n", cachedTime / n * 1e9, uncachedTime / n * 1e9);
+    std::printf("generation per chunk: %.0f ns with the cache, %.0f ns without (%.0f%% saved)\n",
+                generateTime / n * 1e9, (generateTime + uncachedTime - cachedTime) / n * 1e9,
+                100.0 * (uncachedTime - cachedTime) / (generateTime + uncachedTime - cachedTime));
+    return sumCached == sumUncached ? 0 : 1;
+}
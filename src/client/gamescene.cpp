@@ -21,6 +21,7 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <thread>
 #include "gamescene.h"
 #include "window.h"
 #include <engine/common.h>
@@ -31,7 +32,12 @@ GameScene::GameScene(const std::string& name, std::shared_ptr<ClientGameConnecti
            const Window& window):
     mWindow(window), mWorld(name, context.plugins, context.blocks), mPlayer(&mWorld), mConnection(connection)
 {
-    mWorld.setRenderDistance(2);
+    mWorld.setRenderDistance(std::max(1, getJsonValue<int>(getSettings()["client"]["render_distance"], 2)));
+    // Chunk distances where meshes switch to 2x, 4x and 8x blocks; missing levels are never used
+    auto lodDistances = getJsonValue<std::vector<int>>(getSettings()["client"]["lod_distances"], { 4, 8, 12 });
+    std::array<int, MaxChunkLod> lods{ { INT_MAX, INT_MAX, INT_MAX } };
+    std::copy_n(lodDistances.begin(), std::min<size_t>(lodDistances.size(), MaxChunkLod), lods.begin());
+    mWorld.setLodDistances(lods);
     mPlayer.setPosition(Vec3d(-16.0, 48.0, 32.0));
     mPlayer.setRotation(Vec3d(-45.0, -22.5, 0.0));
 
@@ -40,6 +46,14 @@ GameScene::GameScene(const std::string& name, std::shared_ptr<ClientGameConnecti
     BlockRendererManager::flushTextures();
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
+    mWorld.setMergeFace(getJsonValue<bool>(getSettings()["client"]["merge_face"], false));
+    mWorld.setPackedVertices(getJsonValue<bool>(getSettings()["client"]["packed_vertices"], false));
+    // Mesh building workers, by default half the cores; 0 meshes on the render thread
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    mWorld.startMeshBuilder(std::max(0, getJsonValue<int>(getSettings()["client"]["mesh_threads"], std::max(1, hardwareThreads / 2))));
+    mWorld.setMeshUploadBudget(std::max(0, getJsonValue<int>(getSettings()["client"]["mesh_upload_budget"], 4 << 20)));
+    mWorld.setFrustumCulling(getJsonValue<bool>(getSettings()["client"]["frustum_culling"], true));
+    mWorld.setOcclusionCulling(getJsonValue<bool>(getSettings()["client"]["occlusion_culling"], true));
 
     // Initialize Widgets
     mGUIWidgets.addWidget(std::make_shared<WidgetCallback>("Debug", ImVec2(100, 200), [this]
@@ -59,6 +73,38 @@ GameScene::GameScene(const std::string& name, std::shared_ptr<ClientGameConnecti
         ImGui::Text("Position: x %.1f y %.1f z %.1f", mPlayer.getPosition().x, mPlayer.getPosition().y, mPlayer.getPosition().z);
         ImGui::Text("GUI Widgets: %zu", mGUIWidgets.getSize());
         ImGui::Text("Chunks Loaded: %zu", mWorld.getChunkCount());
+        auto requestStats = mConnection->getRequestStats();
+        ImGui::Text("Chunk requests: %zu waiting, %zu sent (%zu retries), %zu acknowledged, %zu refused, %zu answered",
+                    requestStats.outstanding, requestStats.sent, requestStats.retried, requestStats.acknowledged,
+                    requestStats.refused, requestStats.answered);
+        bool mergeFace = ChunkRenderer::getMergeFace();
+        if (ImGui::Checkbox("Merge faces", &mergeFace))
+            getSettings()["client"]["merge_face"] = mWorld.setMergeFace(mergeFace);
+        bool packedVertices = ChunkRenderer::getPackedVertices();
+        if (ImGui::Checkbox("Packed vertices", &packedVertices))
+            getSettings()["client"]["packed_vertices"] = mWorld.setPackedVertices(packedVertices);
+        auto meshStats = mWorld.getMeshStats();
+        ImGui::Text("Meshes: %zu queued, %zu building, %.2fms avg", meshStats.queued, meshStats.building, meshStats.averageBuildTime);
+        bool frustumCulling = mWorld.getFrustumCulling();
+        if (ImGui::Checkbox("Frustum culling", &frustumCulling))
+        {
+            mWorld.setFrustumCulling(frustumCulling);
+            getSettings()["client"]["frustum_culling"] = frustumCulling;
+        }
+        bool occlusionCulling = mWorld.getOcclusionCulling();
+        if (ImGui::Checkbox("Occlusion culling", &occlusionCulling))
+        {
+            mWorld.setOcclusionCulling(occlusionCulling);
+            getSettings()["client"]["occlusion_culling"] = occlusionCulling;
+        }
+        auto renderStats = mWorld.getRenderStats();
+        ImGui::Text("Chunks drawn: %zu, culled: %zu frustum, %zu occlusion, translucent sorted: %zu",
+                    renderStats.drawn, renderStats.frustumCulled, renderStats.occlusionCulled, renderStats.sorted);
+        auto poolStats = ChunkRenderer::getPoolStats();
+        ImGui::Text("Mesh pool: %zu buffers, %.1f/%.1f MiB, %zu free ranges, %zu compactions, %zu draw calls for %zu ranges",
+                    poolStats.buffers, poolStats.used * sizeof(PackedVertex) / 1048576.0,
+                    poolStats.capacity * sizeof(PackedVertex) / 1048576.0, poolStats.freeBlocks, poolStats.compactions,
+                    poolStats.drawCalls, poolStats.ranges);
     }));
 
     // Initialize connection
@@ -75,6 +121,8 @@ GameScene::~GameScene()
 void GameScene::update()
 {
     std::lock_guard<std::mutex> lock(mMutex);
+    // With a local server the world holds the server's chunks, which the server thread may unload or repack
+    EpochReclaimer::Guard guard;
 
     mUpsCounter++;
 
@@ -108,10 +156,10 @@ void GameScene::update()
         mPlayer.accelerate(Vec3d(0.0, -2 * speed, 0.0));
 
     mPlayer.update();
-    mWorld.sortChunkLoadUnloadList(Vec3i(mPlayer.getPosition()));
+    mWorld.sortChunkLoadUnloadList(Vec3i(mPlayer.getPosition()), mPlayer.getChunkCache());
     mWorld.tryLoadChunks(*mConnection);
     mWorld.update();
-    mWorld.renderUpdate(Vec3i(mPlayer.getPosition()));
+    mWorld.renderUpdate(Vec3i(mPlayer.getPosition()), mPlayer.getChunkCache());
     mGUIWidgets.update();
 }
 
@@ -158,10 +206,17 @@ void GameScene::render()
     Renderer::rotate(float(-playerRenderedRotation.y), Vec3f(0.0f, 1.0f, 0.0f));
     Renderer::rotate(float(-playerRenderedRotation.z), Vec3f(0.0f, 0.0f, 1.0f));
     Renderer::translate(-playerRenderedPosition);
+    // The same camera on the CPU, for culling (Mat4f::rotation turns the other way to glRotatef)
+    const Mat4f viewProjection =
+        Mat4f::perspective(70.0f, float(mWindow.getWidth()) / mWindow.getHeight(), 0.1f, 3000.0f) *
+        Mat4f::rotation(float(playerRenderedRotation.x), Vec3f(1.0f, 0.0f, 0.0f)) *
+        Mat4f::rotation(float(playerRenderedRotation.y), Vec3f(0.0f, 1.0f, 0.0f)) *
+        Mat4f::rotation(float(playerRenderedRotation.z), Vec3f(0.0f, 0.0f, 1.0f)) *
+        Mat4f::translation(Vec3f(-playerRenderedPosition));
 
     // Render
-
-    mWorld.render(Vec3i(mPlayer.getPosition()));
+    mWorld.uploadMeshes();
+    mWorld.render(Vec3f(playerRenderedPosition), viewProjection);
 
     // mPlayer.render();
 
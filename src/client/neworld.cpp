@@ -23,6 +23,7 @@
 #include <context/nwcontext.hpp>
 #include "window.h"
 #include "gamescene.h"
+#include <renderer/chunkrenderer.h>
 NEWorld::NEWorld()
 {
     // Initialize
@@ -40,21 +41,24 @@ NEWorld::NEWorld()
     // Run
     constexpr const static int fps = 60;// TODO: read from settings
     constexpr const static double delayPerFrame = (1000/fps)-0.5;
-    GameScene game("TestWorld", conn, window);
-    while(!window.shouldQuit())
     {
-        // Update
-        window.pollEvents();
-        game.multiUpdate();
-        // Render
-        window.newIMGUIFrame();
-        game.render();
-        Renderer::checkError();
-        window.swapBuffers();
-        SDL_Delay(delayPerFrame);
+        GameScene game("TestWorld", conn, window);
+        while(!window.shouldQuit())
+        {
+            // Update
+            window.pollEvents();
+            game.multiUpdate();
+            // Render
+            window.newIMGUIFrame();
+            game.render();
+            Renderer::checkError();
+            window.swapBuffers();
+            SDL_Delay(delayPerFrame);
+        }
     }
 
     // Terminate
     infostream << "Terminating...";
+    ChunkRenderer::freeResources();
     Texture::free();
 }
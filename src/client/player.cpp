@@ -25,7 +25,7 @@ void Player::move()
     //m.speed *= PlayerSpeed;
     mPositionDelta = Mat4d::rotation(mRotation.y, Vec3d(0.0, 1.0, 0.0)).transformVec3(mSpeed);
     Vec3d originalDelta = mPositionDelta;
-    std::vector<AABB> hitboxes = getWorldPtr()->getHitboxes(getHitbox().expand(mPositionDelta));
+    std::vector<AABB> hitboxes = getWorldPtr()->getHitboxes(getHitbox().expand(mPositionDelta), &mChunkCache);
 
     for (auto& curr : hitboxes)
         mPositionDelta.x = getHitbox().maxMoveOnXclip(curr, mPositionDelta.x);
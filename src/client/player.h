@@ -60,6 +60,7 @@ public:
 
     void update() override
     {
+        mChunkCache.setCenter(World::getChunkPos(Vec3i(mPosition)));
         move();
         rotationMove();
     }
@@ -61,3 +61,4 @@
 #include "nwstdlib/nwratemeter.h"
 // Concurrency Library
 #include "concurrency/nwconcurrency.hpp"
+#include "concurrency/nwworkerpool.hpp"
@@ -0,0 +1,84 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+
+// Worker threads serving a job queue owned by someone else, guarded by the owner's mutex.
+// Each worker waits until take(job) hands it a job, called with the mutex held and returning false
+// if none is queued, then runs run(job) without the lock. The owner notifies after queueing.
+class WorkerPool : public NonCopyable
+{
+public:
+    WorkerPool() = default;
+    ~WorkerPool() { stop(); }
+
+    template <class Job, class Take, class Run>
+    void start(size_t threads, std::mutex& mutex, Take take, Run run)
+    {
+        stop();
+        mMutex = &mutex;
+        // Workers only see the pool complete, which take() may look at through size()
+        std::lock_guard<std::mutex> lock(mutex);
+        mStopping = false;
+        for (size_t i = 0; i < threads; ++i)
+            mWorkers.emplace_back([this, take, run]() mutable
+            {
+                Job job;
+                for (;;)
+                {
+                    {
+                        std::unique_lock<std::mutex> lock(*mMutex);
+                        mCondition.wait(lock, [this, &take, &job] { return mStopping || take(job); });
+                        if (mStopping)
+                            return;
+                    }
+                    run(job);
+                }
+            });
+    }
+
+    // Stop and join the workers, each after the job it is running
+    void stop()
+    {
+        if (!mMutex)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(*mMutex);
+            mStopping = true;
+        }
+        mCondition.notify_all();
+        for (auto&& worker : mWorkers)
+            worker.join();
+        mWorkers.clear();
+    }
+
+    void notifyOne() { mCondition.notify_one(); }
+
+    // Running workers. Without any, the owner is expected to run its queue itself.
+    size_t size() const noexcept { return mWorkers.size(); }
+    bool empty() const noexcept { return mWorkers.empty(); }
+
+private:
+    std::mutex* mMutex = nullptr;
+    std::condition_variable mCondition;
+    std::vector<std::thread> mWorkers;
+    bool mStopping = false;
+};
@@ -125,6 +125,13 @@ NWAPIENTRY void NWAPICALL nwLog(char* str);
 typedef void NWAPICALL NWchunkgenerator(const NWvec3i*, NWblockdata*, int32_t);
 NWAPIENTRY size_t NWAPICALL nwRegisterChunkGenerator(NWchunkgenerator* const generator);
 
+// Generates count chunks per call: blocks[i] receives the chunk at positions[i].
+// Chunks of a batch are near each other, so noise can be shared between them.
+// The chunk loader batches pending requests through it; lone chunks use the single chunk generator if
+// one is registered, or a batch of one.
+typedef void NWAPICALL NWbatchchunkgenerator(const NWvec3i* positions, NWblockdata* const* blocks, size_t count, int32_t daylightBrightness);
+NWAPIENTRY size_t NWAPICALL nwRegisterBatchChunkGenerator(NWbatchchunkgenerator* const generator);
+
 #ifdef __cplusplus
 }
 #endif
@@ -71,4 +71,16 @@ extern "C"
         debugstream << "Registered chunk generator";
         return 0;
     }
+
+    NWAPIEXPORT size_t NWAPICALL nwRegisterBatchChunkGenerator(NWbatchchunkgenerator* const generator)
+    {
+        if (Chunk::BatchChunkGen)
+        {
+            warningstream << "Ignoring multiple batch chunk generators!";
+            return 1;
+        }
+        Chunk::BatchChunkGen = reinterpret_cast<BatchChunkGenerator*>(generator);
+        debugstream << "Registered batch chunk generator";
+        return 0;
+    }
 }
@@ -3,36 +3,70 @@
 
 #include "../protocol/gen/protocol.h"
 #include <engine/common.h>
+#include <network/builderpool.h>
 
+// Each packet is built in a builder leased from this thread's pool, returned once the lease is gone
 namespace FlatFactory
 {
-    static flatbuffers::FlatBufferBuilder fbb;
     namespace c2s
     {
-        inline flatbuffers::FlatBufferBuilder &Login(const char *username, const char *password)
+        inline BuilderPool::Lease Handshake(const std::vector<uint8_t>& chunkCodecs, uint8_t loadRange)
         {
-            fbb.Clear();
-            auto login = ::c2s::CreateLoginDirect(fbb, username, password, NEWorldVersion);
-            ::c2s::FinishLoginBuffer(fbb, login);
+            auto fbb = BuilderPool::acquire();
+            auto handshake = ::c2s::CreateHandshakeDirect(*fbb, NEWorldVersion, &chunkCodecs, loadRange);
+            ::c2s::FinishHandshakeBuffer(*fbb, handshake);
             return fbb;
         }
 
-        inline flatbuffers::FlatBufferBuilder &RequestChunk(Vec3i pos)
+        inline BuilderPool::Lease Login(const char *username, const char *password)
         {
-            fbb.Clear();
-            auto req = ::c2s::CreateRequestChunk(fbb, pos.x, pos.y, pos.z);
-            ::c2s::FinishRequestChunkBuffer(fbb, req);
+            auto fbb = BuilderPool::acquire();
+            auto login = ::c2s::CreateLoginDirect(*fbb, username, password, NEWorldVersion);
+            ::c2s::FinishLoginBuffer(*fbb, login);
+            return fbb;
+        }
+
+        inline BuilderPool::Lease RequestChunk(Vec3i pos, Vec3i playerChunkPos)
+        {
+            auto fbb = BuilderPool::acquire();
+            auto req = ::c2s::CreateRequestChunk(*fbb, pos.x, pos.y, pos.z, playerChunkPos.x, playerChunkPos.y, playerChunkPos.z);
+            ::c2s::FinishRequestChunkBuffer(*fbb, req);
+            return fbb;
+        }
+
+        // offsets as ChunkOffsets makes them
+        inline BuilderPool::Lease RequestChunks(Vec3i playerChunkPos, const std::vector<int8_t>& offsets)
+        {
+            auto fbb = BuilderPool::acquire();
+            auto req = ::c2s::CreateRequestChunksDirect(*fbb, playerChunkPos.x, playerChunkPos.y, playerChunkPos.z, &offsets);
+            ::c2s::FinishRequestChunksBuffer(*fbb, req);
             return fbb;
         }
     }
 
     namespace s2c
     {
-        inline flatbuffers::FlatBufferBuilder &Chunk(::s2c::Vec3 pos,std::vector<int> blocks)
+        inline BuilderPool::Lease HandshakeRet(uint16_t versionId, uint8_t chunkCodec)
+        {
+            auto fbb = BuilderPool::acquire();
+            auto ret = ::s2c::CreateHandshakeRet(*fbb, versionId, chunkCodec);
+            ::s2c::FinishHandshakeRetBuffer(*fbb, ret);
+            return fbb;
+        }
+
+        inline BuilderPool::Lease ChunksUnmodified(Vec3i centre, const std::vector<int8_t>& offsets)
+        {
+            auto fbb = BuilderPool::acquire();
+            auto ret = ::s2c::CreateChunksUnmodifiedDirect(*fbb, centre.x, centre.y, centre.z, &offsets);
+            ::s2c::FinishChunksUnmodifiedBuffer(*fbb, ret);
+            return fbb;
+        }
+
+        inline BuilderPool::Lease ChunkRequestsAck(Vec3i centre, const std::vector<int8_t>& accepted, const std::vector<int8_t>& refused)
         {
-            fbb.Clear();
-            auto c = ::s2c::CreateChunkDirect(fbb, &pos, &blocks);
-            ::s2c::FinishChunkBuffer(fbb, c);
+            auto fbb = BuilderPool::acquire();
+            auto ack = ::s2c::CreateChunkRequestsAckDirect(*fbb, centre.x, centre.y, centre.z, &accepted, &refused);
+            ::s2c::FinishChunkRequestsAckBuffer(*fbb, ack);
             return fbb;
         }
     }
@@ -0,0 +1,83 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "builderpool.h"
+#include <vector>
+#include <algorithm>
+
+constexpr size_t BuilderPool::SmallLimit;
+constexpr size_t BuilderPool::LargeInitialSize;
+constexpr size_t BuilderPool::MaxIdle;
+std::atomic<size_t> BuilderPool::mCreated{ 0 }, BuilderPool::mDestroyed{ 0 }, BuilderPool::mAcquired{ 0 };
+
+// Idle builders of one thread, freed when it exits
+struct BuilderPool::Idle
+{
+    Idle()
+    {
+        for (auto&& idle : classes)
+            idle.reserve(MaxIdle);
+    }
+    ~Idle()
+    {
+        for (auto&& idle : classes)
+            for (Entry* entry : idle)
+                discard(entry);
+    }
+    std::vector<Entry*> classes[2];
+};
+
+thread_local BuilderPool::Idle BuilderPool::mIdle;
+
+BuilderPool::Lease BuilderPool::acquire(SizeClass sizeClass)
+{
+    ++mAcquired;
+    auto& idle = mIdle.classes[static_cast<size_t>(sizeClass)];
+    if (idle.empty())
+    {
+        ++mCreated;
+        return Lease(new Entry(sizeClass == SizeClass::Large ? LargeInitialSize : 1024));
+    }
+    Entry* entry = idle.back();
+    idle.pop_back();
+    entry->builder.Clear();
+    return Lease(entry);
+}
+
+BuilderPool::Stats BuilderPool::getStats() noexcept
+{
+    return{ mCreated.load(), mDestroyed.load(), mAcquired.load() };
+}
+
+void BuilderPool::release(Entry* entry) noexcept
+{
+    entry->capacity = std::max(entry->capacity, static_cast<size_t>(entry->builder.GetSize()));
+    auto& idle = mIdle.classes[entry->capacity > SmallLimit];
+    // The vectors were reserved for MaxIdle, so this never allocates
+    if (idle.size() < MaxIdle)
+        idle.push_back(entry);
+    else
+        discard(entry);
+}
+
+void BuilderPool::discard(Entry* entry) noexcept
+{
+    ++mDestroyed;
+    delete entry;
+}
@@ -0,0 +1,106 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUILDERPOOL_H_
+#define BUILDERPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include "../../protocol/gen/protocol.h"
+
+// Flatbuffer builders reused per thread, so building packets from several threads is safe and
+// steady state encoding allocates nothing: a cleared builder keeps its buffer.
+// A lease goes back to the pool of the thread that releases it, filed by the size of its builder's
+// buffer: the initial size of the class it was made for, or the largest packet it has held if that
+// is more. Small packets then never take the chunk-sized buffers and chunk packets never grow a small one.
+class BuilderPool
+{
+public:
+    enum class SizeClass { Small, Large };
+
+    // Builders whose buffer holds more than this are large
+    static constexpr size_t SmallLimit = 4096;
+    // Initial buffer of a new large builder, enough for a raw chunk packet
+    static constexpr size_t LargeInitialSize = 132 * 1024;
+    // Idle builders kept per size class per thread; releasing more frees them
+    static constexpr size_t MaxIdle = 4;
+
+    struct Stats
+    {
+        // Builders created and freed since start, and leases handed out
+        size_t created, destroyed, acquired;
+    };
+
+private:
+    struct Entry;
+    struct Idle;
+
+public:
+    class Lease
+    {
+    public:
+        Lease(Lease&& rhs) noexcept : mEntry(rhs.mEntry) { rhs.mEntry = nullptr; }
+        Lease& operator=(Lease&& rhs) noexcept
+        {
+            std::swap(mEntry, rhs.mEntry);
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { if (mEntry) release(mEntry); }
+
+        flatbuffers::FlatBufferBuilder& operator*() const noexcept;
+        flatbuffers::FlatBufferBuilder* operator->() const noexcept { return &**this; }
+        // So a lease made in a send() call's arguments passes as the builder
+        operator flatbuffers::FlatBufferBuilder&() const noexcept { return **this; }
+
+    private:
+        friend class BuilderPool;
+        explicit Lease(Entry* entry) noexcept : mEntry(entry) {}
+        Entry* mEntry;
+    };
+
+    // A cleared builder of this thread, created if none of the class is idle
+    static Lease acquire(SizeClass sizeClass = SizeClass::Small);
+
+    static Stats getStats() noexcept;
+
+private:
+    struct Entry
+    {
+        explicit Entry(size_t initialSize) : builder(initialSize), capacity(initialSize) {}
+        flatbuffers::FlatBufferBuilder builder;
+        // Bytes the buffer holds: the initial size, or the largest finished packet it grew to
+        size_t capacity;
+    };
+
+    static thread_local Idle mIdle;
+    static std::atomic<size_t> mCreated, mDestroyed, mAcquired;
+
+    static void release(Entry* entry) noexcept;
+    static void discard(Entry* entry) noexcept;
+};
+
+inline flatbuffers::FlatBufferBuilder& BuilderPool::Lease::operator*() const noexcept
+{
+    return mEntry->builder;
+}
+
+#endif // !BUILDERPOOL_H_
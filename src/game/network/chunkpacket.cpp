@@ -0,0 +1,249 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunkpacket.h"
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+    constexpr int Size = Chunk::Size();
+    constexpr size_t BlockCount = Size * Size * Size;
+    static_assert(sizeof(BlockData) == sizeof(int32_t), "Blocks are sent as the ints of s2c::Chunk::blocks");
+
+    // Codecs by preference when negotiating, best first
+    constexpr ChunkCodec Preferred[] = { ChunkCodec::PaletteRle, ChunkCodec::Raw };
+
+    void writeVarint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // False if the input ends inside the varint or it doesn't fit 32 bits
+    bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && in != end; shift += 7)
+        {
+            const uint8_t byte = *in++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return shift < 28 || byte < 0x10;
+        }
+        return false;
+    }
+
+    // Flat storage index of the n-th block going up the columns
+    template <class Func>
+    void forEachColumnOrder(Func func)
+    {
+        for (int x = 0; x < Size; ++x)
+            for (int z = 0; z < Size; ++z)
+                for (int y = 0; y < Size; ++y)
+                    func((x * Size + y) * Size + z);
+    }
+}
+
+void ChunkPacket::encode(flatbuffers::FlatBufferBuilder& fbb, const Chunk& chunk, ChunkCodec codec)
+{
+    fbb.Clear();
+    const s2c::Vec3 pos(chunk.getPosition().conv<s2c::Vec3>());
+    // Uniform chunks leave blocks out and send their single block
+    if (chunk.isUniform())
+    {
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, 0, chunk.getBlock(Vec3i(0, 0, 0)).getData()));
+        return;
+    }
+    if (codec == ChunkCodec::PaletteRle)
+    {
+        static thread_local std::unique_ptr<BlockData[]> blocks(new BlockData[BlockCount]);
+        static thread_local std::vector<uint32_t> palette;
+        static thread_local std::vector<uint8_t> runs;
+        chunk.getBlocks(blocks.get());
+        encodeRuns(blocks.get(), palette, runs);
+        const auto paletteOffset = fbb.CreateVector(palette);
+        const auto runsOffset = fbb.CreateVector(runs);
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, 0, 0, static_cast<uint8_t>(codec), paletteOffset, runsOffset));
+        return;
+    }
+    // Aligned for int32_t by the builder
+    uint8_t* data;
+    const flatbuffers::Offset<flatbuffers::Vector<int32_t>> blocks = fbb.CreateUninitializedVector(BlockCount, sizeof(int32_t), &data);
+    BlockData* dst = reinterpret_cast<BlockData*>(data);
+    chunk.getBlocks(dst);
+#if !FLATBUFFERS_LITTLEENDIAN
+    for (size_t i = 0; i < BlockCount; ++i)
+        dst[i] = BlockData(flatbuffers::EndianScalar(dst[i].getData()));
+#endif
+    s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, blocks));
+}
+
+std::unique_ptr<Chunk> ChunkPacket::decode(const s2c::Chunk& packet, World& world, size_t blockTypes)
+{
+    if (!packet.pos())
+        return nullptr;
+    const Vec3i pos(packet.pos()->x(), packet.pos()->y(), packet.pos()->z());
+    // The vectors sit at whatever alignment the packet has after its header: copy them out whole
+    static thread_local std::unique_ptr<BlockData[]> staging(new BlockData[BlockCount]);
+    BlockData* dst = staging.get();
+    switch (static_cast<ChunkCodec>(packet.codec()))
+    {
+    case ChunkCodec::Raw:
+    {
+        const flatbuffers::Vector<int32_t>* blocks = packet.blocks();
+        if (!blocks)
+        {
+            const BlockData block(packet.uniform());
+            if (block.getID() >= blockTypes)
+                return nullptr;
+            return std::unique_ptr<Chunk>(new Chunk(pos, world, block));
+        }
+        if (blocks->size() != BlockCount)
+            return nullptr;
+        std::memcpy(dst, blocks->Data(), BlockCount * sizeof(BlockData));
+        uint32_t maxID = 0;
+        for (size_t i = 0; i < BlockCount; ++i)
+        {
+#if !FLATBUFFERS_LITTLEENDIAN
+            dst[i] = BlockData(flatbuffers::EndianScalar(dst[i].getData()));
+#endif
+            maxID = std::max(maxID, dst[i].getID());
+        }
+        if (maxID >= blockTypes)
+            return nullptr;
+        break;
+    }
+    case ChunkCodec::PaletteRle:
+    {
+        const flatbuffers::Vector<uint32_t>* paletteData = packet.palette();
+        const flatbuffers::Vector<uint8_t>* runs = packet.runs();
+        if (!paletteData || !runs || paletteData->size() == 0 || paletteData->size() > BlockCount)
+            return nullptr;
+        static thread_local std::vector<BlockData> palette;
+        palette.resize(paletteData->size());
+        std::memcpy(palette.data(), paletteData->Data(), palette.size() * sizeof(BlockData));
+        for (auto&& block : palette)
+        {
+#if !FLATBUFFERS_LITTLEENDIAN
+            block = BlockData(flatbuffers::EndianScalar(block.getData()));
+#endif
+            if (block.getID() >= blockTypes)
+                return nullptr;
+        }
+        if (!decodeRuns(palette, runs->Data(), runs->size(), dst))
+            return nullptr;
+        break;
+    }
+    default:
+        return nullptr;
+    }
+    return std::unique_ptr<Chunk>(new Chunk(pos, world, dst));
+}
+
+ChunkCodec ChunkPacket::negotiate(const uint8_t* offered, size_t count) noexcept
+{
+    for (ChunkCodec codec : Preferred)
+        if (std::find(offered, offered + count, static_cast<uint8_t>(codec)) != offered + count)
+            return codec;
+    return ChunkCodec::Raw;
+}
+
+void ChunkPacket::encodeRuns(const BlockData* blocks, std::vector<uint32_t>& palette, std::vector<uint8_t>& runs)
+{
+    palette.clear();
+    runs.clear();
+    // Palette indexes by value; terrain has a handful, so most chunks never get past the linear search
+    constexpr size_t LinearSearchLimit = 64;
+    std::unordered_map<uint32_t, uint32_t> lookup;
+    auto paletteIndex = [&palette, &lookup](uint32_t value)
+    {
+        if (palette.size() <= LinearSearchLimit)
+        {
+            auto iter = std::find(palette.begin(), palette.end(), value);
+            if (iter != palette.end())
+                return static_cast<uint32_t>(iter - palette.begin());
+        }
+        else
+        {
+            auto iter = lookup.find(value);
+            if (iter != lookup.end())
+                return iter->second;
+        }
+        palette.push_back(value);
+        if (palette.size() > LinearSearchLimit)
+        {
+            if (lookup.empty())
+                for (size_t i = 0; i < palette.size(); ++i)
+                    lookup.emplace(palette[i], static_cast<uint32_t>(i));
+            else
+                lookup.emplace(value, static_cast<uint32_t>(palette.size() - 1));
+        }
+        return static_cast<uint32_t>(palette.size() - 1);
+    };
+    uint32_t current = blocks[0].getData(), length = 0;
+    forEachColumnOrder([&](int index)
+    {
+        const uint32_t value = blocks[index].getData();
+        if (value == current)
+        {
+            ++length;
+            return;
+        }
+        writeVarint(runs, paletteIndex(current));
+        writeVarint(runs, length - 1);
+        current = value;
+        length = 1;
+    });
+    writeVarint(runs, paletteIndex(current));
+    writeVarint(runs, length - 1);
+#if !FLATBUFFERS_LITTLEENDIAN
+    for (auto&& value : palette)
+        value = flatbuffers::EndianScalar(value);
+#endif
+}
+
+bool ChunkPacket::decodeRuns(const std::vector<BlockData>& palette, const uint8_t* runs, size_t size, BlockData* dst)
+{
+    const uint8_t* in = runs;
+    const uint8_t* const end = runs + size;
+    uint32_t left = 0;
+    BlockData block;
+    bool ok = true;
+    forEachColumnOrder([&](int index)
+    {
+        if (left == 0 && ok)
+        {
+            uint32_t paletteIndex, length;
+            ok = readVarint(in, end, paletteIndex) && readVarint(in, end, length) && paletteIndex < palette.size() &&
+                 length < BlockCount;
+            block = ok ? palette[paletteIndex] : BlockData();
+            left = length + 1;
+        }
+        dst[index] = block;
+        --left;
+    });
+    // Every run used up exactly, nothing after the last one
+    return ok && left == 0 && in == end;
+}
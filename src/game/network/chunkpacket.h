@@ -0,0 +1,63 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKPACKET_H_
+#define CHUNKPACKET_H_
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "../../protocol/gen/protocol.h"
+#include <world/nwchunk.h>
+
+// How the blocks of a non-uniform chunk travel, agreed in c2s::Handshake / s2c::HandshakeRet
+enum class ChunkCodec : uint8_t
+{
+    // 128 KiB of ints, what clients that don't handshake get
+    Raw = 0,
+    // Palette and runs up the block columns, where terrain repeats most
+    PaletteRle = 1
+};
+
+// s2c::Chunk packets straight from and into chunk storage.
+// Raw encoding expands the chunk's palette into the builder's own vector, with no intermediate array.
+// Decoding checks the packet and copies its blocks into a staging array the new chunk is packed from.
+class ChunkPacket
+{
+public:
+    // Serialize chunk into fbb, which is cleared first. Reusing one builder keeps its buffer allocated.
+    static void encode(flatbuffers::FlatBufferBuilder& fbb, const Chunk& chunk, ChunkCodec codec = ChunkCodec::Raw);
+
+    // A chunk of world from a verified packet, or nullptr if its codec is unknown, it doesn't hold
+    // exactly Size()^3 blocks or it uses block ids of blockTypes or above
+    static std::unique_ptr<Chunk> decode(const s2c::Chunk& packet, World& world, size_t blockTypes);
+
+    // Codecs this build decodes, for c2s::Handshake
+    static std::vector<uint8_t> getCodecs() { return{ uint8_t(ChunkCodec::Raw), uint8_t(ChunkCodec::PaletteRle) }; }
+    // The best codec of those a client offers, Raw if it offers none known
+    static ChunkCodec negotiate(const uint8_t* offered, size_t count) noexcept;
+
+private:
+    // PaletteRle: the blocks in palette and runs, read back into Size()^3 blocks of dst.
+    // Decoding returns false on malformed runs.
+    static void encodeRuns(const BlockData* blocks, std::vector<uint32_t>& palette, std::vector<uint8_t>& runs);
+    static bool decodeRuns(const std::vector<BlockData>& palette, const uint8_t* runs, size_t size, BlockData* dst);
+};
+
+#endif // !CHUNKPACKET_H_
@@ -0,0 +1,107 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunkrequests.h"
+#include <engine/common.h>
+
+constexpr std::chrono::milliseconds ChunkRequestTracker::Timeout, ChunkRequestTracker::MaxTimeout;
+constexpr int ChunkRequestTracker::WarnAttempts;
+
+void ChunkRequestTracker::request(const Vec3i& pos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mRequests.emplace(pos, Request{ Clock::time_point(), 0, false }).second)
+        mNew.push_back(pos);
+}
+
+bool ChunkRequestTracker::acknowledge(const Vec3i& pos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mRequests.find(pos);
+    if (iter == mRequests.end() || iter->second.attempts == 0)
+        return false;
+    iter->second.acknowledged = true;
+    ++mAcknowledged;
+    return true;
+}
+
+bool ChunkRequestTracker::refuse(const Vec3i& pos, Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mRequests.find(pos);
+    if (iter == mRequests.end() || iter->second.attempts == 0)
+        return false;
+    iter->second.acknowledged = false;
+    iter->second.deadline = now + MaxTimeout;
+    ++mRefused;
+    return true;
+}
+
+bool ChunkRequestTracker::answer(const Vec3i& pos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mRequests.erase(pos))
+        return false;
+    ++mAnswered;
+    return true;
+}
+
+std::vector<Vec3i> ChunkRequestTracker::collect(Clock::time_point now, const std::function<bool(const Vec3i&)>& wanted)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<Vec3i> result;
+    auto send = [&](const Vec3i& pos, Request& req)
+    {
+        req.deadline = now + std::min<Clock::duration>(Timeout * (1 << std::min(req.attempts, 3)), MaxTimeout);
+        req.acknowledged = false;
+        if (req.attempts == WarnAttempts)
+            warningstream << "Chunk (" << pos.x << ", " << pos.y << ", " << pos.z << ") requested "
+                          << WarnAttempts << " times without an answer, still trying";
+        if (req.attempts++)
+            ++mRetried;
+        ++mSent;
+        result.push_back(pos);
+    };
+    // New requests first, in the order made: nearest first
+    for (auto&& pos : mNew)
+    {
+        auto iter = mRequests.find(pos);
+        if (iter != mRequests.end() && iter->second.attempts == 0 && wanted(pos))
+            send(pos, iter->second);
+    }
+    mNew.clear();
+    for (auto iter = mRequests.begin(); iter != mRequests.end();)
+    {
+        if (!wanted(iter->first))
+        {
+            iter = mRequests.erase(iter);
+            continue;
+        }
+        if (iter->second.attempts && !iter->second.acknowledged && iter->second.deadline <= now)
+            send(iter->first, iter->second);
+        ++iter;
+    }
+    return result;
+}
+
+ChunkRequestTracker::Stats ChunkRequestTracker::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return{ mRequests.size(), mSent, mRetried, mAcknowledged, mRefused, mAnswered };
+}
@@ -0,0 +1,109 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKREQUESTS_H_
+#define CHUNKREQUESTS_H_
+
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <world/nwchunk.h>
+
+// Chunk positions as dx, dy, dz bytes from a centre, as c2s::RequestChunks, s2c::ChunksUnmodified and
+// s2c::ChunkRequestsAck carry them
+class ChunkOffsets
+{
+public:
+    static bool fits(const Vec3i& centre, const Vec3i& pos) noexcept
+    {
+        return centre.chebyshevDistance(pos) <= INT8_MAX;
+    }
+
+    // pos must fit
+    static void append(const Vec3i& centre, const Vec3i& pos, std::vector<int8_t>& offsets)
+    {
+        offsets.push_back(static_cast<int8_t>(pos.x - centre.x));
+        offsets.push_back(static_cast<int8_t>(pos.y - centre.y));
+        offsets.push_back(static_cast<int8_t>(pos.z - centre.z));
+    }
+
+    // Calls f with each position; a trailing partial triple is ignored
+    template <class F>
+    static void forEach(const Vec3i& centre, const int8_t* offsets, size_t size, F f)
+    {
+        for (size_t i = 0; i + 3 <= size; i += 3)
+            f(Vec3i(centre.x + offsets[i], centre.y + offsets[i + 1], centre.z + offsets[i + 2]));
+    }
+};
+
+// Chunks a client asked the server for and has no answer to yet: a chunk packet, or the chunk named in
+// s2c::ChunksUnmodified. The server acknowledges each request it takes in s2c::ChunkRequestsAck and then
+// answers it, so an acknowledged request has no timeout. Requests not acknowledged after a timeout are made
+// again, with the timeout doubling each time up to MaxTimeout; those the server refused, being out of the
+// player's range as it last heard, are made again MaxTimeout after the refusal. Either only while the chunk
+// is still wanted. Answers arrive on the network thread; the rest runs on the game thread.
+class ChunkRequestTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds Timeout{ 1000 }, MaxTimeout{ 8000 };
+    // Retries after which a warning is logged for a chunk, once
+    static constexpr int WarnAttempts = 4;
+
+    struct Stats
+    {
+        // Waiting for an answer now; since start, requests sent, of them retries, acknowledgements, refusals and answers
+        size_t outstanding, sent, retried, acknowledged, refused, answered;
+    };
+
+    // Ask for a chunk with the next collect(), unless already asked
+    void request(const Vec3i& pos);
+    // The server took the request and will answer it. Returns false if it wasn't asked for.
+    bool acknowledge(const Vec3i& pos);
+    // The server won't send the chunk: ask again at `now` + MaxTimeout if still wanted. Returns false if it wasn't asked for.
+    bool refuse(const Vec3i& pos, Clock::time_point now);
+    // The server answered for a chunk. Returns false if it wasn't asked for.
+    bool answer(const Vec3i& pos);
+    // Chunks to ask for now: new ones and those that timed out. Chunks no longer wanted are forgotten.
+    std::vector<Vec3i> collect(Clock::time_point now, const std::function<bool(const Vec3i&)>& wanted);
+
+    Stats getStats() const;
+
+private:
+    struct Request
+    {
+        // Not sent yet when attempts is 0
+        Clock::time_point deadline;
+        int attempts;
+        // Acknowledged and not refused since: the answer is on its way
+        bool acknowledged;
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<Vec3i, Request, ChunkHasher> mRequests;
+    // Requested since the last collect()
+    std::vector<Vec3i> mNew;
+    size_t mSent = 0, mRetried = 0, mAcknowledged = 0, mRefused = 0, mAnswered = 0;
+};
+
+#endif // !CHUNKREQUESTS_H_
@@ -0,0 +1,116 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunksendqueue.h"
+#include <algorithm>
+
+void ChunkSendQueue::push(const Vec3i& chunkPos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mQueued.insert(chunkPos).second)
+        return;
+    mPending.push_back(chunkPos);
+    mSorted = false;
+}
+
+void ChunkSendQueue::setObserver(const Vec3i& chunkPos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (chunkPos == mObserver)
+        return;
+    mObserver = chunkPos;
+    mSorted = false;
+}
+
+void ChunkSendQueue::setRange(int range)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRange = range;
+    mSorted = false;
+}
+
+bool ChunkSendQueue::inRange(const Vec3i& chunkPos) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mObserver.chebyshevDistance(chunkPos) <= mRange;
+}
+
+size_t ChunkSendQueue::flush(const Sender& send, const Dropper& drop)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Credit left over from idle ticks doesn't add up into a burst
+    mCredit = std::min<int64_t>(mCredit + mBudget, mBudget);
+    if (!mSorted)
+        sort(drop);
+    size_t sent = 0;
+    while (!mPending.empty() && (mBudget == 0 || mCredit > 0))
+    {
+        const Vec3i pos = mPending.back();
+        mPending.pop_back();
+        mQueued.erase(pos);
+        const size_t bytes = send(pos);
+        if (bytes == 0)
+        {
+            ++mReloaded;
+            continue;
+        }
+        mCredit -= bytes;
+        mSentBytes += bytes;
+        mWindowBytes += bytes;
+        ++mSent;
+        ++sent;
+    }
+
+    using namespace std::chrono;
+    const auto now = steady_clock::now();
+    const double elapsed = duration<double>(now - mWindowStart).count();
+    if (elapsed >= 1.0)
+    {
+        mRate = mWindowBytes / elapsed;
+        mWindowBytes = 0;
+        mWindowStart = now;
+    }
+    return sent;
+}
+
+ChunkSendQueue::Stats ChunkSendQueue::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return{ mPending.size(), mSent, mDropped, mReloaded, mSentBytes, mRate };
+}
+
+void ChunkSendQueue::sort(const Dropper& drop)
+{
+    auto outOfRange = [this](const Vec3i& pos) { return mObserver.chebyshevDistance(pos) > mRange; };
+    for (auto&& pos : mPending)
+        if (outOfRange(pos))
+        {
+            mQueued.erase(pos);
+            ++mDropped;
+            if (drop)
+                drop(pos);
+        }
+    mPending.erase(std::remove_if(mPending.begin(), mPending.end(), outOfRange), mPending.end());
+    // By euclidean distance, the order the client requests in
+    std::sort(mPending.begin(), mPending.end(), [this](const Vec3i& lhs, const Vec3i& rhs)
+    {
+        return (lhs - mObserver).lengthSqr() > (rhs - mObserver).lengthSqr();
+    });
+    mSorted = true;
+}
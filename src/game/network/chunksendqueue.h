@@ -0,0 +1,91 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKSENDQUEUE_H_
+#define CHUNKSENDQUEUE_H_
+
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <unordered_set>
+#include <world/nwchunk.h>
+
+// Chunks waiting to go to one client, nearest to its player first, paced by a byte budget per tick.
+// The budget is a credit topped up every tick and spent while any is left, so a chunk larger than
+// the budget still goes and the ticks after it pay the overdraft off.
+// Chunks further than range from the player when their turn comes are dropped and the client is told.
+// The range is the client's load range, so it has unloaded most of those too.
+class ChunkSendQueue
+{
+public:
+    struct Stats
+    {
+        // Waiting now; since the connection opened, sent, dropped out of range, and found unloaded
+        // on the server and handed back to be loaded again
+        size_t queued, sent, dropped, reloaded;
+        size_t sentBytes;
+        // Bytes per second over the last full second
+        double rate;
+    };
+
+    // Sends a chunk, returning the bytes sent. Returns 0 if it isn't loaded any more, having it loaded and pushed again.
+    // It runs under the queue's lock, so it must not push itself.
+    using Sender = std::function<size_t(const Vec3i&)>;
+    // Told of each chunk dropped out of range, under the queue's lock as well
+    using Dropper = std::function<void(const Vec3i&)>;
+
+    // budget is in bytes per tick, 0 for no limit. range is a chebyshev distance in chunks.
+    ChunkSendQueue(size_t budget, int range) : mBudget(budget), mRange(range) {}
+
+    // Queue a chunk once, however many times it is requested before it is sent
+    void push(const Vec3i& chunkPos);
+    // Chunk position of the player, from its latest request
+    void setObserver(const Vec3i& chunkPos);
+    // The client's load range, from its handshake
+    void setRange(int range);
+    // Whether a chunk is within range of the player
+    bool inRange(const Vec3i& chunkPos) const;
+    // Run a tick: send the nearest chunks while the budget lasts. Returns the chunks sent.
+    size_t flush(const Sender& send, const Dropper& drop = nullptr);
+
+    Stats getStats() const;
+
+private:
+    // Stats are read from the console thread; everything else runs on the network thread
+    mutable std::mutex mMutex;
+    const size_t mBudget;
+    int mRange;
+    // Sorted nearest last when mSorted, so sending pops from the back
+    std::vector<Vec3i> mPending;
+    std::unordered_set<Vec3i, ChunkHasher> mQueued;
+    bool mSorted = true;
+    Vec3i mObserver{ 0, 0, 0 };
+    // Bytes that may still go this tick, negative after a chunk overran it
+    int64_t mCredit = 0;
+    size_t mSent = 0, mDropped = 0, mReloaded = 0, mSentBytes = 0;
+    std::chrono::steady_clock::time_point mWindowStart = std::chrono::steady_clock::now();
+    size_t mWindowBytes = 0;
+    double mRate = 0.0;
+
+    // Put the nearest chunk last and drop those out of range. Requires mMutex.
+    void sort(const Dropper& drop);
+};
+
+#endif // !CHUNKSENDQUEUE_H_
@@ -19,6 +19,7 @@
 
 #include <renderer/chunkrenderer.h>
 #include <network/clientgameconnection.h>
+#include <network/chunkpacket.h>
 #include <engine/common.h>
 #include <flatfactory.h>
 
@@ -27,7 +28,7 @@ void NWAPICALL nwRunServer();
 void NWAPICALL nwStopServer();
 World* NWAPICALL nwLocalServerGetWorld(size_t id);
 void NWAPICALL nwLocalServerLogin(const char* username, const char* password);
-Chunk* NWAPICALL nwLocalServerGetChunk(int32_t x, int32_t y, int32_t z);
+Chunk* NWAPICALL nwLocalServerGetChunk(int32_t x, int32_t y, int32_t z, int32_t px, int32_t py, int32_t pz);
 
 MultiplayerConnection::MultiplayerConnection(const std::string& host, unsigned short port)
     :mConn([this](Identifier id, unsigned char* data, size_t len)
@@ -39,26 +40,52 @@ MultiplayerConnection::MultiplayerConnection(const std::string& host, unsigned s
     {
         if (s2c::VerifyChunkBuffer(v))
         {
-            //std::lock_guard<std::mutex> lock(mMutex);
-            const s2c::Chunk *fbChunk = s2c::GetChunk(data);// TODO: Optimize
-            Chunk* nwchunk = new Chunk({ fbChunk->pos()->x(), fbChunk->pos()->y(), fbChunk->pos()->z() }, *mWorld);
-            for (auto i = 0; i < Chunk::Size() * Chunk::Size() * Chunk::Size(); i++)
-                nwchunk->getBlocks()[i] = BlockData(fbChunk->blocks()->Get(i));
-            auto c = nwchunk;
-            c->setUpdated(true);
-            constexpr std::array<Vec3i, 6> delta
+            std::unique_ptr<Chunk> chunk = ChunkPacket::decode(*s2c::GetChunk(data), *mWorld, mWorld->getBlockTypes().size());
+            if (!chunk)
             {
-                Vec3i(1, 0, 0), Vec3i(-1, 0, 0),
-                Vec3i(0, 1, 0), Vec3i(0,-1, 0),
-                Vec3i(0, 0, 1), Vec3i(0, 0,-1)
-            };
-            for (auto&& p : delta)
-                mWorld->doIfChunkLoaded(c->getPosition() + p, [](Chunk& chk)
-            { chk.setUpdated(true); });
-            mWorld->resetChunk(c->getPosition(), c);
+                warningstream << "Malformed chunk packet dropped";
+                break;
+            }
+            mRequests.answer(chunk->getPosition());
+            // Only the game thread writes the world; it takes the chunk in flushChunkRequests()
+            std::lock_guard<std::mutex> lock(mReceivedMutex);
+            mReceived.push_back(std::move(chunk));
         }
         break;
     }
+    case Identifier::s2cChunksUnmodified:
+    {
+        if (!s2c::VerifyChunksUnmodifiedBuffer(v))
+            break;
+        auto ret = s2c::GetChunksUnmodified(data);
+        if (ret->offsets())
+            ChunkOffsets::forEach(Vec3i(ret->px(), ret->py(), ret->pz()), reinterpret_cast<const int8_t*>(ret->offsets()->Data()),
+                                  ret->offsets()->size(), [this](const Vec3i& pos) { mRequests.answer(pos); });
+        break;
+    }
+    case Identifier::s2cChunkRequestsAck:
+    {
+        if (!s2c::VerifyChunkRequestsAckBuffer(v))
+            break;
+        auto ack = s2c::GetChunkRequestsAck(data);
+        const Vec3i centre(ack->px(), ack->py(), ack->pz());
+        if (ack->accepted())
+            ChunkOffsets::forEach(centre, reinterpret_cast<const int8_t*>(ack->accepted()->Data()), ack->accepted()->size(),
+                                  [this](const Vec3i& pos) { mRequests.acknowledge(pos); });
+        if (ack->refused())
+        {
+            const auto now = ChunkRequestTracker::Clock::now();
+            ChunkOffsets::forEach(centre, reinterpret_cast<const int8_t*>(ack->refused()->Data()), ack->refused()->size(),
+                                  [this, now](const Vec3i& pos) { mRequests.refuse(pos, now); });
+        }
+        break;
+    }
+    case Identifier::s2cHandshakeRet:
+    {
+        if (s2c::VerifyHandshakeRetBuffer(v))
+            infostream << "Server sends chunks with codec " << static_cast<int>(s2c::GetHandshakeRet(data)->chunkCodec());
+        break;
+    }
     default:
         warningstream << "Unsupported game packet received: " << static_cast<int>(id);
     }
@@ -88,6 +115,11 @@ World* MultiplayerConnection::getWorld(size_t)
 void MultiplayerConnection::waitForConnected()
 {
     mConn.waitForConnected();
+    // Chunk packets say their codec, so the reply is only informative. The server sends chunks as far as
+    // the load range, where the world unloads them.
+    const uint8_t loadRange = static_cast<uint8_t>(std::min(mWorld->getLoadRange(), static_cast<int>(UINT8_MAX)));
+    mConn.send<c2s::Handshake>(FlatFactory::c2s::Handshake(ChunkPacket::getCodecs(), loadRange), PacketPriority::HIGH_PRIORITY,
+                               PacketReliability::RELIABLE_ORDERED);
 }
 
 void MultiplayerConnection::login(const char *username, const char *password)
@@ -95,12 +127,56 @@ void MultiplayerConnection::login(const char *username, const char *password)
     mConn.send<c2s::Login>(FlatFactory::c2s::Login(username,password),PacketPriority::HIGH_PRIORITY, PacketReliability::RELIABLE_ORDERED_WITH_ACK_RECEIPT);
 }
 
-void MultiplayerConnection::getChunk(Vec3i pos)
+void MultiplayerConnection::getChunk(Vec3i pos, Vec3i playerChunkPos)
 {
     // Pre-Load the Chunk.
     mWorld->addChunk(pos);
-    // Requese From The Server
-    mConn.send<c2s::RequestChunk>(FlatFactory::c2s::RequestChunk(pos), PacketPriority::MEDIUM_PRIORITY, PacketReliability::UNRELIABLE);
+    // Requested from the server with the others of this tick in flushChunkRequests()
+    mRequests.request(pos);
+}
+
+void MultiplayerConnection::flushChunkRequests(Vec3i playerChunkPos)
+{
+    std::vector<std::unique_ptr<Chunk>> received;
+    {
+        std::lock_guard<std::mutex> lock(mReceivedMutex);
+        received.swap(mReceived);
+    }
+    for (auto&& chunk : received)
+    {
+        const Vec3i pos = chunk->getPosition();
+        // Unloaded since it was requested
+        if (!mWorld->isChunkLoaded(pos))
+            continue;
+        chunk->setUpdated(true);
+        mWorld->markNeighboursUpdated(pos);
+        mWorld->resetChunk(pos, chunk.release());
+    }
+
+    // A request is wanted while the chunk generated in its place is loaded
+    const std::vector<Vec3i> positions = mRequests.collect(std::chrono::steady_clock::now(),
+                                                           [this](const Vec3i& pos) { return mWorld->isChunkLoaded(pos); });
+    std::vector<int8_t> offsets;
+    auto sendBatch = [&]
+    {
+        if (offsets.empty())
+            return;
+        mConn.send<c2s::RequestChunks>(FlatFactory::c2s::RequestChunks(playerChunkPos, offsets), PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+        offsets.clear();
+    };
+    for (auto&& pos : positions)
+    {
+        // Too far to name by offset
+        if (!ChunkOffsets::fits(playerChunkPos, pos))
+        {
+            mConn.send<c2s::RequestChunk>(FlatFactory::c2s::RequestChunk(pos, playerChunkPos), PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+            continue;
+        }
+        ChunkOffsets::append(playerChunkPos, pos, offsets);
+        if (offsets.size() == RequestBatch * 3)
+            sendBatch();
+    }
+    sendBatch();
 }
 
 LocalConnection::LocalConnection():
@@ -157,21 +233,15 @@ void LocalConnection::login(const char * username, const char * password)
     nwLocalServerLogin(username, password);
 }
 
-void LocalConnection::getChunk(Vec3i pos)
+void LocalConnection::getChunk(Vec3i pos, Vec3i playerChunkPos)
 {
-    auto c = nwLocalServerGetChunk(pos.x, pos.y, pos.z);
-    Assert(c);
+    // nullptr while the server is still generating it; it is requested again next frame.
+    // Otherwise the server already took the reference released by DeReference.
+    auto c = nwLocalServerGetChunk(pos.x, pos.y, pos.z, playerChunkPos.x, playerChunkPos.y, playerChunkPos.z);
+    if (!c)
+        return;
     c->setUpdated(true);
-    constexpr std::array<Vec3i, 6> delta
-    {
-        Vec3i(1, 0, 0), Vec3i(-1, 0, 0),
-        Vec3i(0, 1, 0), Vec3i(0,-1, 0),
-        Vec3i(0, 0, 1), Vec3i(0, 0,-1)
-    };
-    for (auto&& p : delta)
-        mWorld->doIfChunkLoaded(c->getPosition() + p, [](Chunk& chk)
-    { chk.setUpdated(true); });
-    c->increaseRef();
+    mWorld->markNeighboursUpdated(c->getPosition());
     mWorld->insertChunk(c->getPosition(), std::move(ChunkManager::data_t(c, ChunkOnReleaseBehavior::Behavior::DeReference)));
 }
 
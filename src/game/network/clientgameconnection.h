@@ -23,6 +23,7 @@
 #include <string>
 #include <functional>
 #include "network.h"
+#include "chunkrequests.h"
 #include <engine/common.h>
 #include <world/worldclient.h>
 
@@ -39,8 +40,14 @@ public:
     virtual void login(const char* username, const char* password) = 0;
 
     // Functions
-    virtual void getChunk(Vec3i pos) = 0;
+    // playerChunkPos decides which requested chunks the server generates first
+    virtual void getChunk(Vec3i pos, Vec3i playerChunkPos) = 0;
+    // Once per tick after getChunk(), on the game thread: put the chunks received since in the world, send the requests
+    // made since, and again those not acknowledged in time or refused
+    virtual void flushChunkRequests(Vec3i playerChunkPos) {}
     virtual World* getWorld(size_t id) = 0;
+    // Chunk requests to a remote server; none for a local one
+    virtual ChunkRequestTracker::Stats getRequestStats() const { return{ 0, 0, 0, 0, 0, 0 }; }
 
     // Callbacks
     void setWorld(WorldClient* w){ mWorld = w; }
@@ -60,8 +67,13 @@ public:
     void login(const char* username, const char* password) override;
 
     // Functions
-    void getChunk(Vec3i pos) override;
+    void getChunk(Vec3i pos, Vec3i playerChunkPos) override;
+    void flushChunkRequests(Vec3i playerChunkPos) override;
     World* getWorld(size_t id) override;
+    ChunkRequestTracker::Stats getRequestStats() const override { return mRequests.getStats(); }
+
+    // Chunks per c2s::RequestChunks, so one fits a datagram
+    static constexpr size_t RequestBatch = 400;
 protected:
     ClientConnection mConn;
 
@@ -69,6 +81,10 @@ private:
     std::string mHost;
     unsigned short mPort;
     flatbuffers::FlatBufferBuilder mFbb;
+    ChunkRequestTracker mRequests;
+    // Decoded on the network thread, for the game thread to put in the world
+    std::mutex mReceivedMutex;
+    std::vector<std::unique_ptr<Chunk>> mReceived;
 };
 
 // Tunnel Connection : Client Side
@@ -86,7 +102,7 @@ public:
     void login(const char* username, const char* password) override;
 
     // Functions
-    void getChunk(Vec3i pos) override;
+    void getChunk(Vec3i pos, Vec3i playerChunkPos) override;
     World* getWorld(size_t id) override;
 private:
     std::thread mLocalServerThread;
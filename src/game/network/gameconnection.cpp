@@ -18,18 +18,104 @@
 */
 
 #include "gameconnection.h"
+#include "chunkpacket.h"
+#include "builderpool.h"
+#include "chunkrequests.h"
 #include "world/nwchunk.h"
 #include <engine/common.h>
 #include <flatfactory.h>
 
-void ServerMultiplayerConnection::sendChunk(Chunk* chunk)
+namespace
 {
-    auto pos = s2c::Vec3(chunk->getPosition().conv<s2c::Vec3>());
-    // Be careful!
-    Assert(sizeof(BlockData) == sizeof(uint32_t));
-    std::vector<int> blocks(reinterpret_cast<uint32_t*>(chunk->getBlocks()),
-                            reinterpret_cast<uint32_t*>(chunk->getBlocks()) + Chunk::Size()*Chunk::Size()*Chunk::Size());
-    mConn.send<s2c::Chunk>(FlatFactory::s2c::Chunk(pos,blocks), PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+    // Offsets from centre of the positions that fit. Within the send range all do, unless the player moved
+    // far since; the client has unloaded those or asks for them again.
+    std::vector<int8_t> toOffsets(const Vec3i& centre, const std::vector<Vec3i>& positions)
+    {
+        std::vector<int8_t> offsets;
+        offsets.reserve(positions.size() * 3);
+        for (auto&& pos : positions)
+            if (ChunkOffsets::fits(centre, pos))
+                ChunkOffsets::append(centre, pos, offsets);
+        return offsets;
+    }
+}
+
+size_t ServerMultiplayerConnection::sendChunk(Chunk* chunk)
+{
+    // A large builder of this thread, keeping its 128 KiB buffer between chunks and connections
+    auto fbb = BuilderPool::acquire(BuilderPool::SizeClass::Large);
+    ChunkPacket::encode(*fbb, *chunk, mChunkCodec);
+    mConn.send<s2c::Chunk>(*fbb, PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+    // With the packet header
+    return fbb->GetSize() + 3;
+}
+
+void ServerMultiplayerConnection::update()
+{
+    World* world = mWorlds.getWorld(0);// TODO:Current world of player.
+    // Unloaded while they waited: loaded again and queued anew once the flush lets go of the queue
+    std::vector<Vec3i> unloaded;
+    mSendQueue.flush([this, world, &unloaded](const Vec3i& pos) -> size_t
+    {
+        if (Chunk* chunk = world->getChunks().find(pos))
+            return sendChunk(chunk);
+        unloaded.push_back(pos);
+        return 0;
+    }, [this](const Vec3i& pos) { mRefused.push_back(pos); });
+    for (auto&& pos : unloaded)
+        requestChunk(*world, pos);
+    // Ordered, so a refusal never overtakes the acknowledgement of the same request
+    if (!mAccepted.empty() || !mRefused.empty())
+    {
+        mConn.send<s2c::ChunkRequestsAck>(FlatFactory::s2c::ChunkRequestsAck(mPlayer, toOffsets(mPlayer, mAccepted), toOffsets(mPlayer, mRefused)),
+                                          PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE_ORDERED);
+        mAccepted.clear();
+        mRefused.clear();
+    }
+    if (mUnmodified.empty())
+        return;
+    mConn.send<s2c::ChunksUnmodified>(FlatFactory::s2c::ChunksUnmodified(mPlayer, toOffsets(mPlayer, mUnmodified)),
+                                      PacketPriority::MEDIUM_PRIORITY, PacketReliability::RELIABLE);
+    mUnmodified.clear();
+}
+
+void ServerMultiplayerConnection::setPlayer(const Vec3i& chunkPos)
+{
+    mPlayer = chunkPos;
+    mSendQueue.setObserver(chunkPos);
+}
+
+void ServerMultiplayerConnection::takeRequest(World& world, const Vec3i& pos)
+{
+    // Out of the client's load range as of its request: it won't keep the chunk, so it isn't even loaded
+    if (!mSendQueue.inRange(pos))
+    {
+        mRefused.push_back(pos);
+        return;
+    }
+    mAccepted.push_back(pos);
+    requestChunk(world, pos);
+}
+
+void ServerMultiplayerConnection::requestChunk(World& world, const Vec3i& pos)
+{
+    // The loader calls back on this (network) thread; the connection may be gone by then
+    std::weak_ptr<bool> alive = mAlive;
+    auto onLoaded = [this, alive](Chunk& chunk)
+    {
+        if (alive.expired())
+            return;
+        chunk.markRequest();
+        // The client generates unmodified chunks itself and only needs to hear it has them right
+        if (chunk.isModified())
+            mSendQueue.push(chunk.getPosition());
+        else
+            mUnmodified.push_back(chunk.getPosition());
+    };
+    if (Chunk* chunk = world.getChunks().find(pos))
+        onLoaded(*chunk);
+    else
+        mWorlds.getLoader().request(world, pos, mPlayer, onLoaded);
 }
 
 void ServerMultiplayerConnection::handleReceivedData(Identifier id, unsigned char* data, size_t len)
@@ -37,6 +123,24 @@ void ServerMultiplayerConnection::handleReceivedData(Identifier id, unsigned cha
     flatbuffers::Verifier v(data,len);
     switch (id)
     {
+    case Identifier::c2sHandshake:
+    {
+        if (!c2s::VerifyHandshakeBuffer(v)) break;
+        auto handshake = c2s::GetHandshake(data);
+        if (handshake->versionId() != NEWorldVersion)
+            warningstream << "Handshake from version " << handshake->versionId() << ", server is " << NEWorldVersion;
+        // Clients that never handshake keep getting raw chunks
+        if (handshake->codecs())
+            mChunkCodec = ChunkPacket::negotiate(handshake->codecs()->Data(), handshake->codecs()->size());
+        // Send as far as the client keeps chunks loaded, so the queue drops only those it unloaded as well.
+        // Clients that don't say get the server's chunk_send_distance. Acknowledgements name chunks by offset.
+        if (handshake->loadRange())
+            mSendQueue.setRange(std::min<int>(handshake->loadRange(), INT8_MAX));
+        infostream << "Sending chunks with codec " << static_cast<int>(mChunkCodec);
+        mConn.send<s2c::HandshakeRet>(FlatFactory::s2c::HandshakeRet(handshake->versionId(), static_cast<uint8_t>(mChunkCodec)),
+                                      PacketPriority::HIGH_PRIORITY, PacketReliability::RELIABLE_ORDERED);
+        break;
+    }
     case Identifier::c2sLogin:
     {
         if(!c2s::VerifyLoginBuffer(v)) break;
@@ -62,12 +166,19 @@ void ServerMultiplayerConnection::handleReceivedData(Identifier id, unsigned cha
         if(!c2s::VerifyRequestChunkBuffer(v)) break;
         auto req = c2s::GetRequestChunk(data);
         World *world = mWorlds.getWorld(0);// TODO:Current world of player.
-        if (!world->isChunkLoaded({req->x(), req->y(), req->z()}))
-            world->addChunk({req->x(), req->y(), req->z()});
-        auto& chunk = world->getChunk({req->x(), req->y(), req->z()});
-        chunk.markRequest();
-        if (chunk.isModified()) 
-            sendChunk(&chunk);
+        setPlayer(Vec3i(req->px(), req->py(), req->pz()));
+        takeRequest(*world, Vec3i(req->x(), req->y(), req->z()));
+        break;
+    }
+    case Identifier::c2sRequestChunks:
+    {
+        if(!c2s::VerifyRequestChunksBuffer(v)) break;
+        auto req = c2s::GetRequestChunks(data);
+        World *world = mWorlds.getWorld(0);// TODO:Current world of player.
+        setPlayer(Vec3i(req->px(), req->py(), req->pz()));
+        if (req->offsets())
+            ChunkOffsets::forEach(mPlayer, reinterpret_cast<const int8_t*>(req->offsets()->Data()), req->offsets()->size(),
+                                  [this, world](const Vec3i& pos) { takeRequest(*world, pos); });
         break;
     }
     default:
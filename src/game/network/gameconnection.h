@@ -22,6 +22,8 @@
 
 #include "networkmanager.h"
 #include "connection.h"
+#include "chunkpacket.h"
+#include "chunksendqueue.h"
 #include <world/world.h>
 
 class ServerGameConnection
@@ -30,21 +32,47 @@ public:
     virtual ~ServerGameConnection() = default;
 
     // Functions
-    virtual void sendChunk(Chunk* chunk) = 0;
+    // Returns the bytes sent
+    virtual size_t sendChunk(Chunk* chunk) = 0;
     virtual void handleReceivedData(Identifier id, unsigned char* data, size_t len) = 0;
+    // Runs once per network tick
+    virtual void update() = 0;
+    virtual ChunkSendQueue::Stats getSendStats() const = 0;
 };
 
 class ServerMultiplayerConnection : public ServerGameConnection
 {
 public:
-    ServerMultiplayerConnection(WorldManager& wm,NetworkManager &network, RakNet::RakPeerInterface *peer, RakNet::SystemAddress addr)
-        :mConn(network,peer,addr), mWorlds(wm) {}
+    // Requested chunks go out at most chunkBudget bytes a tick, while within chunkRange of the player
+    // until the client's handshake gives its load range
+    ServerMultiplayerConnection(WorldManager& wm,NetworkManager &network, RakNet::RakPeerInterface *peer, RakNet::SystemAddress addr,
+                                size_t chunkBudget, int chunkRange)
+        :mConn(network,peer,addr), mWorlds(wm), mSendQueue(chunkBudget, chunkRange) {}
 
-    void sendChunk(Chunk* chunk) override;
+    size_t sendChunk(Chunk* chunk) override;
+    void update() override;
+    ChunkSendQueue::Stats getSendStats() const override { return mSendQueue.getStats(); }
 private:
     void handleReceivedData(Identifier id, unsigned char* data, size_t len) override;
+    // Chunk position of the player, from its latest request
+    void setPlayer(const Vec3i& chunkPos);
+    // A request from the client: acknowledged and passed to requestChunk, or refused if out of range
+    void takeRequest(World& world, const Vec3i& pos);
+    // Queue the chunk for sending, or for s2c::ChunksUnmodified, once it is loaded
+    void requestChunk(World& world, const Vec3i& pos);
     Connection mConn;
     WorldManager& mWorlds;
+    // Agreed in the client's handshake
+    ChunkCodec mChunkCodec = ChunkCodec::Raw;
+    // Loaded chunks the client asked for, waiting for their turn
+    ChunkSendQueue mSendQueue;
+    // Requested and loaded, for the next s2c::ChunksUnmodified
+    std::vector<Vec3i> mUnmodified;
+    // Requests taken and refused since the last s2c::ChunkRequestsAck
+    std::vector<Vec3i> mAccepted, mRefused;
+    Vec3i mPlayer{ 0, 0, 0 };
+    // Expires with the connection, for callbacks that may outlive it
+    std::shared_ptr<bool> mAlive = std::make_shared<bool>(true);
 };
 
 #endif
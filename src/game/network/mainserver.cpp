@@ -80,7 +80,7 @@ void NWAPICALL nwLocalServerLogin(const char* username, const char* password)
     reinterpret_cast<LocalTunnelServer*>(server)->login(username, password);
 }
 
-Chunk* NWAPICALL nwLocalServerGetChunk(int32_t x, int32_t y, int32_t z)
+Chunk* NWAPICALL nwLocalServerGetChunk(int32_t x, int32_t y, int32_t z, int32_t px, int32_t py, int32_t pz)
 {
-    return reinterpret_cast<LocalTunnelServer*>(server)->getChunk(x, y, z);
+    return reinterpret_cast<LocalTunnelServer*>(server)->getChunk({ x, y, z }, { px, py, pz });
 }
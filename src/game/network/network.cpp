@@ -112,9 +112,10 @@ void ClientConnection::loop()
 }
 void ClientConnection::sendRawData(Identifier id, const unsigned char *data, uint32_t len, PacketPriority priority, PacketReliability reliability)
 {
-    RakNet::BitStream bsOut;
-    bsOut.Write(static_cast<RakNet::MessageID>(ID_USER_PACKET_ENUM));
-    bsOut.Write(static_cast<int16_t>(id));
-    bsOut.WriteBits(data, len * CHAR_BIT);
-    mPeer->Send(&bsOut, priority, reliability, 0, mAddr, false);
+    // Same layout as Connection::sendRawData, without a BitStream copy
+    const char header[3] = { static_cast<char>(ID_USER_PACKET_ENUM), static_cast<char>(static_cast<int16_t>(id) >> 8),
+                             static_cast<char>(static_cast<int16_t>(id) & 0xFF) };
+    const char* parts[2] = { header, reinterpret_cast<const char*>(data) };
+    const int lengths[2] = { sizeof(header), static_cast<int>(len) };
+    mPeer->SendList(parts, lengths, 2, priority, reliability, 0, mAddr, false);
 }
@@ -35,6 +35,7 @@ NetworkManager::NetworkManager(WorldManager& wm):mWorlds(wm)
 
 NetworkManager::~NetworkManager()
 {
+    mConns.clear();
     RakNet::RakPeerInterface::DestroyInstance(mPeer);
 }
 
@@ -49,7 +50,9 @@ bool NetworkManager::start(const char *addr,unsigned short port)
     sd.socketFamily = AF_INET; // IPv4
     RakNet::StartupResult ret = mPeer->Startup(max_client,&sd,1);
     mPeer->SetMaximumIncomingConnections(max_client);
-    mConns.reserve(max_client);
+    // About 4 MB/s per client at the 30 ms tick of loop()
+    mChunkSendBudget = getJsonValue<size_t>(getSettings()["server"]["chunk_send_budget"], 128 * 1024);
+    mChunkSendRange = getJsonValue<int>(getSettings()["server"]["chunk_send_distance"], 16);
     if(ret == RakNet::StartupResult::RAKNET_STARTED)
     {
         return true;
@@ -94,7 +97,9 @@ void NetworkManager::loop()
                                   << " From " << p->systemAddress.ToString(true);
                     break;
                 }
-                mConns[mPeer->GetIndexFromSystemAddress(p->systemAddress)]->handleReceivedData(identifier, p->data + 3, p->length - 3);
+                auto iter = mConns.find(p->systemAddress);
+                if (iter != mConns.end())
+                    iter->second->handleReceivedData(identifier, p->data + 3, p->length - 3);
                 break;
             }
             default:
@@ -102,8 +107,11 @@ void NetworkManager::loop()
                 break;
             }
         }
+        mWorlds.getLoader().poll();
         for (auto& w : mWorlds)
             w->updateChunkLoadStatus();
+        for (auto&& conn : mConns)
+            conn.second->update();
         RakSleep(30);
     }
     debugstream << "Stop listening.";
@@ -111,12 +119,23 @@ void NetworkManager::loop()
 
 ServerGameConnection* NetworkManager::newConnection(RakNet::SystemAddress addr)
 {
-    ServerGameConnection *c = new ServerMultiplayerConnection(mWorlds,*this,mPeer,addr);
-    mConns.insert(mConns.begin()+mPeer->GetIndexFromSystemAddress(addr), c);
+    ServerGameConnection *c = new ServerMultiplayerConnection(mWorlds,*this,mPeer,addr,mChunkSendBudget,mChunkSendRange);
+    std::lock_guard<std::mutex> lock(mConnsMutex);
+    mConns[addr].reset(c);
     return c;
 }
 
 void NetworkManager::deleteConnection(RakNet::SystemAddress addr)
 {
-    delete mConns[mPeer->GetIndexFromSystemAddress(addr)];
+    std::lock_guard<std::mutex> lock(mConnsMutex);
+    mConns.erase(addr);
+}
+
+std::vector<std::pair<std::string, ChunkSendQueue::Stats>> NetworkManager::getSendStats() const
+{
+    std::lock_guard<std::mutex> lock(mConnsMutex);
+    std::vector<std::pair<std::string, ChunkSendQueue::Stats>> stats;
+    for (auto&& conn : mConns)
+        stats.emplace_back(conn.first.ToString(true), conn.second->getSendStats());
+    return stats;
 }
@@ -19,6 +19,9 @@
 #ifndef NETWORKMANAGER_H_
 #define NETWORKMANAGER_H_
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <map>
+#include <mutex>
+#include <memory>
 #include <thread>
 #include <climits>
 #include <stdexcept>
@@ -28,6 +31,7 @@
 #include <raknet/RakPeerInterface.h>
 #include <raknet/MessageIdentifiers.h>
 #include "../protocol/gen/protocol.h"
+#include "chunksendqueue.h"
 
 class ServerGameConnection;
 
@@ -48,11 +52,19 @@ public:
     {
         return mIsRunning;
     }
+    // Chunk send queue of each client, by address. Thread safe.
+    std::vector<std::pair<std::string, ChunkSendQueue::Stats>> getSendStats() const;
 private:
     ServerGameConnection* newConnection(RakNet::SystemAddress addr);
     void deleteConnection(RakNet::SystemAddress addr);
     RakNet::RakPeerInterface *mPeer;
-    std::vector<ServerGameConnection*> mConns;
+    // Changed on the network thread only; the lock is for readers on other threads
+    mutable std::mutex mConnsMutex;
+    std::map<RakNet::SystemAddress, std::unique_ptr<ServerGameConnection>> mConns;
+    // From the server settings: chunk bytes per client per tick, and how far from the player chunks are still sent
+    // to clients that don't give their load range
+    size_t mChunkSendBudget = 0;
+    int mChunkSendRange = 0;
     WorldManager& mWorlds;//TODO: maybe use event instead later.
     bool mIsRunning;
 };
@@ -25,6 +25,8 @@
 #include <memory>
 #include <engine/common.h>
 
+class ChunkSnapshot;
+
 struct BlockTexCoord
 {
     size_t pos = 0;
@@ -37,7 +39,10 @@ public:
     virtual ~BlockRenderer() = default;
 
     virtual void flushTexture() = 0;
-    virtual void render(class Chunk* chunk, const Vec3i& pos) = 0;
+    virtual void render(const ChunkSnapshot& chunk, const Vec3i& pos) = 0;
+    // Textures of the 6 faces (right, left, top, bottom, front, back) of a full cube, which lets
+    // the face merging mesher draw the block; nullptr for blocks of any other shape
+    virtual const BlockTexCoord* getFaceTextures() const { return nullptr; }
 };
 
 class DefaultBlockRenderer : public BlockRenderer
@@ -45,7 +50,8 @@ class DefaultBlockRenderer : public BlockRenderer
 public:
     DefaultBlockRenderer(size_t data[]);
     void flushTexture() override;
-    void render(class Chunk* chunk, const Vec3i& pos) override;
+    void render(const ChunkSnapshot& chunk, const Vec3i& pos) override;
+    const BlockTexCoord* getFaceTextures() const override { return tex; }
 private:
     BlockTexCoord tex[6];
 };
@@ -75,8 +81,16 @@ private:
 class BlockRendererManager
 {
 public:
-    static void render(size_t id, class Chunk* chunk, const Vec3i& pos); //RenderList
+    static void render(size_t id, const ChunkSnapshot& chunk, const Vec3i& pos); //RenderList
     static void setBlockRenderer(size_t pos, std::shared_ptr<BlockRenderer>&& blockRenderer);
+    static bool hasRenderer(size_t id)
+    {
+        return id < mBlockRenderers.size() && mBlockRenderers[id];
+    }
+    static const BlockTexCoord* getFaceTextures(size_t id)
+    {
+        return id < mBlockRenderers.size() && mBlockRenderers[id] ? mBlockRenderers[id]->getFaceTextures() : nullptr;
+    }
     static void flushTextures();
 private:
     static std::vector<std::shared_ptr<BlockRenderer>> mBlockRenderers;
@@ -0,0 +1,146 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunkculler.h"
+#include <world/world.h>
+
+constexpr uint8_t ChunkCuller::Listed;
+
+uint16_t ChunkVisibility::compute(const ChunkSnapshot& chunk)
+{
+    constexpr int size = Chunk::Size(), log2 = Chunk::SizeLog2();
+    static_assert(size == 32, "rows of blocks are filled as 32 bit masks");
+    const BlockManager& types = chunk.getWorld()->getBlockTypes();
+    if (chunk.isUniform())
+        return types[chunk.get(0, 0, 0).getID()].isOpaque() ? 0 : All;
+
+    // Open blocks not reached by a fill yet: bit z of row x * size + y
+    static thread_local std::vector<uint32_t> open(size * size);
+    static thread_local std::vector<uint8_t> opaque;
+    static thread_local std::vector<std::pair<int, uint32_t>> stack;
+    opaque.resize(types.size());
+    for (size_t id = 0; id < types.size(); ++id)
+        opaque[id] = types[id].isOpaque();
+    bool closed = false, empty = true;
+    for (int row = 0; row < size * size; ++row)
+    {
+        const BlockData* blocks = chunk.getData() + ChunkSnapshot::index(row >> log2, row & (size - 1), 0);
+        uint32_t bits = 0;
+        for (int z = 0; z < size; ++z)
+            bits |= uint32_t(!opaque[blocks[z].getID()]) << z;
+        open[row] = bits;
+        closed = closed || bits != ~uint32_t(0);
+        empty = empty && bits == 0;
+    }
+    // Nothing in the way, or no way through
+    if (!closed)
+        return All;
+    if (empty)
+        return 0;
+
+    uint16_t visibility = 0;
+    for (int seed = 0; seed < size * size; ++seed)
+        while (open[seed] && visibility != All)
+        {
+            // Fill one region of open blocks a row at a time, noting the faces it touches
+            unsigned faces = 0;
+            stack.emplace_back(seed, open[seed] & (~open[seed] + 1));
+            while (!stack.empty())
+            {
+                const int row = stack.back().first;
+                uint32_t fill = stack.back().second & open[row];
+                stack.pop_back();
+                if (!fill)
+                    continue;
+                // Spread along the row through open blocks
+                for (uint32_t last = 0; fill != last;)
+                {
+                    last = fill;
+                    fill |= ((fill << 1) | (fill >> 1)) & open[row];
+                }
+                open[row] &= ~fill;
+                const int x = row >> log2, y = row & (size - 1);
+                faces |= (x == size - 1) << PosX | (x == 0) << NegX | (y == size - 1) << PosY | (y == 0) << NegY |
+                         unsigned(fill >> (size - 1)) << PosZ | (fill & 1) << NegZ;
+                if (x < size - 1 && (open[row + size] & fill))
+                    stack.emplace_back(row + size, fill);
+                if (x > 0 && (open[row - size] & fill))
+                    stack.emplace_back(row - size, fill);
+                if (y < size - 1 && (open[row + 1] & fill))
+                    stack.emplace_back(row + 1, fill);
+                if (y > 0 && (open[row - 1] & fill))
+                    stack.emplace_back(row - 1, fill);
+            }
+            for (int a = 0; a < FaceCount; ++a)
+                for (int b = a + 1; b < FaceCount; ++b)
+                    if ((faces >> a & 1) && (faces >> b & 1))
+                        visibility |= 1u << pairBit(a, b);
+        }
+    return visibility;
+}
+
+const std::vector<Vec3i>& ChunkCuller::cull(const Vec3i& center, int range, const Frustum* frustum, const Visibility& visibility)
+{
+    static const Vec3i delta[ChunkVisibility::FaceCount] =
+    {
+        Vec3i(1, 0, 0), Vec3i(-1, 0, 0), Vec3i(0, 1, 0), Vec3i(0, -1, 0), Vec3i(0, 0, 1), Vec3i(0, 0, -1)
+    };
+    const int width = range * 2 + 1;
+    auto index = [&](const Vec3i& pos)
+    {
+        return ((pos.x - center.x + range) * width + pos.y - center.y + range) * width + pos.z - center.z + range;
+    };
+
+    mVisible.clear();
+    mQueue.clear();
+    mVisited.assign(size_t(width) * width * width, 0);
+    // The camera chunk is always drawn: the near plane may cut it. Walking it again by any face adds nothing.
+    mQueue.push_back({ center, ChunkVisibility::FaceCount, 0 });
+    mVisited[index(center)] = Listed - 1;
+    // Breadth first, so the list comes out roughly front to back
+    for (size_t head = 0; head < mQueue.size(); ++head)
+    {
+        const Step step = mQueue[head];
+        uint8_t& visited = mVisited[index(step.pos)];
+        if (!(visited & Listed))
+        {
+            visited |= Listed;
+            mVisible.push_back(step.pos);
+        }
+        const uint16_t through = (visibility && step.entry != ChunkVisibility::FaceCount) ? visibility(step.pos) : ChunkVisibility::All;
+        for (int face = 0; face < ChunkVisibility::FaceCount; ++face)
+        {
+            // Never turn back along an axis already walked the other way
+            if (step.directions & (1u << ChunkVisibility::opposite(face)))
+                continue;
+            if (visibility && step.entry != ChunkVisibility::FaceCount &&
+                    !ChunkVisibility::connected(through, step.entry, face))
+                continue;
+            const Vec3i next = step.pos + delta[face];
+            const uint8_t entry = uint8_t(1u << ChunkVisibility::opposite(face));
+            if (center.chebyshevDistance(next) > range || (mVisited[index(next)] & entry))
+                continue;
+            if (frustum && !inFrustum(*frustum, next))
+                continue;
+            mVisited[index(next)] |= entry;
+            mQueue.push_back({ next, ChunkVisibility::opposite(face), step.directions | (1u << face) });
+        }
+    }
+    return mVisible;
+}
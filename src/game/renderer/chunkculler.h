@@ -0,0 +1,95 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKCULLER_H_
+#define CHUNKCULLER_H_
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <world/nwchunksnapshot.h>
+#include "frustum.h"
+
+// Which faces of a chunk can see each other through it: bit pairBit(a, b) is set if some path of
+// non-opaque blocks inside the chunk touches both face a and face b.
+class ChunkVisibility
+{
+public:
+    enum Face { PosX, NegX, PosY, NegY, PosZ, NegZ, FaceCount };
+    // Every face sees every other one, as for air or chunks not meshed yet
+    static constexpr uint16_t All = 0x7FFF;
+
+    static constexpr int opposite(int face) noexcept { return face ^ 1; }
+
+    // One of the 15 bits, for faces a != b
+    static constexpr int pairBit(int a, int b) noexcept
+    {
+        return a < b ? a * (11 - a) / 2 + (b - a - 1) : pairBit(b, a);
+    }
+
+    static bool connected(uint16_t visibility, int a, int b) noexcept
+    {
+        return (visibility >> pairBit(a, b)) & 1;
+    }
+
+    // Flood fill the non-opaque blocks of the chunk. Uses no OpenGL, so any thread may call it.
+    static uint16_t compute(const ChunkSnapshot& chunk);
+};
+
+// Picks the chunks worth drawing: those in the view frustum and, with a visibility function, reachable
+// from the camera chunk through chunks whose visibility connects the faces the walk enters and leaves by.
+// The walk never turns back along an axis, so chunks behind walls, under the ground or in caves the camera
+// is not in are skipped. Each chunk is walked once per face it is entered by, as what it leads on to depends
+// on that face. It can keep chunks that are hidden in fact. It can also drop a visible one: lines of sight
+// across chunk edges or corners, and chunks entered by a face only along a walk that already turned the way
+// the line of sight goes on, are not followed.
+class ChunkCuller
+{
+public:
+    using Visibility = std::function<uint16_t(const Vec3i&)>;
+
+    // Chunks within Chebyshev distance range of center that may be visible, nearest walk steps first.
+    // frustum may be nullptr to skip frustum tests; visibility may be empty to skip occlusion.
+    const std::vector<Vec3i>& cull(const Vec3i& center, int range, const Frustum* frustum, const Visibility& visibility);
+
+    // Whether the chunk box is in the frustum
+    static bool inFrustum(const Frustum& frustum, const Vec3i& chunkPos) noexcept
+    {
+        const Vec3f min(chunkPos * Chunk::Size());
+        return frustum.intersects(min, min + Vec3f(float(Chunk::Size()), float(Chunk::Size()), float(Chunk::Size())));
+    }
+
+private:
+    struct Step
+    {
+        Vec3i pos;
+        // Face the walk came in by, FaceCount for the camera chunk
+        int entry;
+        // Directions taken so far, bit per Face
+        unsigned directions;
+    };
+
+    std::vector<Vec3i> mVisible;
+    std::vector<Step> mQueue;
+    // Per chunk in range: bit per Face it was entered by, and Listed once in mVisible
+    static constexpr uint8_t Listed = 1 << ChunkVisibility::FaceCount;
+    std::vector<uint8_t> mVisited;
+};
+
+#endif // !CHUNKCULLER_H_
@@ -0,0 +1,143 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include "chunkmeshbuilder.h"
+
+void ChunkMeshBuilder::start(size_t threads)
+{
+    // Restarts the workers only: what is queued stays
+    mWorkers.start<Job>(threads, mMutex, [this](Job& job) { return take(job); }, [this](Job& job) { build(job); });
+    infostream << "Chunk mesh builder started with " << threads << " worker threads";
+}
+
+void ChunkMeshBuilder::stop()
+{
+    mWorkers.stop();
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.clear();
+    mReady.clear();
+    mInFlight.clear();
+    ++mGeneration;
+}
+
+bool ChunkMeshBuilder::request(std::unique_ptr<ChunkSnapshot> snapshot, bool merge, bool packed, unsigned sections, int priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mInFlight.insert(snapshot->getPosition()).second)
+            return false;
+        mQueue.push_back(Job{ priority, merge, packed, sections, std::move(snapshot), 0 });
+        std::push_heap(mQueue.begin(), mQueue.end());
+    }
+    mWorkers.notifyOne();
+    return true;
+}
+
+bool ChunkMeshBuilder::isInFlight(const Vec3i& pos) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mInFlight.count(pos) != 0;
+}
+
+std::vector<ChunkMesh> ChunkMeshBuilder::poll(size_t byteBudget)
+{
+    std::vector<ChunkMesh> meshes;
+    size_t bytes = 0;
+    // No workers: mesh queued snapshots on this thread, within the same budget
+    if (mWorkers.empty())
+    {
+        Job job;
+        for (bool meshed = false;; meshed = true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if ((meshed && bytes >= byteBudget) || !take(job))
+                    break;
+            }
+            build(job);
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mReady.empty())
+                bytes += mReady.back().getSize();
+        }
+    }
+
+    bytes = 0;
+    std::lock_guard<std::mutex> lock(mMutex);
+    while (!mReady.empty() && (meshes.empty() || bytes + mReady.front().getSize() <= byteBudget))
+    {
+        bytes += mReady.front().getSize();
+        mInFlight.erase(mReady.front().position);
+        meshes.push_back(std::move(mReady.front()));
+        mReady.pop_front();
+    }
+    return meshes;
+}
+
+void ChunkMeshBuilder::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mQueue.clear();
+    mReady.clear();
+    // Meshes still being built are discarded by generation and leave the set alone
+    mInFlight.clear();
+    ++mGeneration;
+}
+
+size_t ChunkMeshBuilder::getPending() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mQueue.size() + mBuilding + mReady.size();
+}
+
+ChunkMeshBuilder::Stats ChunkMeshBuilder::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return{ mQueue.size(), mBuilding, mReady.size(), mBuilt, mBuilt ? mBuildTimeSum / mBuilt : 0.0 };
+}
+
+bool ChunkMeshBuilder::take(Job& job)
+{
+    if (mQueue.empty())
+        return false;
+    std::pop_heap(mQueue.begin(), mQueue.end());
+    job = std::move(mQueue.back());
+    job.generation = mGeneration;
+    mQueue.pop_back();
+    ++mBuilding;
+    return true;
+}
+
+void ChunkMeshBuilder::build(Job& job)
+{
+    using namespace std::chrono;
+    const auto begin = steady_clock::now();
+    ChunkMesh mesh = ChunkRenderer::buildMesh(*job.snapshot, job.merge, job.packed, job.sections);
+    const double time = duration<double, std::milli>(steady_clock::now() - begin).count();
+    // The worker keeps the job until it takes the next one
+    job.snapshot.reset();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    --mBuilding;
+    ++mBuilt;
+    mBuildTimeSum += time;
+    if (job.generation == mGeneration)
+        mReady.push_back(std::move(mesh));
+}
@@ -0,0 +1,101 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKMESHBUILDER_H_
+#define CHUNKMESHBUILDER_H_
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_set>
+#include "chunkrenderer.h"
+
+// Meshes chunk snapshots on a pool of worker threads.
+// Queued snapshots are meshed lowest priority value first. Finished meshes wait until poll(),
+// which the GL thread calls to upload them a frame's budget at a time. A position has one mesh in
+// flight at most, from its request until poll() returns it.
+// Touches no OpenGL state, so it also runs without a window (see mesh_bench).
+class ChunkMeshBuilder : public NonCopyable
+{
+public:
+    struct Stats
+    {
+        // Waiting for a worker / being meshed / waiting for poll()
+        size_t queued, building, ready;
+        // Meshed since start, discarded ones included, and the average milliseconds each took
+        size_t built;
+        double averageBuildTime;
+    };
+
+    ChunkMeshBuilder() = default;
+    ~ChunkMeshBuilder() { stop(); }
+
+    // Start worker threads, or restart them with another count; queued snapshots are kept.
+    // Without workers, poll() meshes queued snapshots itself.
+    void start(size_t threads);
+    // Stop and join the workers. Meshes not yet polled are dropped.
+    void stop();
+
+    // Queue a snapshot for meshing, see ChunkRenderer::buildMesh. Returns false, dropping the snapshot, if a mesh
+    // of its position is in flight already. Thread safe.
+    bool request(std::unique_ptr<ChunkSnapshot> snapshot, bool merge, bool packed, unsigned sections, int priority);
+    // Whether a mesh of the chunk at pos was requested and not yet returned by poll()
+    bool isInFlight(const Vec3i& pos) const;
+
+    // Take finished meshes until their size reaches byteBudget; at least one if any is ready.
+    std::vector<ChunkMesh> poll(size_t byteBudget);
+
+    // Drop everything requested so far, including meshes still being built
+    void clear();
+
+    // Requested and not yet returned by poll()
+    size_t getPending() const;
+    Stats getStats() const;
+
+private:
+    struct Job
+    {
+        int priority;
+        bool merge, packed;
+        unsigned sections;
+        std::unique_ptr<ChunkSnapshot> snapshot;
+        // Of the builder when the job was taken, see mGeneration
+        size_t generation;
+        bool operator<(const Job& rhs) const noexcept { return priority > rhs.priority; }
+    };
+
+    mutable std::mutex mMutex;
+    // Heap of jobs, lowest priority value on top
+    std::vector<Job> mQueue;
+    std::deque<ChunkMesh> mReady;
+    // Positions requested and not yet polled
+    std::unordered_set<Vec3i, ChunkHasher> mInFlight;
+    WorkerPool mWorkers;
+    // Bumped by clear(), so meshes started before it are discarded
+    size_t mGeneration = 0;
+    size_t mBuilding = 0, mBuilt = 0;
+    double mBuildTimeSum = 0.0;
+
+    // Pop the most urgent job into job. Returns false if nothing is queued. Requires mMutex.
+    bool take(Job& job);
+    void build(Job& job);
+};
+
+#endif // !CHUNKMESHBUILDER_H_
@@ -0,0 +1,237 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "chunkmeshpool.h"
+
+constexpr size_t ChunkMeshPool::ArenaVertexes;
+constexpr uint32_t ChunkMeshPool::MaxSlots, ChunkMeshPool::OriginWidth, ChunkMeshPool::NoSlot;
+
+ChunkMeshPool::Allocation ChunkMeshPool::allocate(const PackedVertex* data, size_t vertexes)
+{
+    Allocation allocation;
+    if (vertexes == 0)
+        return allocation;
+    // Existing buffers first, then a freed entry or a new one
+    size_t i = 0;
+    for (; i < mArenas.size(); ++i)
+        if (mArenas[i].buffer && (allocation.handle = place(i, vertexes)) != MeshArena::Invalid)
+            break;
+    if (i == mArenas.size())
+    {
+        for (i = 0; i < mArenas.size() && mArenas[i].buffer; ++i);
+        const size_t capacity = std::max(ArenaVertexes, vertexes);
+        if (i == mArenas.size())
+            mArenas.push_back({ MeshArena(capacity), 0, {}, {} });
+        else
+            mArenas[i].ranges = MeshArena(capacity);
+        glGenBuffersARB(1, &mArenas[i].buffer);
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, mArenas[i].buffer);
+        glBufferDataARB(GL_ARRAY_BUFFER_ARB, capacity * sizeof(PackedVertex), nullptr, GL_DYNAMIC_DRAW_ARB);
+        allocation.handle = mArenas[i].ranges.allocate(vertexes);
+    }
+    allocation.arena = static_cast<uint32_t>(i);
+    Arena& arena = mArenas[i];
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, arena.buffer);
+    glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, arena.ranges.getOffset(allocation.handle) * sizeof(PackedVertex),
+                       vertexes * sizeof(PackedVertex), data);
+    return allocation;
+}
+
+void ChunkMeshPool::free(Allocation& allocation)
+{
+    if (allocation.isEmpty())
+        return;
+    Arena& arena = mArenas[allocation.arena];
+    arena.ranges.free(allocation.handle);
+    allocation = Allocation();
+    // Keep the first buffer around, the others go when they empty
+    if (arena.ranges.isEmpty() && &arena != &mArenas.front())
+    {
+        glDeleteBuffersARB(1, &arena.buffer);
+        arena.buffer = 0;
+    }
+}
+
+MeshArena::Handle ChunkMeshPool::place(size_t i, size_t vertexes)
+{
+    Arena& arena = mArenas[i];
+    MeshArena::Handle handle = arena.ranges.allocate(vertexes);
+    if (handle == MeshArena::Invalid && arena.ranges.fitsAfterCompact(vertexes))
+    {
+        compact(arena);
+        handle = arena.ranges.allocate(vertexes);
+    }
+    return handle;
+}
+
+void ChunkMeshPool::compact(Arena& arena)
+{
+    // Copy into a new buffer: ranges of one buffer can't be copied over each other
+    VertexBufferID buffer;
+    glGenBuffersARB(1, &buffer);
+    glBindBufferARB(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferDataARB(GL_COPY_WRITE_BUFFER, arena.ranges.getCapacity() * sizeof(PackedVertex), nullptr, GL_DYNAMIC_DRAW_ARB);
+    glBindBufferARB(GL_COPY_READ_BUFFER, arena.buffer);
+    // Allocations next to each other stay so, and go in one copy
+    size_t runFrom = 0, runTo = 0, runSize = 0;
+    auto copy = [&]
+    {
+        if (runSize)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, runFrom * sizeof(PackedVertex),
+                                runTo * sizeof(PackedVertex), runSize * sizeof(PackedVertex));
+    };
+    arena.ranges.compact([&](size_t from, size_t to, size_t size)
+    {
+        if (runSize && from == runFrom + runSize)
+        {
+            runSize += size;
+            return;
+        }
+        copy();
+        runFrom = from, runTo = to, runSize = size;
+    });
+    copy();
+    glBindBufferARB(GL_COPY_READ_BUFFER, 0);
+    glBindBufferARB(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffersARB(1, &arena.buffer);
+    arena.buffer = buffer;
+    ++mCompactions;
+}
+
+uint32_t ChunkMeshPool::acquireSlot(const Vec3f& origin)
+{
+    uint32_t slot;
+    if (!mFreeSlots.empty())
+    {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else if (mOriginData.size() / 3 < MaxSlots)
+        slot = static_cast<uint32_t>(mOriginData.size() / 3);
+    else
+        return NoSlot;
+    if (slot * 3 == mOriginData.size())
+        mOriginData.resize(mOriginData.size() + 3);
+    const float texel[3] = { origin.x, origin.y, origin.z };
+    std::copy(texel, texel + 3, mOriginData.begin() + slot * 3);
+
+    // Leave the bound texture (the block atlas) as it was
+    GLint bound;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    if (!mOrigins)
+    {
+        glGenTextures(1, &mOrigins);
+        glBindTexture(GL_TEXTURE_2D, mOrigins);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    else
+        glBindTexture(GL_TEXTURE_2D, mOrigins);
+    if (slot / OriginWidth >= mOriginRows)
+    {
+        // Double the rows and upload every slot again
+        mOriginRows = std::max(1u, mOriginRows * 2);
+        std::vector<float> texels(OriginWidth * mOriginRows * 3);
+        std::copy(mOriginData.begin(), mOriginData.end(), texels.begin());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F_ARB, OriginWidth, mOriginRows, 0, GL_RGB, GL_FLOAT, texels.data());
+    }
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot % OriginWidth, slot / OriginWidth, 1, 1, GL_RGB, GL_FLOAT, texel);
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound));
+    return slot;
+}
+
+void ChunkMeshPool::releaseSlot(uint32_t slot)
+{
+    if (slot != NoSlot)
+        mFreeSlots.push_back(slot);
+}
+
+void ChunkMeshPool::bindOrigins(GLuint unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, mOrigins);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ChunkMeshPool::queue(const Allocation& allocation)
+{
+    if (allocation.isEmpty())
+        return;
+    Arena& arena = mArenas[allocation.arena];
+    const GLint first = static_cast<GLint>(arena.ranges.getOffset(allocation.handle));
+    const GLsizei count = static_cast<GLsizei>(arena.ranges.getSize(allocation.handle));
+    // Sections uploaded together often sit next to each other
+    if (!arena.firsts.empty() && arena.firsts.back() + arena.counts.back() == first)
+        arena.counts.back() += count;
+    else
+    {
+        arena.firsts.push_back(first);
+        arena.counts.push_back(count);
+    }
+}
+
+void ChunkMeshPool::draw()
+{
+    mDrawCalls = mRanges = 0;
+    glEnableVertexAttribArray(PackedVertex::Attribute);
+    for (auto&& arena : mArenas)
+    {
+        if (arena.firsts.empty())
+            continue;
+        glBindBufferARB(GL_ARRAY_BUFFER_ARB, arena.buffer);
+        glVertexAttribIPointer(PackedVertex::Attribute, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), nullptr);
+        glMultiDrawArrays(GL_QUADS, arena.firsts.data(), arena.counts.data(), static_cast<GLsizei>(arena.firsts.size()));
+        ++mDrawCalls;
+        mRanges += arena.firsts.size();
+        arena.firsts.clear();
+        arena.counts.clear();
+    }
+    glDisableVertexAttribArray(PackedVertex::Attribute);
+}
+
+void ChunkMeshPool::clear()
+{
+    for (auto&& arena : mArenas)
+        if (arena.buffer)
+            glDeleteBuffersARB(1, &arena.buffer);
+    mArenas.clear();
+    if (mOrigins)
+        glDeleteTextures(1, &mOrigins);
+    mOrigins = 0;
+    mOriginRows = 0;
+    mOriginData.clear();
+    mFreeSlots.clear();
+}
+
+ChunkMeshPool::Stats ChunkMeshPool::getStats() const noexcept
+{
+    Stats stats{ 0, 0, 0, 0, mCompactions, mDrawCalls, mRanges };
+    for (auto&& arena : mArenas)
+    {
+        if (!arena.buffer)
+            continue;
+        const MeshArena::Stats ranges = arena.ranges.getStats();
+        ++stats.buffers;
+        stats.capacity += ranges.capacity;
+        stats.used += ranges.used;
+        stats.freeBlocks += ranges.freeBlocks;
+    }
+    return stats;
+}
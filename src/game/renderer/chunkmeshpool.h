@@ -0,0 +1,104 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKMESHPOOL_H_
+#define CHUNKMESHPOOL_H_
+
+#include <vector>
+#include <cstdint>
+#include "mesharena.h"
+#include "packedvertex.h"
+
+// Opaque packed chunk meshes, sub-allocated from a few large vertex buffers and drawn with one
+// glMultiDrawArrays per buffer instead of a draw call and a glTranslate per chunk.
+// Each chunk renderer takes a slot holding its chunk origin in a float texture. Its vertexes carry the slot
+// (PackedVertex::setSlot) and the packed shader adds the origin, so all chunks share one modelview matrix.
+// A buffer that can't fit a mesh is compacted if that makes room; otherwise another buffer is made.
+class ChunkMeshPool : public NonCopyable
+{
+public:
+    // Vertexes per buffer, 8 MiB of PackedVertex
+    static constexpr size_t ArenaVertexes = 1 << 20;
+    // Slots of the origin texture, OriginWidth texels per row
+    static constexpr uint32_t MaxSlots = 1 << 16, OriginWidth = 256;
+    static constexpr uint32_t NoSlot = ~uint32_t(0);
+
+    struct Allocation
+    {
+        uint32_t arena = 0;
+        MeshArena::Handle handle = MeshArena::Invalid;
+        bool isEmpty() const noexcept { return handle == MeshArena::Invalid; }
+    };
+
+    struct Stats
+    {
+        size_t buffers, capacity, used, freeBlocks, compactions;
+        // Of the last draw(): glMultiDrawArrays calls and ranges drawn by them
+        size_t drawCalls, ranges;
+    };
+
+    ChunkMeshPool() = default;
+    ~ChunkMeshPool() { clear(); }
+
+    // Upload vertexes, which must carry their renderer's slot. Empty if vertexes is 0.
+    Allocation allocate(const PackedVertex* data, size_t vertexes);
+    // Give the range back and leave allocation empty
+    void free(Allocation& allocation);
+
+    // A slot whose vertexes are drawn at origin, or NoSlot if all are taken
+    uint32_t acquireSlot(const Vec3f& origin);
+    void releaseSlot(uint32_t slot);
+
+    // Bind the origin texture to texture unit `unit`, leaving GL_TEXTURE0 active
+    void bindOrigins(GLuint unit) const;
+
+    // Draw this range on the next draw()
+    void queue(const Allocation& allocation);
+    // Draw the queued ranges, in the bound program reading PackedVertex::Attribute
+    void draw();
+
+    // Free all buffers, slots and the texture
+    void clear();
+
+    Stats getStats() const noexcept;
+
+private:
+    struct Arena
+    {
+        MeshArena ranges;
+        // 0 once the arena emptied and its buffer was freed; the entry is reused
+        VertexBufferID buffer;
+        std::vector<GLint> firsts;
+        std::vector<GLsizei> counts;
+    };
+
+    std::vector<Arena> mArenas;
+    size_t mCompactions = 0, mDrawCalls = 0, mRanges = 0;
+    GLuint mOrigins = 0;
+    // Rows of the texture, and every slot's origin (RGB)
+    uint32_t mOriginRows = 0;
+    std::vector<float> mOriginData;
+    std::vector<uint32_t> mFreeSlots;
+
+    // Place vertexes in arena i, compacting it first if needed. Returns MeshArena::Invalid if it can't fit.
+    MeshArena::Handle place(size_t i, size_t vertexes);
+    void compact(Arena& arena);
+};
+
+#endif // !CHUNKMESHPOOL_H_
@@ -18,116 +18,470 @@
 */
 
 #include "chunkrenderer.h"
+#include "greedymesher.h"
+#include "vertexlight.h"
+#include "shader.h"
+#include <cmath>
+#include <algorithm>
 #include "../../protocol/gen/s2c/2-Chunk_generated.h"
 #include <world/worldclient.h>
-VertexArray* target;
-VertexArray ChunkRenderer::va0(262144, VertexFormat(2, 3, 0, 3));
-VertexArray ChunkRenderer::va1(262144, VertexFormat(2, 3, 0, 3));
+// Block renderers emit into this; per thread so chunks can be meshed off the render thread
+thread_local VertexArray* target;
 bool ChunkRenderer::mergeFace;
+bool ChunkRenderer::packedVertices;
 
-void ChunkRenderer::renderBlock(Chunk* chunk, BlockTexCoord coord[], const Vec3i& pos)
+namespace
 {
-    Vec3i worldpos = chunk->getPosition() * Chunk::Size() + pos;
+    // Texture coordinates of merged faces are (u, v, tile) with u and v in blocks:
+    // repeat the tile's part of the atlas, keeping the gradients continuous across tile edges for mipmapping
+    const char* MergeVertexShader = R"(
+        #version 130
+        out vec3 texCoord;
+        void main()
+        {
+            gl_Position = ftransform();
+            gl_FrontColor = gl_Color;
+            texCoord = gl_MultiTexCoord0.xyz;
+        }
+    )";
 
-    BlockData curr = chunk->getBlock(pos);
-    BlockData neighbors[6] =
+    const char* MergeFragmentShader = R"(
+        #version 130
+        uniform sampler2D atlas;
+        uniform float texturePerLine;
+        in vec3 texCoord;
+        void main()
+        {
+            vec2 tile = vec2(mod(texCoord.z, texturePerLine), floor(texCoord.z / texturePerLine));
+            vec2 uv = (tile + fract(texCoord.xy)) / texturePerLine;
+            gl_FragColor = textureGrad(atlas, uv, dFdx(texCoord.xy) / texturePerLine, dFdy(texCoord.xy) / texturePerLine) * gl_Color;
+        }
+    )";
+
+    // Decodes PackedVertex into what MergeVertexShader passes on, so the fragment shader is shared.
+    // The chunk origin comes from the vertex's ChunkMeshPool slot.
+    const char* PackedVertexShader = R"(
+        #version 130
+        uniform sampler2D origins;
+        in uvec2 packedVertex;
+        out vec3 texCoord;
+        const float shades[4] = float[4](0.5, 0.7, 1.0, 1.0);
+        // VertexLight::Occlusion and VertexLight::Light
+        const float occlusion[4] = float[4](0.55, 0.7, 0.85, 1.0);
+        const float light[16] = float[16](0.083, 0.092, 0.102, 0.115, 0.132, 0.152, 0.178, 0.209,
+                                          0.249, 0.299, 0.361, 0.439, 0.536, 0.658, 0.810, 1.000);
+        void main()
+        {
+            uint p = packedVertex.x, t = packedVertex.y, slot = t >> 16;
+            vec3 position = vec3(p & 63u, (p >> 6) & 63u, (p >> 12) & 63u);
+            position += texelFetch(origins, ivec2(slot & 255u, slot >> 8), 0).xyz;
+            gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+            gl_FrontColor = vec4(vec3(shades[p >> 30] * occlusion[(t >> 10) & 3u] * light[(t >> 12) & 15u]), 1.0);
+            texCoord = vec3((p >> 18) & 63u, (p >> 24) & 63u, t & 1023u);
+        }
+    )";
+
+    // Function local so they go before the GL context at exit, if ChunkRenderer::freeResources did not already
+    ShaderProgram& mergeShader()
     {
-        pos.x == Chunk::Size() - 1 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x + 1, worldpos.y, worldpos.z)) : chunk->getBlock(Vec3i(pos.x + 1, pos.y, pos.z)),
-        pos.x == 0 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x - 1, worldpos.y, worldpos.z)) : chunk->getBlock(Vec3i(pos.x - 1, pos.y, pos.z)),
-        pos.y == Chunk::Size() - 1 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x, worldpos.y + 1, worldpos.z)) : chunk->getBlock(Vec3i(pos.x, pos.y + 1, pos.z)),
-        pos.y == 0 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x, worldpos.y - 1, worldpos.z)) : chunk->getBlock(Vec3i(pos.x, pos.y - 1, pos.z)),
-        pos.z == Chunk::Size() - 1 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x, worldpos.y, worldpos.z + 1)) : chunk->getBlock(Vec3i(pos.x, pos.y, pos.z + 1)),
-        pos.z == 0 ? chunk->getWorld()->getBlock(Vec3i(worldpos.x, worldpos.y, worldpos.z - 1)) : chunk->getBlock(Vec3i(pos.x, pos.y, pos.z - 1)),
-    };
+        static ShaderProgram program;
+        return program;
+    }
 
-    // Right
-    if (adjacentTest(curr, neighbors[0], chunk->getWorld()))
-        target->addPrimitive(4,
+    ShaderProgram& packedShader()
     {
-        coord[0].d[0], coord[0].d[1], 0.5f, 0.5f, 0.5f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 1.0f,
-        coord[0].d[0], coord[0].d[3], 0.5f, 0.5f, 0.5f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 1.0f,
-        coord[0].d[2], coord[0].d[3], 0.5f, 0.5f, 0.5f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[0].d[2], coord[0].d[1], 0.5f, 0.5f, 0.5f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 0.0f
-    });
+        static ShaderProgram program;
+        return program;
+    }
 
-    // Left
-    if (adjacentTest(curr, neighbors[1], chunk->getWorld()))
-        target->addPrimitive(4,
+    // Created on first use, destroyed by ChunkRenderer::freeResources while the context is current
+    std::unique_ptr<ChunkMeshPool> pool;
+
+    ChunkMeshPool& meshPool()
     {
-        coord[1].d[0], coord[1].d[1], 0.5f, 0.5f, 0.5f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 0.0f,
-        coord[1].d[0], coord[1].d[3], 0.5f, 0.5f, 0.5f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[1].d[2], coord[1].d[3], 0.5f, 0.5f, 0.5f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 1.0f,
-        coord[1].d[2], coord[1].d[1], 0.5f, 0.5f, 0.5f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 1.0f
-    });
+        if (!pool)
+            pool.reset(new ChunkMeshPool());
+        return *pool;
+    }
 
-    // Top
-    if (adjacentTest(curr, neighbors[2], chunk->getWorld()))
-        target->addPrimitive(4,
-    {
-        /*0.0f, 0.0f, 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 0.0f,
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 1.0f,
-        1.0f, 1.0f, 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 1.0f,
-        1.0f, 0.0f, 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 0.0f,*/
-        coord[2].d[0], coord[2].d[1], 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 0.0f,
-        coord[2].d[0], coord[2].d[3], 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 1.0f,
-        coord[2].d[2], coord[2].d[3], 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 1.0f,
-        coord[2].d[2], coord[2].d[1], 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 0.0f
-    });
+    // Texture unit of the pool's origin texture, the atlas being on 0
+    constexpr GLuint OriginUnit = 1;
+
+    // What block renderers draw, one quad per face with atlas texture coordinates
+    VertexFormat faceFormat() { return VertexFormat(2, 3, 0, 3); }
 
-    // Bottom
-    if (adjacentTest(curr, neighbors[3], chunk->getWorld()))
-        target->addPrimitive(4,
+    // Blocks in [begin, end) whose renderer has no face textures, which GreedyMesher leaves out,
+    // drawn by their renderer into faces
+    void buildFallback(const ChunkSnapshot& chunk, VertexArray& faces, const Vec3i& begin, const Vec3i& end)
     {
-        coord[3].d[0], coord[3].d[1], 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 1.0f,
-        coord[3].d[0], coord[3].d[3], 1.0f, 1.0f, 1.0f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[3].d[2], coord[3].d[3], 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[3].d[2], coord[3].d[1], 1.0f, 1.0f, 1.0f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 1.0f
-    });
+        const BlockManager& types = chunk.getWorld()->getBlockTypes();
+        static thread_local std::vector<uint8_t> fallback;
+        fallback.assign(types.size(), 0);
+        bool any = false;
+        for (size_t id = 1; id < types.size(); ++id)
+        {
+            fallback[id] = BlockRendererManager::hasRenderer(id) && !BlockRendererManager::getFaceTextures(id);
+            any = any || fallback[id];
+        }
+        auto isFallback = [](size_t id) { return id < fallback.size() && fallback[id]; };
+        if (!any || (chunk.isUniform() && !isFallback(chunk.get(0, 0, 0).getID())))
+            return;
+        target = &faces;
+        const int scale = 1 << chunk.getLod();
+        Vec3i pos;
+        for (pos.x = begin.x; pos.x < end.x; pos.x += scale)
+            for (pos.y = begin.y; pos.y < end.y; pos.y += scale)
+                for (pos.z = begin.z; pos.z < end.z; pos.z += scale)
+                {
+                    const size_t id = chunk.get(pos).getID();
+                    if (isFallback(id))
+                        BlockRendererManager::render(id, chunk, pos);
+                }
+    }
+}
 
-    // Front
-    if (adjacentTest(curr, neighbors[4], chunk->getWorld()))
-        target->addPrimitive(4,
+bool ChunkRenderer::setMergeFace(bool merge)
+{
+    if (merge && !mergeShader().isBuilt() && !mergeShader().build(MergeVertexShader, MergeFragmentShader))
     {
-        coord[4].d[0], coord[4].d[1], 0.7f, 0.7f, 0.7f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 1.0f,
-        coord[4].d[0], coord[4].d[3], 0.7f, 0.7f, 0.7f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 1.0f,
-        coord[4].d[2], coord[4].d[3], 0.7f, 0.7f, 0.7f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 1.0f,
-        coord[4].d[2], coord[4].d[1], 0.7f, 0.7f, 0.7f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 1.0f
-    });
+        warningstream << "Face merging is unavailable without its shader";
+        return false;
+    }
+    mergeFace = merge;
+    return true;
+}
+
+bool ChunkRenderer::setPackedVertices(bool packed)
+{
+    // ChunkMeshPool grows and compacts its buffers with glCopyBufferSubData
+    if (packed && !(GLEW_VERSION_3_1 || GLEW_ARB_copy_buffer))
+    {
+        warningstream << "Packed vertexes are unavailable without OpenGL 3.1 or ARB_copy_buffer";
+        return false;
+    }
+    // The atlas has a power of two tiles per line, all of which must fit the tile field
+    if (packed && BlockTextureBuilder::getTexturePerLine() * BlockTextureBuilder::getTexturePerLine() > PackedVertex::MaxTiles)
+    {
+        warningstream << "Packed vertexes hold " << PackedVertex::MaxTiles << " texture tiles at most, the block atlas has more";
+        return false;
+    }
+    if (packed && !packedShader().isBuilt() &&
+        !packedShader().build(PackedVertexShader, MergeFragmentShader, { "packedVertex" }))
+    {
+        warningstream << "Packed vertexes are unavailable without their shader";
+        return false;
+    }
+    packedVertices = packed;
+    return true;
+}
+
+void ChunkRenderer::beginRender()
+{
+    if (!mergeFace && !packedVertices)
+        return;
+    ShaderProgram& program = packedVertices ? packedShader() : mergeShader();
+    program.bind();
+    program.setUniform("atlas", 0);
+    program.setUniform("texturePerLine", static_cast<float>(BlockTextureBuilder::getTexturePerLine()));
+    if (packedVertices)
+    {
+        program.setUniform("origins", static_cast<int>(OriginUnit));
+        meshPool().bindOrigins(OriginUnit);
+    }
+}
+
+void ChunkRenderer::endRender()
+{
+    if (mergeFace || packedVertices)
+        ShaderProgram::unbind();
+}
+
+void ChunkRenderer::drawQueued()
+{
+    if (pool)
+        pool->draw();
+}
+
+ChunkMeshPool::Stats ChunkRenderer::getPoolStats()
+{
+    return pool ? pool->getStats() : ChunkMeshPool::Stats{};
+}
+
+void ChunkRenderer::freeResources()
+{
+    pool.reset();
+    mergeShader().destroy();
+    packedShader().destroy();
+    mergeFace = packedVertices = false;
+}
+
+void ChunkRenderer::renderBlock(const ChunkSnapshot& chunk, BlockTexCoord coord[], const Vec3i& pos)
+{
+    World* world = chunk.getWorld();
+    const BlockData* block = chunk.getData() + ChunkSnapshot::index(pos.x, pos.y, pos.z);
+    // At a level of detail pos is the lowest corner of a cube of scale blocks, drawn as one
+    const int scale = 1 << chunk.getLod();
+    const int neighbours[6] =
+    {
+        ChunkSnapshot::index(pos.x + scale, pos.y, pos.z), ChunkSnapshot::index(pos.x - 1, pos.y, pos.z),
+        ChunkSnapshot::index(pos.x, pos.y + scale, pos.z), ChunkSnapshot::index(pos.x, pos.y - 1, pos.z),
+        ChunkSnapshot::index(pos.x, pos.y, pos.z + scale), ChunkSnapshot::index(pos.x, pos.y, pos.z - 1)
+    };
+    auto isOpaque = [world](BlockData data) { return world->getType(data.getID()).isOpaque(); };
 
-    // Back
-    if (adjacentTest(curr, neighbors[5], chunk->getWorld()))
-        target->addPrimitive(4,
+    // Right, left, top, bottom, front, back
+    for (int face = 0; face < 6; ++face)
     {
-        coord[5].d[0], coord[5].d[1], 0.7f, 0.7f, 0.7f, pos.x + 1.0f, pos.y + 1.0f, pos.z + 0.0f,
-        coord[5].d[0], coord[5].d[3], 0.7f, 0.7f, 0.7f, pos.x + 1.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[5].d[2], coord[5].d[3], 0.7f, 0.7f, 0.7f, pos.x + 0.0f, pos.y + 0.0f, pos.z + 0.0f,
-        coord[5].d[2], coord[5].d[1], 0.7f, 0.7f, 0.7f, pos.x + 0.0f, pos.y + 1.0f, pos.z + 0.0f
+        if (!adjacentTest(*block, chunk.getData()[neighbours[face]], world))
+            continue;
+        uint8_t corners[4];
+        // Level of detail chunks are lit flat, like GreedyMesher does for them
+        if (chunk.getLod() == 0)
+            VertexLight::getCorners(block, face, isOpaque, corners);
+        else
+            VertexLight::getFlatCorners(block, face, corners);
+        const float* d = coord[face].d;
+        const float uvs[4][2] = { { d[0], d[1] }, { d[0], d[3] }, { d[2], d[3] }, { d[2], d[1] } };
+        const int first = VertexLight::flipQuad(corners) ? 1 : 0;
+        for (int n = 0; n < 4; ++n)
+        {
+            const int i = (first + n) & 3;
+            const int* corner = VertexLight::Corners[face][i];
+            const float colour = VertexLight::colour(VertexLight::FaceShades[face], corners[i]);
+            target->setTexture({ uvs[i][0], uvs[i][1] });
+            target->setColor({ colour, colour, colour });
+            target->addVertex({ float(pos.x + corner[0] * scale), float(pos.y + corner[1] * scale), float(pos.z + corner[2] * scale) });
+        }
+    }
+}
+
+ChunkRenderer::ChunkRenderer(const ChunkMesh& mesh)
+{
+    update(mesh);
+}
+
+void ChunkRenderer::update(const ChunkMesh& mesh)
+{
+    const size_t attributes = mesh.format.vertexAttributeCount;
+    mVisibility = mesh.visibility;
+    mLod = mesh.lod;
+    mOpaque = mTranslucent = mFallback = false;
+    ChunkMeshPool& pool = meshPool();
+    // Packed vertexes get the slot of this chunk's origin on the way up
+    static std::vector<PackedVertex> slotted;
+    auto withSlot = [this, &slotted](const std::vector<PackedVertex>& vertexes) -> const std::vector<PackedVertex>&
+    {
+        slotted = vertexes;
+        for (auto&& vertex : slotted)
+            vertex.setSlot(mSlot);
+        return slotted;
+    };
+    for (int s = 0; s < ChunkMesh::SectionCount; ++s)
+    {
+        Section& section = mSections[s];
+        if (mesh.sections & (1u << s))
+        {
+            const ChunkMesh::Section& data = mesh.data[s];
+            if (mSlot == ChunkMeshPool::NoSlot && !(data.packedOpaque.empty() && data.packedTranslucent.empty()))
+            {
+                mSlot = pool.acquireSlot(Vec3f(mesh.position * Chunk::Size()));
+                if (mSlot == ChunkMeshPool::NoSlot)
+                    warningstream << "Out of chunk mesh pool slots, chunk not drawn";
+            }
+            section.opaque.update(mesh.format, data.opaque.data(), data.opaque.size() / attributes);
+            section.translucent.buffer.update(mesh.format, data.translucent.data(), data.translucent.size() / attributes);
+            pool.free(section.pooled);
+            if (mSlot != ChunkMeshPool::NoSlot)
+            {
+                auto&& opaque = withSlot(data.packedOpaque);
+                section.pooled = pool.allocate(opaque.data(), opaque.size());
+                auto&& translucent = withSlot(data.packedTranslucent);
+                section.translucent.packed.update(translucent.data(), translucent.size());
+            }
+            else
+                section.translucent.packed.destroy();
+            section.centroids = data.centroids;
+            section.fallback.update(faceFormat(), data.fallback.data(), data.fallback.size() / faceFormat().vertexAttributeCount);
+            mSort.invalidate();
+        }
+        mOpaque = mOpaque || !section.opaque.isEmpty() || !section.pooled.isEmpty();
+        mTranslucent = mTranslucent || !section.translucent.isEmpty();
+        mFallback = mFallback || !section.fallback.isEmpty();
+    }
+}
+
+void ChunkRenderer::render(const Vec3i& c) const
+{
+    if (!mOpaque)
+        return;
+    if (mSlot != ChunkMeshPool::NoSlot)
+    {
+        for (auto&& section : mSections)
+            meshPool().queue(section.pooled);
+        return;
+    }
+    Renderer::translate(Vec3f(c * Chunk::Size()));
+    for (auto&& section : mSections)
+        section.opaque.render();
+    Renderer::translate(Vec3f(-c * Chunk::Size()));
+}
+
+void ChunkRenderer::renderFallback(const Vec3i& c) const
+{
+    if (!mFallback)
+        return;
+    Renderer::translate(Vec3f(c * Chunk::Size()));
+    for (auto&& section : mSections)
+        section.fallback.render();
+    Renderer::translate(Vec3f(-c * Chunk::Size()));
+}
+
+void ChunkRenderer::releasePooled()
+{
+    if (mSlot == ChunkMeshPool::NoSlot)
+        return;
+    Assert(pool);
+    for (auto&& section : mSections)
+        pool->free(section.pooled);
+    pool->releaseSlot(mSlot);
+    mSlot = ChunkMeshPool::NoSlot;
+}
+
+bool ChunkRenderer::renderTrans(const Vec3i& c, const Vec3f& eye)
+{
+    if (!mTranslucent)
+        return false;
+    const Vec3f local = eye - Vec3f(c * Chunk::Size());
+    const bool sort = mSort.update(local);
+    if (sort)
+    {
+        static std::vector<uint32_t> indexes;
+        for (auto&& section : mSections)
+        {
+            QuadSorter::sort(section.centroids, local, indexes);
+            section.order.update(indexes.data(), indexes.size());
+        }
+    }
+    // The sections are slabs stacked along y: farthest from the camera first
+    int order[ChunkMesh::SectionCount];
+    for (int s = 0; s < ChunkMesh::SectionCount; ++s)
+        order[s] = s;
+    std::sort(order, order + ChunkMesh::SectionCount, [&local](int a, int b)
+    {
+        return std::abs((a + 0.5f) * ChunkMesh::SectionHeight - local.y) > std::abs((b + 0.5f) * ChunkMesh::SectionHeight - local.y);
     });
+    // Packed vertexes are placed by their slot
+    const bool translate = mSlot == ChunkMeshPool::NoSlot;
+    if (translate)
+        Renderer::translate(Vec3f(c * Chunk::Size()));
+    for (int s : order)
+        mSections[s].translucent.render(&mSections[s].order);
+    if (translate)
+        Renderer::translate(Vec3f(-c * Chunk::Size()));
+    return sort;
+}
+
+ChunkMesh ChunkRenderer::buildMesh(const ChunkSnapshot& chunk, bool merge, bool packed, unsigned sections)
+{
+    // Staging arrays, one set per thread and format. They start small and grow to the largest section
+    // the thread has meshed, then are reused; the mesh gets exact-size copies.
+    constexpr int InitialVertexes = 4096;
+    static thread_local VertexArray tile0(InitialVertexes, GreedyMesher::format()), tile1(InitialVertexes, GreedyMesher::format());
+    static thread_local VertexArray atlas0(InitialVertexes, faceFormat()), atlas1(InitialVertexes, faceFormat());
+    static thread_local std::vector<PackedVertex> packed0, packed1;
+    // Packed meshes come from GreedyMesher, merged or not
+    const bool greedy = merge || packed;
+    VertexArray& opaque = greedy ? tile0 : atlas0;
+    VertexArray& translucent = greedy ? tile1 : atlas1;
+
+    ChunkMesh mesh;
+    mesh.position = chunk.getPosition();
+    mesh.lod = chunk.getLod();
+    mesh.format = opaque.getFormat();
+    mesh.sections = sections;
+    // Edits anywhere can open or close a path, so this covers the whole chunk even for partial meshes
+    mesh.visibility = ChunkVisibility::compute(chunk);
+    const size_t attributes = mesh.format.vertexAttributeCount;
+    for (int s = 0; s < ChunkMesh::SectionCount; ++s)
+    {
+        if (!(sections & (1u << s)))
+            continue;
+        opaque.clear();
+        translucent.clear();
+        const Vec3i begin(0, s * ChunkMesh::SectionHeight, 0);
+        const Vec3i end(Chunk::Size(), (s + 1) * ChunkMesh::SectionHeight, Chunk::Size());
+        ChunkMesh::Section& section = mesh.data[s];
+        // Coarse faces always merge, or each would still take a quad per block
+        const bool mergeFaces = merge || chunk.getLod() > 0, smoothLighting = chunk.getLod() == 0;
+        if (greedy)
+        {
+            atlas0.clear();
+            buildFallback(chunk, atlas0, begin, end);
+            section.fallback.assign(atlas0.getData(), atlas0.getData() + atlas0.getVertexCount() * faceFormat().vertexAttributeCount);
+        }
+        if (packed)
+        {
+            packed0.clear();
+            packed1.clear();
+            GreedyMesher::build(chunk, packed0, packed1, mergeFaces, begin, end, smoothLighting);
+            QuadSorter::getCentroids(packed1, section.centroids);
+            section.packedOpaque.assign(packed0.begin(), packed0.end());
+            section.packedTranslucent.assign(packed1.begin(), packed1.end());
+            continue;
+        }
+        if (greedy)
+            GreedyMesher::build(chunk, opaque, translucent, mergeFaces, begin, end, smoothLighting);
+        else
+            buildFaces(chunk, opaque, translucent, begin, end);
+        QuadSorter::getCentroids(translucent, section.centroids);
+        section.opaque.assign(opaque.getData(), opaque.getData() + opaque.getVertexCount() * attributes);
+        section.translucent.assign(translucent.getData(), translucent.getData() + translucent.getVertexCount() * attributes);
+    }
+    return mesh;
 }
 
-ChunkRenderer::ChunkRenderer(Chunk *chunk) :mBuffer(), mBufferTrans()
+void ChunkRenderer::buildFaces(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent)
 {
-    va0.clear();
-    va1.clear();
-    if (mergeFace)
+    buildFaces(chunk, opaque, translucent, Vec3i(0, 0, 0), Vec3i(Chunk::Size(), Chunk::Size(), Chunk::Size()));
+}
+
+void ChunkRenderer::buildFaces(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent,
+                               const Vec3i& begin, const Vec3i& end)
+{
+    // Levels of detail have a block per cube of scale blocks, at its lowest corner (see renderBlock)
+    const int scale = 1 << chunk.getLod();
+    if (chunk.isUniform())
     {
-        // TODO: merge face rendering
+        // Uniform chunks have no faces inside: air needs no mesh at all,
+        // anything else can only be visible on the outer shell
+        BlockData b = chunk.get(0, 0, 0);
+        if (b.getID() != 0)
+        {
+            const int last = Chunk::Size() - scale;
+            target = (chunk.getWorld()->getType(b.getID()).isTranslucent()) ? &translucent : &opaque;
+            Vec3i tmp;
+            for (tmp.x = begin.x; tmp.x < end.x; tmp.x += scale)
+                for (tmp.y = begin.y; tmp.y < end.y; tmp.y += scale)
+                {
+                    bool edge = tmp.x == 0 || tmp.x == last || tmp.y == 0 || tmp.y == last;
+                    // Inside the shell only z = 0 and the last z can have faces
+                    for (tmp.z = begin.z; tmp.z < end.z; tmp.z = (edge ? tmp.z + scale : std::max(tmp.z + scale, last)))
+                        BlockRendererManager::render(b.getID(), chunk, tmp);
+                }
+        }
     }
     else
     {
         Vec3i tmp;
-        for (tmp.x = 0; tmp.x < Chunk::Size(); ++tmp.x)
-            for (tmp.y = 0; tmp.y < Chunk::Size(); ++tmp.y)
-                for (tmp.z = 0; tmp.z < Chunk::Size(); ++tmp.z)
+        for (tmp.x = begin.x; tmp.x < end.x; tmp.x += scale)
+            for (tmp.y = begin.y; tmp.y < end.y; tmp.y += scale)
+                for (tmp.z = begin.z; tmp.z < end.z; tmp.z += scale)
                 {
-                    BlockData b = chunk->getBlock(tmp);
-                    target = (chunk->getWorld()->getType(b.getID()).isTranslucent()) ? &va1 : &va0;
+                    BlockData b = chunk.get(tmp);
+                    target = (chunk.getWorld()->getType(b.getID()).isTranslucent()) ? &translucent : &opaque;
                     BlockRendererManager::render(b.getID(), chunk, tmp);
                 }
     }
-
-    mBuffer.update(va0);
-    mBufferTrans.update(va1);
 }
 
 
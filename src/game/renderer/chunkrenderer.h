@@ -22,10 +22,16 @@
 
 #include <atomic>
 #include <memory>
+#include <vector>
 #include <world/nwchunk.h>
+#include <world/nwchunksnapshot.h>
 #include <world/world.h>
 #include <renderer/renderer.h>
 #include "blockrenderer.h"
+#include "packedvertex.h"
+#include "chunkculler.h"
+#include "quadsorter.h"
+#include "chunkmeshpool.h"
 
 class WorldClient;
 
@@ -34,48 +40,186 @@ namespace s2c
     struct Chunk;
 }
 
+// Vertex data of one chunk, built off the GL thread and waiting for upload.
+// Meshes are split into sections, slabs one dirty cell high (see Chunk::getDirtyCells), so a block edit
+// remeshes only the sections it touched. Quads are merged within a section only.
+struct ChunkMesh
+{
+    static constexpr int SectionHeight = 1 << Chunk::CellSizeLog2();
+    static constexpr int SectionCount = Chunk::Size() / SectionHeight;
+    static constexpr unsigned AllSections = (1u << SectionCount) - 1;
+
+    // Either the float vectors in format or, for packed meshes, the packed ones are filled
+    struct Section
+    {
+        std::vector<float> opaque, translucent;
+        std::vector<PackedVertex> packedOpaque, packedTranslucent;
+        // Centre of each translucent quad, for sorting
+        std::vector<Vec3f> centroids;
+        // Merged and packed meshes: blocks GreedyMesher cannot draw (renderers without face textures),
+        // as their block renderer draws them for buildFaces, in its format
+        std::vector<float> fallback;
+    };
+
+    Vec3i position;
+    // Level of detail of the snapshot meshed, see ChunkSnapshot::getLod
+    int lod = 0;
+    VertexFormat format;
+    // Bit s set if section s was built; the others are left as they are
+    unsigned sections = 0;
+    Section data[SectionCount];
+    // ChunkVisibility of the whole chunk, for occlusion culling
+    uint16_t visibility = ChunkVisibility::All;
+
+    // Bytes to upload
+    size_t getSize() const noexcept
+    {
+        size_t size = 0;
+        for (auto&& section : data)
+            size += (section.opaque.size() + section.translucent.size() + section.fallback.size()) * sizeof(float) +
+                    (section.packedOpaque.size() + section.packedTranslucent.size()) * sizeof(PackedVertex);
+        return size;
+    }
+
+    // The sections holding any of the cells in a Chunk::getDirtyCells mask
+    static unsigned getSections(uint64_t cells) noexcept
+    {
+        unsigned sections = 0;
+        for (int i = 0; i < 64; ++i)
+            if (cells & (uint64_t(1) << i))
+                sections |= 1u << (i / Chunk::CellsPerAxis() % Chunk::CellsPerAxis());
+        return sections;
+    }
+};
+
+// Packed meshes keep their opaque faces in the shared ChunkMeshPool and are drawn by drawQueued;
+// float meshes have vertex buffers of their own.
 class ChunkRenderer : public NonCopyable
 {
 public:
     ChunkRenderer() = default;
-    ChunkRenderer(Chunk* chunk);
-    ChunkRenderer(ChunkRenderer&& rhs):
-            mBuffer(std::move(rhs.mBuffer)), mBufferTrans(std::move(rhs.mBufferTrans)) {}
-    ChunkRenderer& operator=(ChunkRenderer&& rhs)
+    // Upload a mesh made by buildMesh
+    explicit ChunkRenderer(const ChunkMesh& mesh);
+    ChunkRenderer(ChunkRenderer&& rhs)
     {
-        mBuffer = std::move(rhs.mBuffer);
-        mBufferTrans = std::move(rhs.mBufferTrans);
-        return *this;
+        *this = std::move(rhs);
     }
-
-    // Draw call
-    void render(const Vec3i& c) const
+    ChunkRenderer& operator=(ChunkRenderer&& rhs)
     {
-        if (!mBuffer.isEmpty())
+        if (&rhs == this)
+            return *this;
+        releasePooled();
+        for (int s = 0; s < ChunkMesh::SectionCount; ++s)
         {
-            Renderer::translate(Vec3f(c * Chunk::Size()));
-            mBuffer.render();
-            Renderer::translate(Vec3f(-c * Chunk::Size()));
+            mSections[s] = std::move(rhs.mSections[s]);
+            rhs.mSections[s].pooled = ChunkMeshPool::Allocation();
         }
+        mSlot = rhs.mSlot;
+        rhs.mSlot = ChunkMeshPool::NoSlot;
+        mOpaque = rhs.mOpaque;
+        mTranslucent = rhs.mTranslucent;
+        mFallback = rhs.mFallback;
+        mVisibility = rhs.mVisibility;
+        mSort = rhs.mSort;
+        mLod = rhs.mLod;
+        return *this;
     }
+    ~ChunkRenderer() { releasePooled(); }
+
+    // Replace the sections the mesh holds
+    void update(const ChunkMesh& mesh);
 
-    void renderTrans(const Vec3i& c) const
+    // Which faces see each other through the chunk, as of the last mesh
+    uint16_t getVisibility() const noexcept { return mVisibility; }
+    // Level of detail of the last mesh
+    int getLod() const noexcept { return mLod; }
+
+    // Draw the opaque faces, or for packed meshes queue them for drawQueued
+    void render(const Vec3i& c) const;
+
+    // Draw the blocks a merged or packed mesh left to their block renderer. Goes outside
+    // beginRender and endRender, as these are in the per face format.
+    void renderFallback(const Vec3i& c) const;
+
+    // Draw the translucent faces back to front as seen from eye, sorting them again if the camera
+    // moved to another QuadSorter cell since the last call. Returns whether they were sorted.
+    bool renderTrans(const Vec3i& c, const Vec3f& eye);
+
+    // Render default block. At a level of detail, the whole cube of blocks whose lowest corner is pos.
+    static void renderBlock(const ChunkSnapshot& chunk, BlockTexCoord coord[], const Vec3i& pos);
+
+    // Mesh the given sections of a chunk with faces merged or not, in packed vertexes or floats.
+    // At a level of detail every cube face takes one quad at most. Uses no OpenGL, so any thread may call it.
+    static ChunkMesh buildMesh(const ChunkSnapshot& chunk, bool merge, bool packed, unsigned sections = ChunkMesh::AllSections);
+
+    // Mesh a chunk one quad per visible block face (per cube face at a level of detail), the way mergeFace is off
+    static void buildFaces(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent);
+    // Only the faces of blocks in [begin, end)
+    static void buildFaces(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent,
+                           const Vec3i& begin, const Vec3i& end);
+
+    // Whether chunks are meshed with GreedyMesher. Renderers built before a change keep their mode,
+    // so the caller has to rebuild them. Enabling builds the merge shader and fails without one.
+    static bool getMergeFace() noexcept { return mergeFace; }
+    static bool setMergeFace(bool merge);
+
+    // Whether chunks are meshed in PackedVertex, a quarter of the float size. Same rules as mergeFace.
+    static bool getPackedVertices() noexcept { return packedVertices; }
+    static bool setPackedVertices(bool packed);
+
+    // Around drawing chunk renderers: binds the packed or merge shader if needed
+    static void beginRender();
+    static void endRender();
+    // Draw the opaque faces queued by render since the last call, one multi-draw per pool buffer.
+    // Goes between beginRender and endRender.
+    static void drawQueued();
+    static ChunkMeshPool::Stats getPoolStats();
+
+    // Delete the shaders and the mesh pool and turn merging and packing off. Call once every chunk
+    // renderer is gone and before the GL context is.
+    static void freeResources();
+private:
+    // Vertex buffer objects of one section, float or packed
+    struct SectionBuffer
     {
-        if (!mBufferTrans.isEmpty())
+        VertexBuffer buffer;
+        PackedVertexBuffer packed;
+
+        void render(const IndexBuffer* order = nullptr) const
         {
-            Renderer::translate(Vec3f(c * Chunk::Size()));
-            mBufferTrans.render();
-            Renderer::translate(Vec3f(-c * Chunk::Size()));
+            if (!buffer.isEmpty())
+                buffer.render(order);
+            else if (!packed.isEmpty())
+                packed.render(order);
         }
-    }
 
-    // Render default block
-    static void renderBlock(Chunk* chunk, BlockTexCoord coord[], const Vec3i& pos);
-private:
-    // Vertex buffer object
-    VertexBuffer mBuffer, mBufferTrans;
-    static bool mergeFace;
-    static VertexArray va0, va1;
+        bool isEmpty() const noexcept { return buffer.isEmpty() && packed.isEmpty(); }
+    };
+
+    struct Section
+    {
+        // Opaque faces are in one of these, by format
+        VertexBuffer opaque;
+        VertexBuffer fallback;
+        ChunkMeshPool::Allocation pooled;
+        SectionBuffer translucent;
+        // Translucent quad centres, and the quads back to front from the cell of mSort
+        std::vector<Vec3f> centroids;
+        IndexBuffer order;
+    };
+
+    Section mSections[ChunkMesh::SectionCount];
+    // ChunkMeshPool slot of packed meshes, which draw without a translation
+    uint32_t mSlot = ChunkMeshPool::NoSlot;
+    // Whether any section has opaque, translucent or fallback faces
+    bool mOpaque = false, mTranslucent = false, mFallback = false;
+    uint16_t mVisibility = ChunkVisibility::All;
+    // Camera cell the translucent quads were sorted for
+    QuadSorter::Tracker mSort;
+    int mLod = 0;
+    static bool mergeFace, packedVertices;
+    // Give the pool allocations and slot back
+    void releasePooled();
     static bool adjacentTest(BlockData a, BlockData b, World* world) noexcept
     {
         return a.getID() != 0 && !world->getType(b.getID()).isOpaque() && !(a.getID() == b.getID());
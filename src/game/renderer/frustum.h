@@ -0,0 +1,64 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#include <engine/common.h>
+
+// The six clipping planes of a camera, for skipping boxes that can't be on screen.
+// Built from projection * view in Mat4's row-major layout (clip = matrix * (x, y, z, 1)).
+class Frustum
+{
+public:
+    Frustum() = default;
+
+    explicit Frustum(const Mat4f& m)
+    {
+        // Gribb & Hartmann: each plane is the last row plus or minus one of the others
+        for (int i = 0; i < 3; ++i)
+            for (int sign = 0; sign < 2; ++sign)
+            {
+                float* plane = mPlanes[i * 2 + sign];
+                for (int j = 0; j < 4; ++j)
+                    plane[j] = m.data[12 + j] + (sign ? -m.data[i * 4 + j] : m.data[i * 4 + j]);
+            }
+    }
+
+    // Whether any part of the box [min, max] may be inside. Boxes near a corner can pass without being inside.
+    bool intersects(const Vec3f& min, const Vec3f& max) const noexcept
+    {
+        for (auto&& plane : mPlanes)
+        {
+            // The box corner farthest along the plane normal
+            const float x = plane[0] > 0.0f ? max.x : min.x;
+            const float y = plane[1] > 0.0f ? max.y : min.y;
+            const float z = plane[2] > 0.0f ? max.z : min.z;
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    // Left, right, bottom, top, near, far: (a, b, c, d) with a * x + b * y + c * z + d >= 0 inside
+    float mPlanes[6][4] = {};
+};
+
+#endif // !FRUSTUM_H_
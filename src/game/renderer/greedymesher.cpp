@@ -0,0 +1,195 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "greedymesher.h"
+#include "blockrenderer.h"
+#include "vertexlight.h"
+#include "packedvertex.h"
+#include <array>
+#include <vector>
+#include <cstring>
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+
+namespace
+{
+    constexpr int Size = Chunk::Size(), Padded = ChunkSnapshot::Padded;
+
+    struct Face
+    {
+        // Normal axis and direction, and the axes texture u and v run along
+        int axis, sign, u, v;
+        // Corner offsets (x, y, z) and texture corner (u, v), each 0 or 1
+        int corners[4][5];
+    };
+
+    // Right, left, top, bottom, front, back: the corners of ChunkRenderer::renderBlock and VertexLight
+    const Face Faces[6] =
+    {
+        { 0, 1, 2, 1, { { 1, 1, 1, 0, 0 }, { 1, 0, 1, 0, 1 }, { 1, 0, 0, 1, 1 }, { 1, 1, 0, 1, 0 } } },
+        { 0, -1, 2, 1, { { 0, 1, 0, 0, 0 }, { 0, 0, 0, 0, 1 }, { 0, 0, 1, 1, 1 }, { 0, 1, 1, 1, 0 } } },
+        { 1, 1, 0, 2, { { 0, 1, 0, 0, 0 }, { 0, 1, 1, 0, 1 }, { 1, 1, 1, 1, 1 }, { 1, 1, 0, 1, 0 } } },
+        { 1, -1, 0, 2, { { 0, 0, 1, 0, 0 }, { 0, 0, 0, 0, 1 }, { 1, 0, 0, 1, 1 }, { 1, 0, 1, 1, 0 } } },
+        { 2, 1, 0, 1, { { 0, 1, 1, 0, 0 }, { 0, 0, 1, 0, 1 }, { 1, 0, 1, 1, 1 }, { 1, 1, 1, 1, 0 } } },
+        { 2, -1, 0, 1, { { 1, 1, 0, 0, 0 }, { 1, 0, 0, 0, 1 }, { 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0 } } }
+    };
+
+    // Face keys take the low 32 bits of a mask entry, the four VertexLight corners the 24 above
+    constexpr int CornerShift = 32;
+
+    // Every id a BlockData can hold
+    constexpr size_t MaxBlockID = 1 << 12;
+
+    // Add a vertex at position with texture extent (u, v) of tile, lit by corner
+    void addVertex(VertexArray& target, const int* position, int u, int v, uint32_t tile, int face, uint8_t corner)
+    {
+        const float colour = VertexLight::colour(VertexLight::FaceShades[face], corner);
+        target.setColor({ colour, colour, colour });
+        target.setTexture({ float(u), float(v), float(tile) });
+        target.addVertex({ float(position[0]), float(position[1]), float(position[2]) });
+    }
+
+    void addVertex(std::vector<PackedVertex>& target, const int* position, int u, int v, uint32_t tile, int face, uint8_t corner)
+    {
+        target.push_back(PackedVertex::pack(position[0], position[1], position[2], u, v, tile, face, corner));
+    }
+
+    template <class Target>
+    void buildQuads(const ChunkSnapshot& chunk, Target& opaque, Target& translucent, bool merge,
+                    const Vec3i& begin, const Vec3i& end, bool smoothLighting)
+    {
+        if (chunk.isUniform() && chunk.get(0, 0, 0).getID() == 0)
+            return;
+
+        // Per block id: whether it hides faces behind it, and the face key of each side
+        // (texture index + 1, top bit set if translucent, 0 if the block is not meshed)
+        static thread_local std::vector<uint8_t> opaqueIDs(MaxBlockID);
+        static thread_local std::vector<std::array<uint32_t, 6>> faceKeys(MaxBlockID);
+        const BlockManager& types = chunk.getWorld()->getBlockTypes();
+        for (size_t id = 0; id < types.size() && id < MaxBlockID; ++id)
+        {
+            opaqueIDs[id] = types[id].isOpaque();
+            const BlockTexCoord* tex = id ? BlockRendererManager::getFaceTextures(id) : nullptr;
+            for (int f = 0; f < 6; ++f)
+                faceKeys[id][f] = tex ? (static_cast<uint32_t>(tex[f].pos) + 1) | (types[id].isTranslucent() ? 0x80000000u : 0u) : 0;
+        }
+
+        const int stride[3] = { Padded * Padded, Padded, 1 };
+        const int lo[3] = { begin.x, begin.y, begin.z }, hi[3] = { end.x, end.y, end.z };
+        // Uniform chunks only have faces on their outer shell
+        const bool uniform = chunk.isUniform();
+        // Face keys and corners of one slice, [b][c]
+        uint64_t mask[Size][Size];
+        auto isOpaque = [](BlockData block) { return opaqueIDs[block.getID()] != 0; };
+        for (const Face& face : Faces)
+        {
+            const int a = face.axis, b = (a == 0) ? 1 : 0, c = (a == 2) ? 1 : 2;
+            const int faceIndex = static_cast<int>(&face - Faces);
+            const int neighbour = face.sign * stride[a];
+            for (int i = lo[a]; i < hi[a]; ++i)
+            {
+                if (uniform && i != (face.sign > 0 ? Size - 1 : 0))
+                    continue;
+                for (int j = lo[b]; j < hi[b]; ++j)
+                {
+                    const BlockData* cell = chunk.getData() + ChunkSnapshot::index(0, 0, 0) + i * stride[a] + j * stride[b] + lo[c] * stride[c];
+                    for (int k = lo[c]; k < hi[c]; ++k, cell += stride[c])
+                    {
+                        const uint32_t curr = cell[0].getID(), next = cell[neighbour].getID();
+                        // Same test as ChunkRenderer::adjacentTest; air has no face keys
+                        const uint32_t key = (curr != next && !opaqueIDs[next]) ? faceKeys[curr][faceIndex] : 0;
+                        if (!key)
+                        {
+                            mask[j][k] = 0;
+                            continue;
+                        }
+                        uint8_t corners[4];
+                        if (smoothLighting)
+                            VertexLight::getCorners(cell, faceIndex, isOpaque, corners);
+                        else
+                            VertexLight::getFlatCorners(cell, faceIndex, corners);
+                        mask[j][k] = key | (uint64_t(corners[0] | (corners[1] << 6) | (corners[2] << 12) | (corners[3] << 18)) << CornerShift);
+                    }
+                }
+
+                for (int j = lo[b]; j < hi[b]; ++j)
+                    for (int k = lo[c]; k < hi[c]; )
+                    {
+                        const uint64_t key = mask[j][k];
+                        if (!key)
+                        {
+                            ++k;
+                            continue;
+                        }
+                        // Widen along c, then grow along b while whole rows match
+                        int w = 1, h = 1;
+                        while (merge && k + w < hi[c] && mask[j][k + w] == key)
+                            ++w;
+                        for (; merge && j + h < hi[b]; ++h)
+                        {
+                            int n = 0;
+                            while (n < w && mask[j + h][k + n] == key)
+                                ++n;
+                            if (n < w)
+                                break;
+                        }
+                        for (int y = j; y < j + h; ++y)
+                            memset(&mask[y][k], 0, w * sizeof(uint64_t));
+
+                        int start[3], extent[3];
+                        start[a] = i, start[b] = j, start[c] = k;
+                        extent[a] = 1, extent[b] = h, extent[c] = w;
+                        Target& target = (key & 0x80000000u) ? translucent : opaque;
+                        const uint32_t tile = static_cast<uint32_t>((key & 0x7FFFFFFFu) - 1);
+                        uint8_t corners[4];
+                        for (int n = 0; n < 4; ++n)
+                            corners[n] = (key >> (CornerShift + 6 * n)) & 63;
+                        // Same winding from another corner, so the quad splits along its other diagonal
+                        const int first = VertexLight::flipQuad(corners) ? 1 : 0;
+                        for (int n = 0; n < 4; ++n)
+                        {
+                            const int* corner = face.corners[(first + n) & 3];
+                            const int position[3] = { start[0] + corner[0] * extent[0], start[1] + corner[1] * extent[1],
+                                                      start[2] + corner[2] * extent[2] };
+                            addVertex(target, position, corner[3] * extent[face.u], corner[4] * extent[face.v], tile, faceIndex,
+                                      corners[(first + n) & 3]);
+                        }
+                        k += w;
+                    }
+            }
+        }
+    }
+}
+
+void GreedyMesher::build(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent, bool merge)
+{
+    build(chunk, opaque, translucent, merge, Vec3i(0, 0, 0), Vec3i(Size, Size, Size));
+}
+
+void GreedyMesher::build(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent, bool merge,
+                         const Vec3i& begin, const Vec3i& end, bool smoothLighting)
+{
+    buildQuads(chunk, opaque, translucent, merge, begin, end, smoothLighting);
+}
+
+void GreedyMesher::build(const ChunkSnapshot& chunk, std::vector<PackedVertex>& opaque, std::vector<PackedVertex>& translucent,
+                         bool merge, const Vec3i& begin, const Vec3i& end, bool smoothLighting)
+{
+    buildQuads(chunk, opaque, translucent, merge, begin, end, smoothLighting);
+}
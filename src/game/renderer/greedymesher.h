@@ -0,0 +1,52 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GREEDYMESHER_H_
+#define GREEDYMESHER_H_
+
+#include <vector>
+#include "vertexarray.h"
+
+class ChunkSnapshot;
+struct PackedVertex;
+
+// Meshes a chunk with coplanar faces of the same texture and shading merged into larger quads.
+// Texture coordinates are (u, v, tile): u and v count blocks across the quad and tile is the block
+// texture index, so drawing needs a shader that repeats the tile (see ChunkRenderer::beginRender).
+// Vertex colours carry VertexLight smooth lighting and ambient occlusion; faces merge only when all four
+// of their corners match. Only blocks whose renderer provides face textures are meshed; ChunkRenderer::buildMesh
+// leaves the others to their renderer. Touches no OpenGL state.
+class GreedyMesher
+{
+public:
+    static VertexFormat format() { return VertexFormat(3, 3, 0, 3); }
+
+    // Append the faces of the chunk to opaque and translucent, both in format().
+    // Without merge every block face stays its own quad, for the packed format of per face meshing.
+    static void build(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent, bool merge = true);
+    // Only the faces of blocks in [begin, end); quads do not cross the box.
+    // Without smoothLighting faces are lit flat by the block in front of them, which merges the most.
+    static void build(const ChunkSnapshot& chunk, VertexArray& opaque, VertexArray& translucent, bool merge,
+                      const Vec3i& begin, const Vec3i& end, bool smoothLighting = true);
+    // The same vertexes as PackedVertex, packed from the face and corner they are made of
+    static void build(const ChunkSnapshot& chunk, std::vector<PackedVertex>& opaque, std::vector<PackedVertex>& translucent,
+                      bool merge, const Vec3i& begin, const Vec3i& end, bool smoothLighting = true);
+};
+
+#endif // !GREEDYMESHER_H_
@@ -0,0 +1,144 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mesharena.h"
+#include <engine/common.h>
+
+constexpr MeshArena::Handle MeshArena::Invalid;
+
+MeshArena::MeshArena(size_t capacity) : mCapacity(capacity)
+{
+    if (capacity)
+        addFree(0, capacity);
+    updateLargestFree();
+}
+
+MeshArena::Handle MeshArena::allocate(size_t size)
+{
+    Assert(size > 0);
+    auto fit = mFreeBySize.lower_bound(size);
+    if (fit == mFreeBySize.end())
+        return Invalid;
+    const size_t offset = fit->second, freeSize = fit->first;
+    removeFree(mFreeByOffset.find(offset));
+    // The rest of the range stays free
+    if (freeSize > size)
+        addFree(offset + size, freeSize - size);
+    updateLargestFree();
+
+    Handle handle;
+    if (mFreeHandles.empty())
+    {
+        handle = static_cast<Handle>(mBlocks.size());
+        mBlocks.push_back({ offset, size });
+    }
+    else
+    {
+        handle = mFreeHandles.back();
+        mFreeHandles.pop_back();
+        mBlocks[handle] = { offset, size };
+    }
+    mUsedByOffset.emplace(offset, handle);
+    mUsed += size;
+    return handle;
+}
+
+void MeshArena::free(Handle handle)
+{
+    Block& block = mBlocks[handle];
+    Assert(block.size != 0);
+    size_t offset = block.offset, size = block.size;
+    mUsedByOffset.erase(offset);
+    mUsed -= size;
+    block = { 0, 0 };
+    mFreeHandles.push_back(handle);
+
+    // Merge with the free ranges on either side
+    auto next = mFreeByOffset.lower_bound(offset);
+    if (next != mFreeByOffset.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = std::next(next);
+        removeFree(std::prev(next));
+    }
+    if (next != mFreeByOffset.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            removeFree(prev);
+        }
+    }
+    addFree(offset, size);
+    updateLargestFree();
+}
+
+void MeshArena::grow(size_t capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+    // Extend the last free range if it reaches the end
+    size_t offset = mCapacity, size = capacity - mCapacity;
+    if (!mFreeByOffset.empty())
+    {
+        auto last = std::prev(mFreeByOffset.end());
+        if (last->first + last->second == mCapacity)
+        {
+            offset = last->first;
+            size += last->second;
+            removeFree(last);
+        }
+    }
+    addFree(offset, size);
+    mCapacity = capacity;
+    updateLargestFree();
+}
+
+void MeshArena::addFree(size_t offset, size_t size)
+{
+    mFreeByOffset.emplace(offset, size);
+    mFreeBySize.emplace(size, offset);
+}
+
+void MeshArena::removeFree(std::map<size_t, size_t>::iterator iter)
+{
+    auto range = mFreeBySize.equal_range(iter->second);
+    for (auto bySize = range.first; bySize != range.second; ++bySize)
+        if (bySize->second == iter->first)
+        {
+            mFreeBySize.erase(bySize);
+            break;
+        }
+    mFreeByOffset.erase(iter);
+}
+
+void MeshArena::rebuildIndexes()
+{
+    std::map<size_t, Handle> used;
+    for (auto&& entry : mUsedByOffset)
+        used.emplace_hint(used.end(), mBlocks[entry.second].offset, entry.second);
+    mUsedByOffset.swap(used);
+    mFreeByOffset.clear();
+    mFreeBySize.clear();
+    if (mUsed < mCapacity)
+        addFree(mUsed, mCapacity - mUsed);
+    updateLargestFree();
+}
@@ -0,0 +1,112 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MESHARENA_H_
+#define MESHARENA_H_
+
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Sub-allocates ranges of one large buffer, in whatever unit the caller counts in (vertexes, say).
+// Free ranges are kept by offset, merged with their neighbours when freed, and handed out best fit.
+// Allocations are named by handles, whose offsets change only when compact() slides them together.
+// Knows nothing about OpenGL: ChunkMeshPool moves the data along when asked to.
+class MeshArena
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle Invalid = ~Handle(0);
+
+    struct Stats
+    {
+        size_t capacity, used, allocations;
+        // Free ranges, and the largest of them
+        size_t freeBlocks, largestFree;
+    };
+
+    explicit MeshArena(size_t capacity);
+
+    // A range of size units, or Invalid if no free range is large enough. size must not be 0.
+    Handle allocate(size_t size);
+    void free(Handle handle);
+
+    size_t getOffset(Handle handle) const { return mBlocks[handle].offset; }
+    size_t getSize(Handle handle) const { return mBlocks[handle].size; }
+
+    // Whether compact() would make room for size units that allocate() can't place now
+    bool fitsAfterCompact(size_t size) const noexcept
+    {
+        return mLargestFree < size && mCapacity - mUsed >= size;
+    }
+
+    // Slide all allocations to the start, leaving one free range at the end. Calls move(from, to, size)
+    // for every allocation in ascending offset order, to <= from, before the next one moves.
+    template <class Move>
+    void compact(Move move)
+    {
+        size_t offset = 0;
+        for (auto&& used : mUsedByOffset)
+        {
+            Block& block = mBlocks[used.second];
+            move(block.offset, offset, block.size);
+            block.offset = offset;
+            offset += block.size;
+        }
+        rebuildIndexes();
+    }
+
+    // Add free space at the end
+    void grow(size_t capacity);
+
+    size_t getCapacity() const noexcept { return mCapacity; }
+    bool isEmpty() const noexcept { return mUsed == 0; }
+    Stats getStats() const noexcept
+    {
+        return{ mCapacity, mUsed, mUsedByOffset.size(), mFreeByOffset.size(), mLargestFree };
+    }
+
+private:
+    struct Block
+    {
+        size_t offset, size;
+    };
+
+    size_t mCapacity, mUsed = 0, mLargestFree = 0;
+    // Indexed by handle; freed handles are reused
+    std::vector<Block> mBlocks;
+    std::vector<Handle> mFreeHandles;
+    // Offset to handle, of live allocations
+    std::map<size_t, Handle> mUsedByOffset;
+    // Free ranges: offset to size, and size to offset for best fit
+    std::map<size_t, size_t> mFreeByOffset;
+    std::multimap<size_t, size_t> mFreeBySize;
+
+    void addFree(size_t offset, size_t size);
+    void removeFree(std::map<size_t, size_t>::iterator iter);
+    void updateLargestFree() noexcept
+    {
+        mLargestFree = mFreeBySize.empty() ? 0 : mFreeBySize.rbegin()->first;
+    }
+    // After compact(): the used map in its new offsets and a single free range
+    void rebuildIndexes();
+};
+
+#endif // !MESHARENA_H_
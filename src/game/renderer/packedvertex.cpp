@@ -0,0 +1,59 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "packedvertex.h"
+
+constexpr GLuint PackedVertex::Attribute;
+constexpr size_t PackedVertex::MaxTiles;
+constexpr float PackedVertex::Shades[3];
+constexpr uint32_t PackedVertex::FaceShades[6];
+
+static_assert(PackedVertex::Shades[PackedVertex::FaceShades[0]] == VertexLight::FaceShades[0] &&
+              PackedVertex::Shades[PackedVertex::FaceShades[1]] == VertexLight::FaceShades[1] &&
+              PackedVertex::Shades[PackedVertex::FaceShades[2]] == VertexLight::FaceShades[2] &&
+              PackedVertex::Shades[PackedVertex::FaceShades[3]] == VertexLight::FaceShades[3] &&
+              PackedVertex::Shades[PackedVertex::FaceShades[4]] == VertexLight::FaceShades[4] &&
+              PackedVertex::Shades[PackedVertex::FaceShades[5]] == VertexLight::FaceShades[5],
+              "Packed face shades must match VertexLight");
+
+void PackedVertexBuffer::update(const PackedVertex* data, size_t vertexes)
+{
+    if (vertexes == 0)
+    {
+        destroy();
+        return;
+    }
+    if (mId == 0)
+        glGenBuffersARB(1, &mId);
+    mVertexes = vertexes;
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, mId);
+    glBufferDataARB(GL_ARRAY_BUFFER_ARB, vertexes * sizeof(PackedVertex), data, GL_STATIC_DRAW_ARB);
+}
+
+void PackedVertexBuffer::render(const IndexBuffer* order) const
+{
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, mId);
+    glEnableVertexAttribArray(PackedVertex::Attribute);
+    glVertexAttribIPointer(PackedVertex::Attribute, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), nullptr);
+    if (order && !order->isEmpty())
+        order->draw();
+    else
+        glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(mVertexes));
+    glDisableVertexAttribArray(PackedVertex::Attribute);
+}
@@ -0,0 +1,128 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PACKEDVERTEX_H_
+#define PACKEDVERTEX_H_
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "vertexarray.h"
+#include "vertexlight.h"
+
+// A chunk mesh vertex of GreedyMesher::format() in 8 bytes instead of 36.
+// Positions and texture extents are whole blocks in [0, Size] and the colour is a face shade times a
+// VertexLight corner, so they pack into bit fields; ChunkRenderer's packed shader decodes them.
+//   position: x, y, z, u, v (6 bits each, lowest first), shade index (2 bits)
+//   texture:  texture tile (10 bits), VertexLight corner (6 bits), ChunkMeshPool slot of the chunk (16 bits, set on upload)
+struct PackedVertex
+{
+    uint32_t position, texture;
+
+    // Vertex attribute location of the packed shader
+    static constexpr GLuint Attribute = 0;
+    // Texture tiles the tile field holds
+    static constexpr size_t MaxTiles = 1024;
+    static constexpr float Shades[3] = { 0.5f, 0.7f, 1.0f };
+    // Index into Shades of each VertexLight::FaceShades
+    static constexpr uint32_t FaceShades[6] = { 0, 0, 2, 2, 1, 1 };
+
+    // A vertex of face (0 to 5, as in VertexLight) with texture extent (u, v) of tile, lit by a VertexLight corner.
+    // Tiles are taken modulo MaxTiles; ChunkRenderer::setPackedVertices refuses textures with more.
+    static PackedVertex pack(uint32_t x, uint32_t y, uint32_t z, uint32_t u, uint32_t v, uint32_t tile, int face, uint8_t corner)
+    {
+        return{ field(x) | (field(y) << 6) | (field(z) << 12) | (field(u) << 18) | (field(v) << 24) | (FaceShades[face] << 30),
+                (tile & (MaxTiles - 1)) | (static_cast<uint32_t>(corner & 63) << 10) };
+    }
+
+    // Back to the GreedyMesher::format() layout
+    void unpack(float* v) const
+    {
+        v[0] = float((position >> 18) & 63), v[1] = float((position >> 24) & 63), v[2] = float(texture & (MaxTiles - 1));
+        v[3] = v[4] = v[5] = VertexLight::colour(Shades[position >> 30], static_cast<uint8_t>((texture >> 10) & 63));
+        v[6] = float(position & 63), v[7] = float((position >> 6) & 63), v[8] = float((position >> 12) & 63);
+    }
+
+    // Position within the chunk
+    Vec3f getPosition() const noexcept
+    {
+        return Vec3f(float(position & 63), float((position >> 6) & 63), float((position >> 12) & 63));
+    }
+
+    // Draw at the chunk origin of a ChunkMeshPool slot
+    void setSlot(uint32_t slot) noexcept
+    {
+        Assert(slot < 65536);
+        texture = (texture & 0xFFFF) | (slot << 16);
+    }
+
+private:
+    static uint32_t field(uint32_t value)
+    {
+        Assert(value < 64);
+        return value;
+    }
+};
+
+static_assert(sizeof(PackedVertex) == 8, "PackedVertex must stay 8 bytes");
+
+// A vertex buffer object of packed vertexes, drawn through Attribute as an integer pair
+class PackedVertexBuffer : public NonCopyable
+{
+public:
+    PackedVertexBuffer() = default;
+
+    PackedVertexBuffer(PackedVertexBuffer&& rhs) noexcept : mId(rhs.mId), mVertexes(rhs.mVertexes)
+    {
+        rhs.mId = 0;
+        rhs.mVertexes = 0;
+    }
+
+    PackedVertexBuffer& operator=(PackedVertexBuffer&& rhs) noexcept
+    {
+        std::swap(mId, rhs.mId);
+        std::swap(mVertexes, rhs.mVertexes);
+        return *this;
+    }
+
+    ~PackedVertexBuffer() { destroy(); }
+
+    void update(const PackedVertex* data, size_t vertexes);
+
+    // Draw as quads, in the order of order if one is given. Needs a bound program reading Attribute.
+    void render(const IndexBuffer* order = nullptr) const;
+
+    void destroy()
+    {
+        if (mId)
+        {
+            glDeleteBuffersARB(1, &mId);
+            mId = 0;
+        }
+        mVertexes = 0;
+    }
+
+    bool isEmpty() const noexcept { return mVertexes == 0; }
+
+private:
+    VertexBufferID mId = 0;
+    size_t mVertexes = 0;
+};
+
+#endif // !PACKEDVERTEX_H_
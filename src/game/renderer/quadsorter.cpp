@@ -0,0 +1,74 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "quadsorter.h"
+#include "packedvertex.h"
+#include <cmath>
+#include <algorithm>
+#include <world/nwchunk.h>
+
+void QuadSorter::getCentroids(const VertexArray& va, std::vector<Vec3f>& centroids)
+{
+    const VertexFormat& format = va.getFormat();
+    Assert(format.coordinateCount == 3);
+    const size_t attributes = format.vertexAttributeCount, offset = attributes - 3;
+    const float* v = va.getData();
+    centroids.reserve(centroids.size() + va.getVertexCount() / 4);
+    for (size_t quad = 0; quad < va.getVertexCount() / 4; ++quad, v += attributes * 4)
+    {
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (size_t i = 0; i < 4; ++i)
+            sum += Vec3f(v[i * attributes + offset], v[i * attributes + offset + 1], v[i * attributes + offset + 2]);
+        centroids.push_back(sum / 4.0f);
+    }
+}
+
+void QuadSorter::getCentroids(const std::vector<PackedVertex>& vertexes, std::vector<Vec3f>& centroids)
+{
+    centroids.reserve(centroids.size() + vertexes.size() / 4);
+    for (size_t quad = 0; quad + 4 <= vertexes.size(); quad += 4)
+    {
+        Vec3f sum(0.0f, 0.0f, 0.0f);
+        for (size_t i = quad; i < quad + 4; ++i)
+            sum += vertexes[i].getPosition();
+        centroids.push_back(sum / 4.0f);
+    }
+}
+
+Vec3i QuadSorter::getCell(const Vec3f& eye) noexcept
+{
+    constexpr int cells = Chunk::Size() / CellSize;
+    return Vec3i(eye.transform([](float x) { return std::min(std::max(std::floor(x / CellSize), -1.0f), float(cells)); }));
+}
+
+void QuadSorter::sort(const std::vector<Vec3f>& centroids, const Vec3f& eye, std::vector<uint32_t>& indexes)
+{
+    static thread_local std::vector<std::pair<float, uint32_t>> keys;
+    keys.resize(centroids.size());
+    for (size_t i = 0; i < centroids.size(); ++i)
+        keys[i] = { (centroids[i] - eye).lengthSqr(), static_cast<uint32_t>(i) };
+    std::sort(keys.begin(), keys.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b)
+    {
+        return a.first > b.first;
+    });
+    indexes.resize(keys.size() * 4);
+    for (size_t i = 0; i < keys.size(); ++i)
+        for (uint32_t j = 0; j < 4; ++j)
+            indexes[i * 4 + j] = keys[i].second * 4 + j;
+}
@@ -0,0 +1,75 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUADSORTER_H_
+#define QUADSORTER_H_
+
+#include <vector>
+#include <cstdint>
+#include "vertexarray.h"
+
+struct PackedVertex;
+
+// Back to front ordering of translucent quads, so blending comes out right.
+// Chunk meshes keep the centre of each translucent quad; the order is rebuilt only when the camera
+// crosses into another cell of the chunk (see getCell). Uses no OpenGL, so it can run anywhere.
+class QuadSorter
+{
+public:
+    // Size of the cells the camera is tracked in while inside a chunk's extent on an axis
+    static constexpr int CellSize = 8;
+
+    // Append the centres of the quads of va (4 vertexes each, coordinates last)
+    static void getCentroids(const VertexArray& va, std::vector<Vec3f>& centroids);
+    static void getCentroids(const std::vector<PackedVertex>& vertexes, std::vector<Vec3f>& centroids);
+
+    // Where the camera is relative to a chunk, eye being relative to the chunk's origin. On each axis this is
+    // the CellSize cell the camera is in, or one past either end when outside the chunk, so far cameras
+    // only change it by moving to another side.
+    static Vec3i getCell(const Vec3f& eye) noexcept;
+
+    // Vertex indexes drawing the quads farthest from eye first, 4 per quad
+    static void sort(const std::vector<Vec3f>& centroids, const Vec3f& eye, std::vector<uint32_t>& indexes);
+
+    // The camera cell quads were last sorted for
+    class Tracker
+    {
+    public:
+        // Whether the quads need sorting for eye, relative to the chunk's origin: never sorted, changed
+        // since, or eye in another cell. Takes eye's cell as the sorted one if so.
+        bool update(const Vec3f& eye) noexcept
+        {
+            const Vec3i cell = getCell(eye);
+            if (mSorted && cell == mCell)
+                return false;
+            mCell = cell;
+            mSorted = true;
+            return true;
+        }
+
+        // The quads changed, sort them on the next update
+        void invalidate() noexcept { mSorted = false; }
+
+    private:
+        Vec3i mCell;
+        bool mSorted = false;
+    };
+};
+
+#endif // !QUADSORTER_H_
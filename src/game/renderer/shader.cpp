@@ -0,0 +1,78 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shader.h"
+#include <vector>
+
+namespace
+{
+    GLuint compile(GLenum type, const char* source)
+    {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            GLint length = 0;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+            std::vector<char> log(length + 1);
+            glGetShaderInfoLog(shader, length, nullptr, log.data());
+            warningstream << "Failed to compile shader: " << log.data();
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+}
+
+bool ShaderProgram::build(const char* vertexSource, const char* fragmentSource, std::initializer_list<const char*> attributes)
+{
+    destroy();
+    GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertex && fragment)
+    {
+        mId = glCreateProgram();
+        glAttachShader(mId, vertex);
+        glAttachShader(mId, fragment);
+        GLuint location = 0;
+        for (auto name : attributes)
+            glBindAttribLocation(mId, location++, name);
+        glLinkProgram(mId);
+        GLint status = GL_FALSE;
+        glGetProgramiv(mId, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            GLint length = 0;
+            glGetProgramiv(mId, GL_INFO_LOG_LENGTH, &length);
+            std::vector<char> log(length + 1);
+            glGetProgramInfoLog(mId, length, nullptr, log.data());
+            warningstream << "Failed to link shader program: " << log.data();
+            destroy();
+        }
+    }
+    // The program keeps what it needs
+    if (vertex)
+        glDeleteShader(vertex);
+    if (fragment)
+        glDeleteShader(fragment);
+    return mId != 0;
+}
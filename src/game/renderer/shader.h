@@ -0,0 +1,61 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHADER_H_
+#define SHADER_H_
+
+#include <initializer_list>
+#include "opengl.h"
+
+// A linked GLSL program
+class ShaderProgram : public NonCopyable
+{
+public:
+    ShaderProgram() = default;
+    ~ShaderProgram() { destroy(); }
+
+    // Compile and link. Logs the error and returns false on failure.
+    // Vertex attributes named in `attributes` get locations 0, 1, ... in order.
+    bool build(const char* vertexSource, const char* fragmentSource, std::initializer_list<const char*> attributes = {});
+
+    bool isBuilt() const noexcept { return mId != 0; }
+
+    void bind() const { glUseProgram(mId); }
+
+    // Back to the fixed function pipeline
+    static void unbind() { glUseProgram(0); }
+
+    // Uniforms of the bound program
+    void setUniform(const char* name, int value) const { glUniform1i(glGetUniformLocation(mId, name), value); }
+    void setUniform(const char* name, float value) const { glUniform1f(glGetUniformLocation(mId, name), value); }
+
+    void destroy()
+    {
+        if (mId)
+        {
+            glDeleteProgram(mId);
+            mId = 0;
+        }
+    }
+
+private:
+    GLuint mId = 0;
+};
+
+#endif // !SHADER_H_
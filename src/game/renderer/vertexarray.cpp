@@ -21,8 +21,13 @@
 
 void VertexBuffer::update(const VertexArray& va)
 {
-    vertexes = va.getVertexCount();
-    format = va.getFormat();
+    update(va.getFormat(), va.getData(), va.getVertexCount());
+}
+
+void VertexBuffer::update(const VertexFormat& format_, const float* data, size_t vertexes_)
+{
+    vertexes = vertexes_;
+    format = format_;
     if (vertexes == 0)
         destroy();
     else
@@ -30,9 +35,8 @@ void VertexBuffer::update(const VertexArray& va)
         if (id == 0)
             glGenBuffersARB(1, &id);
         glBindBufferARB(GL_ARRAY_BUFFER_ARB, id);
-        glBufferDataARB(GL_ARRAY_BUFFER_ARB, va.getVertexCount() * sizeof(float) *
-            format.vertexAttributeCount,
-            va.getData(), GL_STATIC_DRAW_ARB);
+        glBufferDataARB(GL_ARRAY_BUFFER_ARB, vertexes * sizeof(float) * format.vertexAttributeCount,
+            data, GL_STATIC_DRAW_ARB);
     }
 }
 
@@ -42,7 +46,30 @@ VertexBuffer::VertexBuffer(const VertexArray& va)
     update(va);
 }
 
-void VertexBuffer::render() const
+void IndexBuffer::update(const uint32_t* indexes, size_t count)
+{
+    if (count == 0)
+    {
+        destroy();
+        return;
+    }
+    if (mId == 0)
+        glGenBuffersARB(1, &mId);
+    mIndexes = count;
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mId);
+    // Rewritten whenever the camera moves far enough to change the order
+    glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, count * sizeof(uint32_t), indexes, GL_DYNAMIC_DRAW_ARB);
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
+
+void IndexBuffer::draw() const
+{
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mId);
+    glDrawElements(GL_QUADS, static_cast<GLsizei>(mIndexes), GL_UNSIGNED_INT, nullptr);
+    glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
+
+void VertexBuffer::render(const IndexBuffer* order) const
 {
     glBindBufferARB(GL_ARRAY_BUFFER_ARB, id);
     if (format.textureCount != 0)
@@ -82,7 +109,10 @@ void VertexBuffer::render() const
         );
     }
 
-    glDrawArrays(GL_QUADS, 0, vertexes);
+    if (order && !order->isEmpty())
+        order->draw();
+    else
+        glDrawArrays(GL_QUADS, 0, vertexes);
 
     if (format.textureCount != 0)
         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -21,6 +21,9 @@
 #define VERTEXARRAY_H_
 
 #include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
 #include <initializer_list>
 #include "opengl.h"
 #include <engine/common.h>
@@ -48,6 +51,8 @@ public:
     }
 };
 
+// Vertexes built on the CPU. Starts with room for maxVertexes and grows as needed, so a long-lived
+// array (one per meshing thread, say) settles at the largest mesh it has held.
 class VertexArray
 {
 public:
@@ -74,7 +79,7 @@ try :
 
     void clear()
     {
-        memset(mData, 0, mMaxVertexes * mFormat.vertexAttributeCount * sizeof(float));
+        // Vertex data is not touched: nothing past getVertexCount() is ever read
         memset(mVertexAttributes, 0, mFormat.vertexAttributeCount * sizeof(float));
         mVertexes = 0;
     }
@@ -118,6 +123,8 @@ try :
     // Add vertex
     void addVertex(const float* coords)
     {
+        if (mVertexes == mMaxVertexes)
+            reserve(mVertexes + 1);
         auto cnt = mFormat.textureCount + mFormat.colorCount + mFormat.normalCount;
         memcpy(mData + mVertexes * mFormat.vertexAttributeCount, mVertexAttributes, cnt * sizeof(float));
         memcpy(mData + mVertexes * mFormat.vertexAttributeCount + cnt, coords, mFormat.coordinateCount * sizeof(float));
@@ -131,6 +138,8 @@ try :
 
     void addPrimitive(size_t size, std::initializer_list<float> d)
     {
+        if (mVertexes + size > mMaxVertexes)
+            reserve(mVertexes + size);
         memcpy(mData + mVertexes * mFormat.vertexAttributeCount, d.begin(), size * mFormat.vertexAttributeCount * sizeof(float));
         mVertexes += size;
     }
@@ -153,9 +162,28 @@ try :
         return mVertexes;
     }
 
+    // Vertexes that fit before the array grows
+    size_t getCapacity() const noexcept
+    {
+        return mMaxVertexes;
+    }
+
+    // Make room for at least vertexes, at least doubling so adding vertexes stays amortized O(1)
+    void reserve(size_t vertexes)
+    {
+        if (vertexes <= mMaxVertexes)
+            return;
+        const size_t capacity = std::max(vertexes, mMaxVertexes * 2);
+        float* data = new float[capacity * mFormat.vertexAttributeCount];
+        memcpy(data, mData, mVertexes * mFormat.vertexAttributeCount * sizeof(float));
+        delete[] mData;
+        mData = data;
+        mMaxVertexes = capacity;
+    }
+
 private:
-    // Max vertex count
-    const size_t mMaxVertexes;
+    // Vertexes that fit in mData
+    size_t mMaxVertexes;
     // Vertex count
     size_t mVertexes;
     // Vertex array format
@@ -166,6 +194,49 @@ private:
     float* mVertexAttributes;
 };
 
+// An element buffer object of vertex indexes, for drawing a vertex buffer in another order
+class IndexBuffer : public NonCopyable
+{
+public:
+    IndexBuffer() = default;
+
+    IndexBuffer(IndexBuffer&& rhs) noexcept : mId(rhs.mId), mIndexes(rhs.mIndexes)
+    {
+        rhs.mId = 0;
+        rhs.mIndexes = 0;
+    }
+
+    IndexBuffer& operator=(IndexBuffer&& rhs) noexcept
+    {
+        std::swap(mId, rhs.mId);
+        std::swap(mIndexes, rhs.mIndexes);
+        return *this;
+    }
+
+    ~IndexBuffer() { destroy(); }
+
+    void update(const uint32_t* indexes, size_t count);
+
+    // Draw the bound vertex arrays as quads in this order
+    void draw() const;
+
+    void destroy()
+    {
+        if (mId)
+        {
+            glDeleteBuffersARB(1, &mId);
+            mId = 0;
+        }
+        mIndexes = 0;
+    }
+
+    bool isEmpty() const noexcept { return mIndexes == 0; }
+
+private:
+    VertexBufferID mId = 0;
+    size_t mIndexes = 0;
+};
+
 class VertexBuffer : public NonCopyable
 {
 public:
@@ -189,7 +260,9 @@ public:
 
     VertexBuffer& operator=(VertexBuffer&& rhs) noexcept
     {
-
+        // Don't leak the buffer being replaced
+        if (&rhs != this)
+            destroy();
         id = rhs.id; vertexes = rhs.vertexes; format = rhs.format;
         rhs.vertexes = rhs.id = 0;
         rhs.format = VertexFormat();
@@ -203,9 +276,10 @@ public:
 
     // upload new data
     void update(const VertexArray& va);
+    void update(const VertexFormat& format, const float* data, size_t vertexes);
 
-    // Render vertex buffer
-    void render() const;
+    // Render vertex buffer, in the order of order if one is given
+    void render(const IndexBuffer* order = nullptr) const;
 
     // Destroy vertex buffer
     void destroy()
@@ -0,0 +1,62 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vertexlight.h"
+
+constexpr float VertexLight::FaceShades[6];
+constexpr float VertexLight::Occlusion[4];
+constexpr float VertexLight::Light[16];
+
+const int VertexLight::Corners[6][4][3] =
+{
+    { { 1, 1, 1 }, { 1, 0, 1 }, { 1, 0, 0 }, { 1, 1, 0 } },
+    { { 0, 1, 0 }, { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 } },
+    { { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 } },
+    { { 0, 0, 1 }, { 0, 0, 0 }, { 1, 0, 0 }, { 1, 0, 1 } },
+    { { 0, 1, 1 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 } },
+    { { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 } }
+};
+
+const VertexLight::Offsets& VertexLight::getOffsets(int face) noexcept
+{
+    static const struct Table
+    {
+        Offsets faces[6];
+        Table()
+        {
+            constexpr int Padded = ChunkSnapshot::Padded;
+            const int stride[3] = { Padded * Padded, Padded, 1 };
+            for (int f = 0; f < 6; ++f)
+            {
+                const int axis = f / 2, sign = (f % 2) ? -1 : 1;
+                const int b = (axis == 0) ? 1 : 0, c = (axis == 2) ? 1 : 2;
+                faces[f].front = sign * stride[axis];
+                // Toward the corner along each in-plane axis
+                for (int i = 0; i < 4; ++i)
+                {
+                    const int toB = (Corners[f][i][b] ? 1 : -1) * stride[b], toC = (Corners[f][i][c] ? 1 : -1) * stride[c];
+                    faces[f].corners[i][0] = toB;
+                    faces[f].corners[i][1] = toC;
+                    faces[f].corners[i][2] = toB + toC;
+                }
+            }
+        }
+    } table;
+    return table.faces[face];
+}
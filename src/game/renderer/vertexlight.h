@@ -0,0 +1,114 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VERTEXLIGHT_H_
+#define VERTEXLIGHT_H_
+
+#include <cmath>
+#include <cstdint>
+#include <world/nwblock.h>
+#include <world/nwchunksnapshot.h>
+
+// Smooth lighting and ambient occlusion of block face corners, from the layer of blocks the face looks into.
+// A corner touches four blocks there: the one right in front of the face, the two beside it and the one
+// diagonal to it. Each opaque side block darkens the corner a step, both together shut it completely, and
+// the corner's light is the mean brightness of those of the four that light can reach.
+// Blocks are read at fixed offsets from the face's block in a ChunkSnapshot, so nothing is looked up.
+class VertexLight
+{
+public:
+    // Faces right, left, top, bottom, front, back, with their corners in the order of
+    // ChunkRenderer::renderBlock and GreedyMesher: positions relative to the block
+    static const int Corners[6][4][3];
+    // Flat shading of each face
+    static constexpr float FaceShades[6] = { 0.5f, 0.5f, 1.0f, 1.0f, 0.7f, 0.7f };
+    // Occlusion level 0 (shut in) to 3 (open), and brightness 0 to 15
+    static constexpr float Occlusion[4] = { 0.55f, 0.7f, 0.85f, 1.0f };
+    static constexpr float Light[16] =
+    {
+        0.083f, 0.092f, 0.102f, 0.115f, 0.132f, 0.152f, 0.178f, 0.209f,
+        0.249f, 0.299f, 0.361f, 0.439f, 0.536f, 0.658f, 0.810f, 1.000f
+    };
+
+    // A corner: occlusion in the low 2 bits, brightness in the 4 above
+    static int getOcclusion(uint8_t corner) noexcept { return corner & 3; }
+    static int getLight(uint8_t corner) noexcept { return corner >> 2; }
+    static uint8_t makeCorner(int occlusion, int light) noexcept { return static_cast<uint8_t>(occlusion | (light << 2)); }
+
+    // Vertex colour of a corner of a face with the given flat shade
+    static float colour(float shade, uint8_t corner) noexcept
+    {
+        return shade * Occlusion[getOcclusion(corner)] * Light[getLight(corner)];
+    }
+
+    // The four corners of a face of the block at `block`, a pointer into ChunkSnapshot::getData().
+    // isOpaque(BlockData) says which blocks shut out light.
+    template <class IsOpaque>
+    static void getCorners(const BlockData* block, int face, IsOpaque isOpaque, uint8_t corners[4])
+    {
+        const Offsets& offsets = getOffsets(face);
+        const BlockData* front = block + offsets.front;
+        for (int i = 0; i < 4; ++i)
+        {
+            const BlockData side0 = front[offsets.corners[i][0]], side1 = front[offsets.corners[i][1]];
+            const BlockData diagonal = front[offsets.corners[i][2]];
+            const bool closed0 = isOpaque(side0), closed1 = isOpaque(side1);
+            // Light can't reach the diagonal block past two closed sides
+            const bool closedDiagonal = (closed0 && closed1) || isOpaque(diagonal);
+            const int occlusion = (closed0 && closed1) ? 0 : 3 - closed0 - closed1 - closedDiagonal;
+            int light = front->getBrightness(), count = 1;
+            if (!closed0)
+                light += side0.getBrightness(), ++count;
+            if (!closed1)
+                light += side1.getBrightness(), ++count;
+            if (!closedDiagonal)
+                light += diagonal.getBrightness(), ++count;
+            corners[i] = makeCorner(occlusion, (light + count / 2) / count);
+        }
+    }
+
+    // Flat lighting: the brightness of the block in front on all corners, no occlusion
+    static void getFlatCorners(const BlockData* block, int face, uint8_t corners[4]) noexcept
+    {
+        const uint8_t corner = makeCorner(3, block[getOffsets(face).front].getBrightness());
+        corners[0] = corners[1] = corners[2] = corners[3] = corner;
+    }
+
+    // Whether a quad of these corners should be split along its 1-3 diagonal rather than 0-2,
+    // keeping the interpolation symmetric where occlusion differs across the quad
+    static bool flipQuad(const uint8_t corners[4]) noexcept
+    {
+        const float c0 = colour(1.0f, corners[0]), c1 = colour(1.0f, corners[1]);
+        const float c2 = colour(1.0f, corners[2]), c3 = colour(1.0f, corners[3]);
+        return std::abs(c0 - c2) > std::abs(c1 - c3);
+    }
+
+private:
+    // Index offsets in a padded snapshot: the front block from the face's block, then for each corner
+    // the two side blocks and the diagonal one from the front block
+    struct Offsets
+    {
+        int front;
+        int corners[4][3];
+    };
+
+    static const Offsets& getOffsets(int face) noexcept;
+};
+
+#endif // !VERTEXLIGHT_H_
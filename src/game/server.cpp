@@ -19,6 +19,41 @@
 
 #include "server.h"
 #include <context/nwcontext.hpp>
+#include <random>
+#include <algorithm>
+
+namespace
+{
+    // Shard load spread, probe lengths and lookup latency of a chunk map holding the chunks at `positions`
+    template <class Map>
+    std::string chunkMapStats(const Map& map, const std::vector<Vec3i>& positions)
+    {
+        size_t shards = 0, capacity = 0, live = 0, probes = 0, minLoad = SIZE_MAX, maxLoad = 0;
+        map.forEachShardStats([&](size_t cap, size_t, size_t entries, size_t probeSum)
+        {
+            ++shards;
+            capacity += cap;
+            live += entries;
+            probes += probeSum;
+            minLoad = std::min(minLoad, entries);
+            maxLoad = std::max(maxLoad, entries);
+        });
+        using namespace std::chrono;
+        size_t hits = 0;
+        auto start = steady_clock::now();
+        for (auto&& pos : positions)
+            hits += map.find(pos) != nullptr;
+        for (auto&& pos : positions)
+            hits += map.find(pos + Vec3i(0, 1 << 16, 0)) != nullptr;
+        auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        std::stringstream ss;
+        ss << live << " chunks in " << shards << " shards (load min " << minLoad << ", max " << maxLoad
+            << ", avg " << double(live) / shards << "), capacity " << capacity
+            << ", avg probe length " << (live ? double(probes) / live : 0.0)
+            << ", find " << (positions.empty() ? 0.0 : double(ns) / (positions.size() * 2)) << " ns (" << hits << " hits)";
+        return ss.str();
+    }
+}
 
 Server::Server()
     : mWorlds(context.plugins, context.blocks), mNetwork(mWorlds)
@@ -31,6 +66,9 @@ Server::Server()
 
     // World
     mWorlds.addWorld("main_world");
+    // Chunk generation workers, by default one per core left after the network thread
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    mWorlds.getLoader().start(std::max(1, getJsonValue<int>(getSettings()["server"]["generation_threads"], hardwareThreads - 1)));
 
     // Builtin Commands
     initBuiltinCommands();
@@ -107,6 +145,55 @@ void Server::initBuiltinCommands()
         }
         return{ true,"Chunks loaded: " + std::to_string(sum) };
     });
+    mCommands.registerCommand("chunks.memory", { "internal","Show how much memory loaded chunks are using" }, [this](Command cmd)->CommandExecuteStat
+    {
+        size_t count = 0, bytes = 0;
+        for (auto&& world : mWorlds)
+            world->getChunks().forEach([&](Chunk& chunk)
+            {
+                ++count;
+                bytes += chunk.getMemoryUsage();
+            });
+        constexpr size_t flatBytes = sizeof(BlockData) * Chunk::Size() * Chunk::Size() * Chunk::Size();
+        return{ true,"Chunk memory: " + std::to_string(bytes / 1024) + " KiB in " + std::to_string(count) +
+            " chunks (" + std::to_string(count * flatBytes / 1024) + " KiB uncompressed)" };
+    });
+    mCommands.registerCommand("chunks.loader", { "internal","Show the chunk generation queue" }, [this](Command cmd)->CommandExecuteStat
+    {
+        auto stats = mWorlds.getLoader().getStats();
+        std::stringstream ss;
+        ss << "Queued: " << stats.queued << ", generating: " << stats.generating << ", waiting to publish: " << stats.finished
+            << ", completed: " << stats.completed << " in " << stats.batches << " generator calls, latency avg " << stats.averageLatency << " ms, max " << stats.maxLatency << " ms";
+        return{ true, ss.str() };
+    });
+    mCommands.registerCommand("chunks.hashstats", { "internal","Show chunk map bucket load and lookup time" }, [this](Command cmd)->CommandExecuteStat
+    {
+        // Commands run on the console thread, apart from the one loading and unloading chunks
+        EpochReclaimer::Guard guard;
+        std::string result;
+        for (auto&& world : mWorlds)
+        {
+            std::vector<Vec3i> positions;
+            world->getChunks().forEach([&](Chunk& chunk) { positions.push_back(chunk.getPosition()); });
+            // forEach visits them in table order, which would flatter the lookup time
+            std::shuffle(positions.begin(), positions.end(), std::mt19937(std::random_device()()));
+            result += world->getWorldName() + ": " + chunkMapStats(world->getChunks().getMap(), positions) + "\n";
+        }
+        return{ true, result };
+    });
+    mCommands.registerCommand("net.sendqueues", { "internal","Show each client's chunk send queue: chunks waiting, sent, dropped and reloaded, and the send rate" }, [this](Command cmd)->CommandExecuteStat
+    {
+        std::stringstream ss;
+        for (auto&& client : mNetwork.getSendStats())
+        {
+            const ChunkSendQueue::Stats& stats = client.second;
+            ss << client.first << ": " << stats.queued << " chunks queued, " << stats.sent << " sent ("
+               << stats.sentBytes / 1024 << " KiB), " << stats.dropped << " dropped, " << stats.reloaded << " reloaded, "
+               << stats.rate / 1024.0 << " KiB/s\n";
+        }
+        const std::string result = ss.str();
+        return{ true, result.empty() ? "No clients connected." : result };
+    });
 }
 
 void Server::run()
@@ -137,13 +224,20 @@ LocalTunnelServer::LocalTunnelServer()
 // TODO : MultiPlayer
 void LocalTunnelServer::run()
 {
+    using namespace std::chrono;
     mRuning.store(true);
+    auto lastUnload = steady_clock::now();
     while (mRuning)
     {
-        for (auto& w : mWorlds)
-            w->updateChunkLoadStatus();
-        std::this_thread::yield();
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Publish generated chunks often so the client can pick them up quickly
+        mWorlds.getLoader().poll();
+        if (steady_clock::now() - lastUnload > seconds(1))
+        {
+            for (auto& w : mWorlds)
+                w->updateChunkLoadStatus();
+            lastUnload = steady_clock::now();
+        }
+        std::this_thread::sleep_for(milliseconds(UpdateInterval));
     }
 }
 
@@ -158,15 +252,21 @@ World * LocalTunnelServer::getWorld(size_t id)
     return mWorlds.getWorld(id);
 }
 
-Chunk * LocalTunnelServer::getChunk(int x, int y, int z)
+Chunk * LocalTunnelServer::getChunk(const Vec3i& chunkPos, const Vec3i& playerChunkPos)
 {
     World *world = mWorlds.getWorld(0); // TODO:Current world of player.
-    Chunk* chunk;
-    if (!world->isChunkLoaded({ x, y, z }))
-        chunk = world->addChunk({ x, y, z });
-    else
-        chunk = &world->getChunk({ x, y, z });
-    Assert(chunk);
+    // Called from the client thread: the chunk may be unloaded concurrently until referenced
+    EpochReclaimer::Guard guard;
+    Chunk* chunk = world->getChunks().find(chunkPos);
+    if (!chunk)
+    {
+        mWorlds.getLoader().request(*world, chunkPos, playerChunkPos);
+        return nullptr;
+    }
+    // Already being unloaded: the client asks again once it is gone
+    if (!chunk->markRequest())
+        return nullptr;
+    chunk->increaseRef();
     return chunk;
 }
 
@@ -55,7 +55,8 @@ public:
     void run() override;
     void stop() override;
     World* getWorld(size_t id);
-    Chunk* getChunk(int x, int y, int z);
+    // The chunk if loaded, with a reference taken for the caller; otherwise requests it from the chunk loader and returns nullptr
+    Chunk* getChunk(const Vec3i& chunkPos, const Vec3i& playerChunkPos);
     void login(const char*, const char*);
 private:
     std::atomic_bool mRuning{false};
@@ -161,6 +161,11 @@ public:
         return mBlocks[id];
     }
 
+    size_t size() const noexcept
+    {
+        return mBlocks.size();
+    }
+
 private:
     std::vector<BlockType> mBlocks;
 };
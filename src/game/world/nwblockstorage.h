@@ -0,0 +1,353 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BLOCKSTORAGE_H_
+#define BLOCKSTORAGE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "nwblock.h"
+#include "nwreclaimer.h"
+
+// Palette compressed block array.
+// Every block is stored as an index into a palette of distinct BlockData values. Indexes are packed
+// into 64-bit words using 0, 1, 2, 4, 8 or 16 bits each, so an index never straddles two words.
+// 0 bits means every block has the same value and no layout is allocated at all.
+// Writes must come from one thread at a time. Reads may come from any thread: an index and the palette
+// entry it refers to are published together, and a write that changes the palette capacity or the index
+// width builds a new layout, publishes it and retires the old one to the EpochReclaimer. Readers on
+// threads other than the writer's therefore hold an EpochReclaimer::Guard, as they do for the chunk itself.
+template <size_t BlockCount>
+class PalettedBlockStorage : public NonCopyable
+{
+public:
+    explicit PalettedBlockStorage(BlockData fill = BlockData()) : mUniform(fill.getData())
+    {
+    }
+
+    ~PalettedBlockStorage()
+    {
+        delete mLayout.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t size() noexcept { return BlockCount; }
+
+    BlockData get(size_t index) const noexcept
+    {
+        const Layout* layout = mLayout.load(std::memory_order_acquire);
+        if (!layout)
+            return BlockData(mUniform.load(std::memory_order_relaxed));
+        return layout->entry(layout->readIndex(index));
+    }
+
+    void set(size_t index, BlockData block)
+    {
+        if (isUniformValue(block))
+            return;
+        const uint16_t value = findOrAdd(block);
+        // Adding it may have compacted the storage down to this very value everywhere
+        if (Layout* layout = mLayout.load(std::memory_order_relaxed))
+            layout->writeIndex(index, value);
+    }
+
+    // Fill the whole storage with one value
+    void fill(BlockData block)
+    {
+        mUniform.store(block.getData(), std::memory_order_relaxed);
+        publish(nullptr);
+    }
+
+    // Replace the whole storage with a flat array of BlockCount blocks
+    void assign(const BlockData* src)
+    {
+        static thread_local std::unique_ptr<uint16_t[]> indexes(new uint16_t[BlockCount]);
+        std::unordered_map<uint32_t, uint16_t> lookup;
+        std::vector<BlockData> palette;
+        uint32_t last = src[0].getData();
+        uint16_t lastIndex = 0;
+        palette.push_back(src[0]);
+        for (size_t i = 0; i < BlockCount; ++i)
+        {
+            const uint32_t value = src[i].getData();
+            if (value != last)
+            {
+                last = value;
+                lastIndex = paletteLookup(palette, src[i], lookup);
+            }
+            indexes[i] = lastIndex;
+        }
+        repack(palette, indexes.get());
+    }
+
+    // Expand into a flat array of BlockCount blocks
+    void copyTo(BlockData* dst) const
+    {
+        const Layout* layout = mLayout.load(std::memory_order_acquire);
+        if (!layout)
+        {
+            std::fill(dst, dst + BlockCount, BlockData(mUniform.load(std::memory_order_relaxed)));
+            return;
+        }
+        const int bits = 1 << layout->bitsLog2, perWord = 64 >> layout->bitsLog2;
+        const uint64_t mask = (uint64_t(1) << bits) - 1;
+        for (size_t w = 0; w < layout->words(); ++w)
+        {
+            uint64_t word = layout->data[w].load(std::memory_order_acquire);
+            for (int i = 0; i < perWord; ++i, word >>= bits)
+                *dst++ = layout->entry(word & mask);
+        }
+    }
+
+    // Drop palette entries that are no longer referenced, shrinking the index width if possible
+    void compact()
+    {
+        const Layout* layout = mLayout.load(std::memory_order_relaxed);
+        if (!layout)
+            return;
+        std::vector<uint16_t> remap(layout->paletteSize.load(std::memory_order_relaxed), UINT16_MAX);
+        std::vector<BlockData> palette;
+        std::unique_ptr<uint16_t[]> indexes(new uint16_t[BlockCount]);
+        for (size_t i = 0; i < BlockCount; ++i)
+        {
+            auto old = layout->readIndex(i);
+            if (remap[old] == UINT16_MAX)
+            {
+                remap[old] = static_cast<uint16_t>(palette.size());
+                palette.push_back(layout->entry(old));
+            }
+            indexes[i] = remap[old];
+        }
+        repack(palette, indexes.get());
+    }
+
+    bool isUniform() const noexcept { return mLayout.load(std::memory_order_acquire) == nullptr; }
+
+    size_t getPaletteSize() const noexcept
+    {
+        const Layout* layout = mLayout.load(std::memory_order_acquire);
+        return layout ? layout->paletteSize.load(std::memory_order_acquire) : 1;
+    }
+
+    int getBitsPerBlock() const noexcept
+    {
+        const Layout* layout = mLayout.load(std::memory_order_acquire);
+        return layout ? 1 << layout->bitsLog2 : 0;
+    }
+
+    // Bytes of heap memory held, not including sizeof(*this)
+    size_t getMemoryUsage() const noexcept
+    {
+        const Layout* layout = mLayout.load(std::memory_order_acquire);
+        return layout ? sizeof(Layout) + layout->paletteCapacity * sizeof(uint32_t) + layout->words() * sizeof(uint64_t) : 0;
+    }
+
+private:
+    // Index width and palette capacity are fixed for the life of a layout; the entries and index words change in place
+    struct Layout
+    {
+        Layout(int bitsLog2_, size_t paletteCapacity_) :
+            bitsLog2(bitsLog2_), paletteCapacity(paletteCapacity_),
+            palette(new std::atomic<uint32_t>[paletteCapacity_]), data(new std::atomic<uint64_t>[words()]())
+        {
+        }
+
+        // log2 of bits per index, never -1: uniform storages have no layout
+        const int bitsLog2;
+        const size_t paletteCapacity;
+        std::atomic<size_t> paletteSize{ 0 };
+        std::unique_ptr<std::atomic<uint32_t>[]> palette;
+        std::unique_ptr<std::atomic<uint64_t>[]> data;
+
+        size_t words() const noexcept { return BlockCount >> (6 - bitsLog2); }
+        size_t maxPaletteSize() const noexcept { return size_t(1) << (1 << bitsLog2); }
+        BlockData entry(size_t index) const noexcept { return BlockData(palette[index].load(std::memory_order_relaxed)); }
+
+        // Acquire pairs with writeIndex(): the palette entry an index refers to is visible with it
+        uint16_t readIndex(size_t index) const noexcept
+        {
+            const int shift = 6 - bitsLog2;
+            const uint64_t mask = (uint64_t(1) << (1 << bitsLog2)) - 1;
+            const uint64_t word = data[index >> shift].load(std::memory_order_acquire);
+            return static_cast<uint16_t>((word >> ((index & ((size_t(1) << shift) - 1)) << bitsLog2)) & mask);
+        }
+
+        void writeIndex(size_t index, uint16_t value) noexcept
+        {
+            const int shift = 6 - bitsLog2;
+            const int offset = static_cast<int>((index & ((size_t(1) << shift) - 1)) << bitsLog2);
+            const uint64_t mask = ((uint64_t(1) << (1 << bitsLog2)) - 1) << offset;
+            std::atomic<uint64_t>& word = data[index >> shift];
+            word.store((word.load(std::memory_order_relaxed) & ~mask) | (uint64_t(value) << offset), std::memory_order_release);
+        }
+
+        void append(BlockData block) noexcept
+        {
+            const size_t size = paletteSize.load(std::memory_order_relaxed);
+            palette[size].store(block.getData(), std::memory_order_relaxed);
+            paletteSize.store(size + 1, std::memory_order_release);
+        }
+    };
+
+    // Wide palettes grow on demand rather than reserving all 65536 entries up front
+    static constexpr size_t MinPaletteCapacity = 16;
+
+    std::atomic<Layout*> mLayout{ nullptr };
+    // The single value of a storage without a layout
+    std::atomic<uint32_t> mUniform;
+
+    // Without a layout, and holding block everywhere
+    bool isUniformValue(BlockData block) const noexcept
+    {
+        return !mLayout.load(std::memory_order_relaxed) && block.getData() == mUniform.load(std::memory_order_relaxed);
+    }
+
+    // Make `layout` current and retire the previous one
+    void publish(Layout* layout)
+    {
+        if (Layout* old = mLayout.exchange(layout, std::memory_order_acq_rel))
+            EpochReclaimer::retire([old] { delete old; });
+    }
+
+    static uint16_t paletteLookup(std::vector<BlockData>& palette, BlockData block, std::unordered_map<uint32_t, uint16_t>& lookup)
+    {
+        // Linear search is faster for the handful of distinct blocks typical terrain has
+        constexpr size_t LinearSearchLimit = 64;
+        if (palette.size() <= LinearSearchLimit)
+        {
+            for (size_t i = 0; i < palette.size(); ++i)
+                if (palette[i] == block)
+                    return static_cast<uint16_t>(i);
+            palette.push_back(block);
+            if (palette.size() > LinearSearchLimit)
+                for (size_t i = 0; i < palette.size(); ++i)
+                    lookup.emplace(palette[i].getData(), static_cast<uint16_t>(i));
+            return static_cast<uint16_t>(palette.size() - 1);
+        }
+        auto iter = lookup.find(block.getData());
+        if (iter != lookup.end())
+            return iter->second;
+        palette.push_back(block);
+        lookup.emplace(block.getData(), static_cast<uint16_t>(palette.size() - 1));
+        return static_cast<uint16_t>(palette.size() - 1);
+    }
+
+    // Index of block in the current layout, adding it to the palette and replacing the layout if needed
+    uint16_t findOrAdd(BlockData block)
+    {
+        Layout* layout = mLayout.load(std::memory_order_relaxed);
+        if (!layout)
+        {
+            // Leaving uniform: one bit per block, every index 0 for the old value
+            layout = new Layout(0, 2);
+            layout->append(BlockData(mUniform.load(std::memory_order_relaxed)));
+            layout->append(block);
+            publish(layout);
+            return 1;
+        }
+        const size_t size = layout->paletteSize.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < size; ++i)
+            if (layout->entry(i) == block)
+                return static_cast<uint16_t>(i);
+        if (size >= layout->maxPaletteSize())
+        {
+            // Palette is full: try reclaiming unused entries before widening the indexes
+            compact();
+            layout = mLayout.load(std::memory_order_relaxed);
+            if (!layout)
+                return isUniformValue(block) ? 0 : findOrAdd(block);
+            const size_t compacted = layout->paletteSize.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < compacted; ++i)
+                if (layout->entry(i) == block)
+                    return static_cast<uint16_t>(i);
+            if (compacted >= layout->maxPaletteSize())
+                layout = relayout(*layout, layout->bitsLog2 + 1);
+        }
+        else if (size >= layout->paletteCapacity)
+            layout = relayout(*layout, layout->bitsLog2);
+        layout->append(block);
+        return static_cast<uint16_t>(layout->paletteSize.load(std::memory_order_relaxed) - 1);
+    }
+
+    static size_t paletteCapacityFor(int bitsLog2, size_t paletteSize) noexcept
+    {
+        const size_t limit = size_t(1) << (1 << bitsLog2);
+        size_t capacity = MinPaletteCapacity;
+        while (capacity < paletteSize * 2)
+            capacity *= 2;
+        return std::min(capacity, limit);
+    }
+
+    // Copy the current contents into a new, published layout with room for more palette entries
+    Layout* relayout(const Layout& old, int bitsLog2)
+    {
+        const size_t size = old.paletteSize.load(std::memory_order_relaxed);
+        Layout* layout = new Layout(bitsLog2, paletteCapacityFor(bitsLog2, size + 1));
+        for (size_t i = 0; i < size; ++i)
+            layout->append(old.entry(i));
+        if (bitsLog2 == old.bitsLog2)
+        {
+            for (size_t w = 0; w < old.words(); ++w)
+                layout->data[w].store(old.data[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        else
+        {
+            for (size_t i = 0; i < BlockCount; ++i)
+                layout->writeIndex(i, old.readIndex(i));
+        }
+        publish(layout);
+        return layout;
+    }
+
+    static int bitsLog2For(size_t paletteSize) noexcept
+    {
+        int log2 = -1;
+        while (paletteSize > (size_t(1) << (log2 < 0 ? 0 : (1 << log2))))
+            ++log2;
+        return log2;
+    }
+
+    // Build and publish a layout holding `palette` and one index per block
+    void repack(const std::vector<BlockData>& palette, const uint16_t* indexes)
+    {
+        const int bitsLog2 = bitsLog2For(palette.size());
+        if (bitsLog2 < 0)
+        {
+            fill(palette[0]);
+            return;
+        }
+        Layout* layout = new Layout(bitsLog2, paletteCapacityFor(bitsLog2, palette.size()));
+        for (auto&& block : palette)
+            layout->append(block);
+        const int bits = 1 << bitsLog2, perWord = 64 >> bitsLog2;
+        for (size_t w = 0; w < layout->words(); ++w)
+        {
+            uint64_t word = 0;
+            for (int i = perWord - 1; i >= 0; --i)
+                word = (word << bits) | indexes[w * perWord + i];
+            layout->data[w].store(word, std::memory_order_relaxed);
+        }
+        publish(layout);
+    }
+};
+
+#endif // !BLOCKSTORAGE_H_
@@ -29,26 +29,61 @@ void NWAPICALL DefaultChunkGen(const Vec3i*, BlockData* blocks, int32_t daylight
 
 bool Chunk::ChunkGeneratorLoaded = false;
 ChunkGenerator *Chunk::ChunkGen = &DefaultChunkGen;
+BatchChunkGenerator *Chunk::BatchChunkGen = nullptr;
 
 Chunk::Chunk(const Vec3i& position, class World& world) : mPosition(position), mWorld(&world)
 {
+    // May run on a chunk loader worker: neighbours are notified when the chunk is added to the world
     std::unique_lock<std::mutex> lock(mMutex);
     build(mWorld->getDaylightBrightness());
-    constexpr std::array<Vec3i, 6> delta
-    {
-        Vec3i(1, 0, 0), Vec3i(-1, 0, 0),
-        Vec3i(0, 1, 0), Vec3i(0,-1, 0),
-        Vec3i(0, 0, 1), Vec3i(0, 0,-1)
-    };
-    for (auto&& p : delta)
-        mWorld->doIfChunkLoaded(getPosition() + p, [](Chunk& chk)
-    {
-        chk.setUpdated(true);
-    });
+}
+
+Chunk::Chunk(const Vec3i& position, class World& world, const BlockData* blocks) : mWorld(&world), mPosition(position)
+{
+    setBlocks(blocks);
+}
+
+Chunk::Chunk(const Vec3i& position, class World& world, BlockData block) : mWorld(&world), mPosition(position)
+{
+    fill(block);
 }
 
 void Chunk::build(int daylightBrightness)
 {
-    (*ChunkGen)(&getPosition(), getBlocks(), daylightBrightness);
-    setUpdated(true);
+    // Without a plugin generator every chunk is plain air, so skip the flat array entirely
+    if (!ChunkGeneratorLoaded && !BatchChunkGen)
+    {
+        fill(BlockData(0, daylightBrightness, 0));
+        return;
+    }
+    // Generators write a flat array, which is then packed into the chunk's palette storage
+    static thread_local std::unique_ptr<BlockData[]> buffer(new BlockData[Size() * Size() * Size()]);
+    BlockData* blocks = buffer.get();
+    // Plugins that only registered a batch generator get batches of one
+    if (ChunkGeneratorLoaded)
+        (*ChunkGen)(&getPosition(), blocks, daylightBrightness);
+    else
+        (*BatchChunkGen)(&getPosition(), &blocks, 1, daylightBrightness);
+    setBlocks(blocks);
+}
+
+void Chunk::generate(class World& world, const Vec3i* positions, size_t count, std::unique_ptr<Chunk>* chunks)
+{
+    // Old plugins: one generator call per chunk
+    if (!BatchChunkGen)
+    {
+        for (size_t i = 0; i < count; ++i)
+            chunks[i].reset(new Chunk(positions[i], world));
+        return;
+    }
+    static thread_local std::vector<std::unique_ptr<BlockData[]>> buffers;
+    static thread_local std::vector<BlockData*> blocks;
+    while (buffers.size() < count)
+    {
+        buffers.emplace_back(new BlockData[Size() * Size() * Size()]);
+        blocks.push_back(buffers.back().get());
+    }
+    (*BatchChunkGen)(positions, blocks.data(), count, world.getDaylightBrightness());
+    for (size_t i = 0; i < count; ++i)
+        chunks[i].reset(new Chunk(positions[i], world, blocks[i]));
 }
@@ -20,15 +20,22 @@
 #ifndef CHUNK_H_
 #define CHUNK_H_
 
+#include <array>
 #include <mutex>
 #include <atomic>
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <vector>
+#include <stdexcept>
 #include <unordered_map>
 #include "nwblock.h"
+#include "nwblockstorage.h"
+#include "nwchunkmap.h"
+#include "nwchunkpointerarray.h"
 
 using ChunkGenerator = void NWAPICALL(const Vec3i*, BlockData*, int);
+using BatchChunkGenerator = void NWAPICALL(const Vec3i*, BlockData* const*, size_t, int);
 
 class NWCOREAPI Chunk : public NonCopyable
 {
@@ -36,14 +43,23 @@ public:
     // Chunk size
     static bool ChunkGeneratorLoaded;
     static ChunkGenerator *ChunkGen;
+    // Generates several chunks per call; nullptr unless a plugin registered one
+    static BatchChunkGenerator *BatchChunkGen;
     static constexpr int SizeLog2() { return 5; }
     static constexpr int Size(){ return 0b100000; };
+    // Changes are tracked per cell of CellSize()^3 blocks, CellsPerAxis()^3 = 64 of them
+    static constexpr int CellSizeLog2() { return 3; }
+    static constexpr int CellsPerAxis() { return Size() >> CellSizeLog2(); }
 
     explicit Chunk(const Vec3i& position, class World& world);
+    // Construct from already generated blocks, a flat array of Size()^3 elements
+    Chunk(const Vec3i& position, class World& world, const BlockData* blocks);
+    // Construct holding a single block everywhere, without running the generator
+    Chunk(const Vec3i& position, class World& world, BlockData block);
     virtual ~Chunk() {}
 
     // Get chunk position
-    const Vec3i& getPosition()
+    const Vec3i& getPosition() const noexcept
     {
         return mPosition;
     }
@@ -59,50 +75,112 @@ public:
         return mModified;
     }
 
-    // Set chunk updated flag
+    // Set chunk updated flag. Setting it marks every cell dirty, clearing it marks none.
     void setUpdated(bool updated)
     {
         mUpdated = updated;
+        mDirtyCells = updated ? ~uint64_t(0) : 0;
+    }
+
+    // Cells changed since the last setUpdated(false), bit (x * 16 + y * 4 + z) per cell
+    uint64_t getDirtyCells() const noexcept
+    {
+        return mDirtyCells;
+    }
+
+    // Flag the blocks in [begin, end), clamped to the chunk, for re-rendering
+    void markDirty(const Vec3i& begin, const Vec3i& end) noexcept
+    {
+        mDirtyCells |= getCellMask(begin, end);
+        mUpdated = true;
+    }
+
+    // The cells holding any block of [begin, end), clamped to the chunk
+    static uint64_t getCellMask(const Vec3i& begin, const Vec3i& end) noexcept
+    {
+        const Vec3i lo = begin.transform([](int v) { return std::max(v, 0) >> CellSizeLog2(); });
+        const Vec3i hi = end.transform([](int v) { return (std::min(v, Size()) - 1) >> CellSizeLog2(); });
+        uint64_t mask = 0;
+        for (int x = lo.x; x <= hi.x; ++x)
+            for (int y = lo.y; y <= hi.y; ++y)
+                for (int z = lo.z; z <= hi.z; ++z)
+                    mask |= uint64_t(1) << ((x * CellsPerAxis() + y) * CellsPerAxis() + z);
+        return mask;
     }
 
     // Get block data in this chunk
     BlockData getBlock(const Vec3i& pos) const
     {
         Assert(pos.x >= 0 && pos.x < Size() && pos.y >= 0 && pos.y < Size() && pos.z >= 0 && pos.z < Size());
-        return mBlocks[pos.x * Size() * Size() + pos.y * Size() + pos.z];
+        return mBlocks.get(pos.x * Size() * Size() + pos.y * Size() + pos.z);
+    }
+
+    // Copy all blocks into a flat array of Size()^3 elements (x-major, then y, then z)
+    void getBlocks(BlockData* dst) const
+    {
+        mBlocks.copyTo(dst);
     }
 
-    // Get block pointer
-    BlockData* getBlocks()
+    // Replace all blocks from a flat array of Size()^3 elements
+    void setBlocks(const BlockData* src)
     {
-        return mBlocks;
+        mBlocks.assign(src);
+        setUpdated(true);
     }
 
-    const BlockData* getBlocks() const
+    // Fill the whole chunk with a single block
+    void fill(BlockData block)
     {
-        return mBlocks;
+        mBlocks.fill(block);
+        setUpdated(true);
     }
 
-    // Set block data in this chunk
+    // Uniform chunks hold a single block value and no per-block data until a different block is set
+    bool isUniform() const noexcept
+    {
+        return mBlocks.isUniform();
+    }
+
+    // Set block data in this chunk. Marks dirty the cells of the block and its neighbours, whose faces it may hide or show.
     void setBlock(const Vec3i& pos, BlockData block)
     {
         Assert(pos.x >= 0 && pos.x < Size() && pos.y >= 0 && pos.y < Size() && pos.z >= 0 && pos.z < Size());
-        mBlocks[pos.x * Size() * Size() + pos.y * Size() + pos.z] = block;
-        mUpdated = true;
+        mBlocks.set(pos.x * Size() * Size() + pos.y * Size() + pos.z, block);
+        markDirty(pos - Vec3i(1, 1, 1), pos + Vec3i(2, 2, 2));
+    }
+
+    // Bytes of memory held by this chunk
+    size_t getMemoryUsage() const noexcept
+    {
+        return sizeof(*this) + mBlocks.getMemoryUsage();
     }
 
     // Build chunk
     void build(int daylightBrightness);
 
+    // Generate count chunks of world at once, through the batch generator if there is one
+    static void generate(class World& world, const Vec3i* positions, size_t count, std::unique_ptr<Chunk>* chunks);
+
     // Reference Counting
-    void markRequest() noexcept { std::unique_lock<std::mutex> lock(mMutex); mLastRequestTime = std::chrono::steady_clock::now(); }
+    // Fails once checkReleaseable() has agreed to unload the chunk: it must be looked up or loaded again
+    bool markRequest() noexcept
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mReleased)
+            return false;
+        mLastRequestTime = std::chrono::steady_clock::now();
+        return true;
+    }
     void increaseRef() noexcept { std::unique_lock<std::mutex> lock(mMutex); ++mReferenceCount; }
     void decreaseRef() noexcept { std::unique_lock<std::mutex> lock(mMutex); --mReferenceCount; }
+    // Once true, stays true and later markRequest() calls fail
     bool checkReleaseable() noexcept
     {
         std::unique_lock<std::mutex> lock(mMutex);
         using namespace std::chrono;
-        return (((steady_clock::now() - mLastRequestTime) > 10s) && mReferenceCount <= 0);
+        if (((steady_clock::now() - mLastRequestTime) > 10s) && mReferenceCount <= 0)
+            mReleased = true;
+        return mReleased;
     }
 
     World* getWorld() noexcept { return mWorld; }
@@ -111,19 +189,45 @@ protected:
 private:
     Vec3i mPosition;
     std::mutex mMutex;
-    BlockData mBlocks[0b1000000000000000];
+    PalettedBlockStorage<0b1000000000000000> mBlocks;
     bool mUpdated = false, mModified = false;
+    uint64_t mDirtyCells = 0;
     // For Garbage Collection
     int mReferenceCount{0};
+    bool mReleased = false;
     std::chrono::steady_clock::time_point mLastRequestTime;
 };
 
 
-struct ChunkHasher
+// Hashes for chunk positions. ChunkHasher is the linear one unless NEWORLD_CHUNK_HASH_MIXED is defined.
+// chunkhash_bench measures both: the linear hash gives shorter probes and faster lookups for
+// player-centred chunk sets, the mixed one spreads small sets more evenly across map shards.
+struct MixedChunkHasher
+{
+    // Packs 21 bits per axis, then applies the MurmurHash3 64-bit finalizer
+    size_t operator()(const Vec3i& t) const noexcept
+    {
+        uint64_t h = (uint64_t(t.x & 0x1FFFFF) << 42) | (uint64_t(t.y & 0x1FFFFF) << 21) | uint64_t(t.z & 0x1FFFFF);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+};
+
+struct LinearChunkHasher
 {
     constexpr size_t operator()(const Vec3i& t) const noexcept { return static_cast<size_t>(t.x * 23947293731 + t.z * 3296467037 + t.y * 1234577); }
 };
 
+#ifdef NEWORLD_CHUNK_HASH_MIXED
+using ChunkHasher = MixedChunkHasher;
+#else
+using ChunkHasher = LinearChunkHasher;
+#endif
+
 struct NWCOREAPI ChunkOnReleaseBehavior
 {
     enum class Behavior : size_t
@@ -150,49 +254,107 @@ class ChunkManager: public NonCopyable
 {
 public:
     using data_t = std::unique_ptr<Chunk, ChunkOnReleaseBehavior>;
-    using array_t = std::unordered_map<Vec3i, data_t, ChunkHasher>;
-    using iterator = array_t::iterator;
-    using const_iterator = array_t::const_iterator;
+    using array_t = ConcurrentChunkMap<Chunk, ChunkOnReleaseBehavior, ChunkHasher>;
     using reference = Chunk&;
     using const_reference = const Chunk&;
+    // An observer's chunk pointer array, see find(chunkPos, cache)
+    using Cache = ChunkPointerArray<Chunk>;
     ChunkManager() = default;
-    ChunkManager(size_t size) { mChunks.reserve(size); }
-    ChunkManager(ChunkManager&& rhs) : mChunks(std::move(rhs.mChunks)) {}
+    ChunkManager(size_t size) : mChunks(size) {}
+    ChunkManager(ChunkManager&& rhs) : mChunks(std::move(rhs.mChunks)), mGeneration(rhs.mGeneration.load()) {}
     ~ChunkManager() = default;
     // Access and modifiers
+    // Threads other than the one loading and unloading chunks must hold an EpochReclaimer::Guard
+    // around lookups and for as long as they use the chunks found (see ConcurrentChunkMap)
     size_t size() const noexcept { return mChunks.size(); }
-    iterator begin() noexcept { return mChunks.begin(); }
-    const_iterator begin() const noexcept { return mChunks.begin(); }
-    iterator end() noexcept { return mChunks.end(); }
-    
-    const_iterator cbegin() const noexcept { return mChunks.cbegin(); }
-    const_iterator cend() const noexcept { return mChunks.cend(); }
-    
-    reference at(const Vec3i& chunkPos) { return *(mChunks.at(chunkPos)); }
-    const_reference at(const Vec3i& chunkPos) const { return *(mChunks.at(chunkPos)); }
-    
-    reference operator[](const Vec3i& chunkPos) { return at(chunkPos); }
-    const_reference operator[](const Vec3i& chunkPos) const { return at(chunkPos); }
-    
-    iterator insert(const Vec3i& chunkPos, data_t&& chunk) { mChunks[chunkPos] = std::move(chunk);  return mChunks.find(chunkPos); }
-  
-    iterator erase(iterator it) { return mChunks.erase(it); }
-    void erase(const Vec3i& chunkPos) { mChunks.erase(chunkPos); }
 
-    iterator reset(iterator it, Chunk* chunk) { it->second.reset(chunk); return it; }
-    iterator reset(const Vec3i& chunkPos, Chunk* chunk) { return reset(mChunks.find(chunkPos), chunk); }
-    
+    Chunk* find(const Vec3i& chunkPos) const noexcept { return mChunks.find(chunkPos); }
+
+    // Looks in the observer's chunk pointer array first, then the map. The array belongs to the calling thread.
+    Chunk* find(const Vec3i& chunkPos, Cache& cache) const noexcept
+    {
+        // Read before the map: a chunk erased after this point bumps the generation past the one it is cached at
+        const uint64_t generation = mGeneration.load(std::memory_order_acquire);
+        if (Chunk* chunk = cache.get(chunkPos, generation))
+            return chunk;
+        Chunk* chunk = mChunks.find(chunkPos);
+        if (chunk)
+            cache.put(chunkPos, chunk, generation);
+        return chunk;
+    }
+
+    reference at(const Vec3i& chunkPos) const
+    {
+        Chunk* chunk = find(chunkPos);
+        if (!chunk)
+            throw std::out_of_range("Chunk not loaded");
+        return *chunk;
+    }
+
+    reference operator[](const Vec3i& chunkPos) const { return at(chunkPos); }
+
+    Chunk* insert(const Vec3i& chunkPos, data_t&& chunk)
+    {
+        auto behavior = chunk.get_deleter();
+        const bool replacing = mChunks.find(chunkPos) != nullptr;
+        Chunk* result = mChunks.insert(chunkPos, chunk.release(), behavior);
+        if (replacing)
+            invalidateCaches();
+        return result;
+    }
+
+    void erase(const Vec3i& chunkPos)
+    {
+        if (mChunks.erase(chunkPos))
+            invalidateCaches();
+    }
+
+    // Replace the chunk at chunkPos, keeping the release behavior of the existing entry
+    Chunk* reset(const Vec3i& chunkPos, Chunk* chunk)
+    {
+        Chunk* result = mChunks.reset(chunkPos, chunk, ChunkOnReleaseBehavior());
+        invalidateCaches();
+        return result;
+    }
+
+    template <typename Func>
+    void forEach(Func func) const { mChunks.forEach(func); }
+
+    template <typename Pred>
+    void eraseIf(Pred pred)
+    {
+        bool erased = false;
+        mChunks.eraseIf([&pred, &erased](Chunk& chunk)
+        {
+            if (!pred(chunk))
+                return false;
+            erased = true;
+            return true;
+        });
+        if (erased)
+            invalidateCaches();
+    }
+
+    // Release erased chunks that no guard can reach any more. Call from the owning thread once per tick.
+    void collect() { mChunks.collect(); }
+
+    const array_t& getMap() const noexcept { return mChunks; }
+
     template <typename... ArgType, typename Func>
-    void doIfLoaded(const Vec3i& chunkPos, Func func, ArgType&&... args)
+    void doIfLoaded(const Vec3i& chunkPos, Func func, ArgType&&... args) const
     {
-        auto iter = mChunks.find(chunkPos);
-        if (iter != mChunks.end())
-            func(*(iter->second), std::forward<ArgType>(args)...);
+        if (Chunk* chunk = find(chunkPos))
+            func(*chunk, std::forward<ArgType>(args)...);
     };
 
     bool isLoaded(const Vec3i& chunkPos) const noexcept
     {
-        return mChunks.find(chunkPos) != mChunks.end();
+        return find(chunkPos) != nullptr;
+    }
+
+    bool isLoaded(const Vec3i& chunkPos, Cache& cache) const noexcept
+    {
+        return find(chunkPos, cache) != nullptr;
     }
     
     // Convert world position to chunk coordinate (one axis)
@@ -229,14 +391,43 @@ public:
         return at(getPos(pos)).getBlock(getBlockPos(pos));
     }
 
-    // Set block data
+    // Get block data, resolving the chunk through an observer's chunk pointer array
+    BlockData getBlock(const Vec3i& pos, Cache& cache) const
+    {
+        Chunk* chunk = find(getPos(pos), cache);
+        if (!chunk)
+            throw std::out_of_range("Chunk not loaded");
+        return chunk->getBlock(getBlockPos(pos));
+    }
+
+    // Set block data. The 26 neighbouring blocks, whose faces and corner lighting it may change,
+    // are marked dirty in their chunk when across a chunk border.
     void setBlock(const Vec3i& pos, BlockData block)
     {
-        at(getPos(pos)).setBlock(getBlockPos(pos), block);
+        const Vec3i chunkPos = getPos(pos);
+        at(chunkPos).setBlock(getBlockPos(pos), block);
+        Vec3i d;
+        for (d.x = -1; d.x <= 1; ++d.x)
+            for (d.y = -1; d.y <= 1; ++d.y)
+                for (d.z = -1; d.z <= 1; ++d.z)
+                {
+                    const Vec3i neighbourPos = getPos(pos + d);
+                    if (neighbourPos == chunkPos)
+                        continue;
+                    if (Chunk* neighbour = find(neighbourPos))
+                    {
+                        const Vec3i local = getBlockPos(pos + d);
+                        neighbour->markDirty(local, local + Vec3i(1, 1, 1));
+                    }
+                }
     }
 
 private:
     array_t mChunks;
+    // Bumped after a chunk is erased or replaced, which drops it from every observer's chunk pointer array
+    std::atomic<uint64_t> mGeneration{ 0 };
+
+    void invalidateCaches() noexcept { mGeneration.fetch_add(1, std::memory_order_release); }
 };
 
 #endif // !CHUNK_H_
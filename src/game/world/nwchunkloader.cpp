@@ -0,0 +1,185 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nwchunkloader.h"
+#include <world/world.h>
+
+constexpr size_t ChunkLoader::MaxBatch;
+
+void ChunkLoader::start(size_t threads)
+{
+    stop();
+    mWorkers.start<std::vector<Key>>(threads, mMutex,
+                                     [this](std::vector<Key>& keys) { return take(keys, batchSize()); },
+                                     [this](std::vector<Key>& keys) { generate(keys); });
+    infostream << "Chunk loader started with " << threads << " worker threads";
+}
+
+void ChunkLoader::stop()
+{
+    mWorkers.stop();
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending.clear();
+    mQueue = std::priority_queue<QueueEntry>();
+    mFinished.clear();
+    mQueued = mGenerating = 0;
+}
+
+void ChunkLoader::request(World& world, const Vec3i& chunkPos, const Vec3i& observer, Callback callback)
+{
+    const Key key{ &world, chunkPos };
+    const int distance = observer.chebyshevDistance(chunkPos);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mPending.find(key);
+        if (iter != mPending.end())
+        {
+            // Already requested: wait for the same result, moving it forward if this observer is nearer
+            if (callback)
+                iter->second.callbacks.push_back(std::move(callback));
+            if (iter->second.state == State::Queued && distance < iter->second.distance)
+            {
+                iter->second.distance = distance;
+                mQueue.push({ distance, key });
+            }
+            return;
+        }
+        Pending pending{ State::Queued, distance, std::chrono::steady_clock::now(), {}, nullptr };
+        if (callback)
+            pending.callbacks.push_back(std::move(callback));
+        mPending.emplace(key, std::move(pending));
+        mQueue.push({ distance, key });
+        ++mQueued;
+    }
+    mWorkers.notifyOne();
+}
+
+size_t ChunkLoader::poll()
+{
+    // No workers: generate whatever is queued on this thread
+    if (mWorkers.empty())
+    {
+        std::vector<Key> keys;
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (!take(keys, batchSize()))
+                    break;
+            }
+            generate(keys);
+        }
+    }
+
+    std::vector<std::pair<Key, Pending>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        finished.reserve(mFinished.size());
+        for (auto&& key : mFinished)
+        {
+            auto iter = mPending.find(key);
+            finished.emplace_back(key, std::move(iter->second));
+            mPending.erase(iter);
+        }
+        mFinished.clear();
+    }
+
+    for (auto&& item : finished)
+    {
+        World& world = *item.first.world;
+        Chunk* chunk = world.getChunks().find(item.first.pos);
+        // Someone else may have loaded it meanwhile; keep theirs
+        if (!chunk)
+        {
+            chunk = world.insertChunk(item.first.pos, ChunkManager::data_t(item.second.chunk.release(), ChunkOnReleaseBehavior()));
+            world.markNeighboursUpdated(item.first.pos);
+        }
+        chunk->markRequest();
+        for (auto&& callback : item.second.callbacks)
+            callback(*chunk);
+        using namespace std::chrono;
+        const double latency = duration<double, std::milli>(steady_clock::now() - item.second.requestTime).count();
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mCompleted;
+        mLatencySum += latency;
+        mLatencyMax = std::max(mLatencyMax, latency);
+    }
+    return finished.size();
+}
+
+ChunkLoader::Stats ChunkLoader::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return{ mQueued, mGenerating, mFinished.size(), mCompleted, mBatches,
+            mCompleted ? mLatencySum / mCompleted : 0.0, mLatencyMax };
+}
+
+bool ChunkLoader::take(std::vector<Key>& keys, size_t max)
+{
+    keys.clear();
+    while (!mQueue.empty() && keys.size() < max)
+    {
+        QueueEntry entry = mQueue.top();
+        // The batch goes to a single generator call, which belongs to one world
+        if (!keys.empty() && entry.key.world != keys.front().world)
+            break;
+        mQueue.pop();
+        auto iter = mPending.find(entry.key);
+        if (iter == mPending.end() || iter->second.state != State::Queued || iter->second.distance != entry.distance)
+            continue;
+        iter->second.state = State::Generating;
+        --mQueued;
+        ++mGenerating;
+        keys.push_back(entry.key);
+    }
+    return !keys.empty();
+}
+
+size_t ChunkLoader::batchSize() const noexcept
+{
+    if (!Chunk::BatchChunkGen)
+        return 1;
+    // Leave some of the queue to the other workers rather than one worker taking it all
+    const size_t share = mWorkers.empty() ? mQueued : mQueued / mWorkers.size();
+    return std::max<size_t>(1, std::min(share, MaxBatch));
+}
+
+void ChunkLoader::generate(const std::vector<Key>& keys)
+{
+    // Runs the chunk generator; the chunks are not visible to anyone else until poll()
+    std::vector<Vec3i> positions;
+    positions.reserve(keys.size());
+    for (auto&& key : keys)
+        positions.push_back(key.pos);
+    std::vector<std::unique_ptr<Chunk>> chunks(keys.size());
+    Chunk::generate(*keys.front().world, positions.data(), positions.size(), chunks.data());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mBatches;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        auto iter = mPending.find(keys[i]);
+        if (iter == mPending.end())
+            continue;
+        iter->second.chunk = std::move(chunks[i]);
+        iter->second.state = State::Finished;
+        --mGenerating;
+        mFinished.push_back(keys[i]);
+    }
+}
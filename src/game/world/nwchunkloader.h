@@ -0,0 +1,122 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKLOADER_H_
+#define CHUNKLOADER_H_
+
+#include <queue>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "nwchunk.h"
+
+class World;
+
+// Generates chunks on a pool of worker threads.
+// Requests for the same chunk are merged, and queued chunks are generated nearest-observer first.
+// Finished chunks are inserted into their world by poll(), which must run on the thread that owns
+// the worlds (the one calling World::updateChunkLoadStatus), together with the request callbacks.
+// With a batch generator registered, each worker takes up to MaxBatch queued chunks of one world at a time.
+class NWCOREAPI ChunkLoader : public NonCopyable
+{
+public:
+    using Callback = std::function<void(Chunk&)>;
+
+    static constexpr size_t MaxBatch = 16;
+
+    struct Stats
+    {
+        // Waiting for a worker / being generated / waiting for poll()
+        size_t queued, generating, finished;
+        // Published since start, and generator calls that produced them
+        size_t completed, batches;
+        // Milliseconds from first request to publication
+        double averageLatency, maxLatency;
+    };
+
+    ChunkLoader() = default;
+    ~ChunkLoader() { stop(); }
+
+    // Start worker threads. Without workers, poll() generates queued chunks itself.
+    void start(size_t threads);
+    // Stop and join the workers. Chunks not yet published are dropped.
+    void stop();
+
+    // Request a chunk that is not loaded yet. Thread safe.
+    // observer is the chunk position of the requesting player and sets the priority.
+    void request(World& world, const Vec3i& chunkPos, const Vec3i& observer, Callback callback = nullptr);
+
+    // Publish finished chunks and run their callbacks. Returns the number of chunks published.
+    size_t poll();
+
+    Stats getStats() const;
+
+private:
+    struct Key
+    {
+        World* world;
+        Vec3i pos;
+        bool operator==(const Key& rhs) const noexcept { return world == rhs.world && pos == rhs.pos; }
+    };
+
+    struct KeyHasher
+    {
+        size_t operator()(const Key& key) const noexcept
+        {
+            return ChunkHasher()(key.pos) ^ std::hash<World*>()(key.world);
+        }
+    };
+
+    enum class State { Queued, Generating, Finished };
+
+    struct Pending
+    {
+        State state;
+        int distance;
+        std::chrono::steady_clock::time_point requestTime;
+        std::vector<Callback> callbacks;
+        std::unique_ptr<Chunk> chunk;
+    };
+
+    // Nearest first. Entries whose distance was lowered later are skipped when popped.
+    struct QueueEntry
+    {
+        int distance;
+        Key key;
+        bool operator<(const QueueEntry& rhs) const noexcept { return distance > rhs.distance; }
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<Key, Pending, KeyHasher> mPending;
+    std::priority_queue<QueueEntry> mQueue;
+    std::vector<Key> mFinished;
+    WorkerPool mWorkers;
+    size_t mQueued = 0, mGenerating = 0, mCompleted = 0, mBatches = 0;
+    double mLatencySum = 0.0, mLatencyMax = 0.0;
+
+    // Pop the nearest queued chunk, then up to max - 1 more of the same world, and mark them as generating.
+    // Returns false if nothing is queued. Requires mMutex.
+    bool take(std::vector<Key>& keys, size_t max);
+    // How many chunks a worker should take: splits the queue between workers. Requires mMutex.
+    size_t batchSize() const noexcept;
+    void generate(const std::vector<Key>& keys);
+};
+
+#endif // !CHUNKLOADER_H_
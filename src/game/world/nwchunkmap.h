@@ -0,0 +1,312 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKMAP_H_
+#define CHUNKMAP_H_
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <engine/common.h>
+#include "nwreclaimer.h"
+
+// Concurrent hash map from chunk position to an owned chunk pointer.
+// Lookups are lock-free: the map is split into shards, each an open addressing table whose slots are
+// read with atomic loads. One thread only writes the map (insert, reset, erase, eraseIf and collect); it locks
+// the shard it modifies against the statistics readers. Erased values and replaced tables are retired to the
+// EpochReclaimer rather than destroyed. Every other thread must hold an EpochReclaimer::Guard around find() and
+// for as long as it uses what it returned. The writing thread needs none: everything retired was unlinked by
+// itself, so it cannot still be walking it.
+// Value must provide getPosition(); ReleaseData is a functor stored per entry and called with the value on reclamation.
+template <class Value, class ReleaseData, class Hasher>
+class ConcurrentChunkMap : public NonCopyable
+{
+public:
+    explicit ConcurrentChunkMap(size_t reserve = 0) : mShards(new Shard[ShardCount])
+    {
+        size_t capacity = MinCapacity;
+        while (capacity * 2 < reserve * 3 / ShardCount)
+            capacity *= 2;
+        for (size_t i = 0; i < ShardCount; ++i)
+            mShards[i].table.store(new Table(capacity), std::memory_order_relaxed);
+    }
+
+    ConcurrentChunkMap(ConcurrentChunkMap&& rhs) noexcept :
+        mShards(std::move(rhs.mShards)), mSize(rhs.mSize.load())
+    {
+        rhs.mSize = 0;
+    }
+
+    // Live entries are released at once: nothing may look the map up while it is destroyed.
+    // Entries erased earlier are left to the reclaimer.
+    ~ConcurrentChunkMap()
+    {
+        if (!mShards)
+            return;
+        for (size_t i = 0; i < ShardCount; ++i)
+        {
+            Table* table = mShards[i].table.load();
+            for (size_t s = 0; s < table->capacity; ++s)
+                if (Value* value = table->slots[s].value.load())
+                    table->slots[s].data(value);
+            delete table;
+        }
+    }
+
+    size_t size() const noexcept { return mSize.load(std::memory_order_relaxed); }
+
+    // Lock-free lookup, nullptr if not present
+    Value* find(const Vec3i& pos) const noexcept
+    {
+        const size_t hash = Hasher()(pos);
+        const uint64_t key = packKey(pos);
+        const Table* table = shardOf(hash).table.load(std::memory_order_acquire);
+        for (size_t i = slotOf(hash, table->capacity), n = 0; n < table->capacity; i = (i + 1) & (table->capacity - 1), ++n)
+        {
+            const uint64_t k = table->slots[i].key.load(std::memory_order_acquire);
+            if (k == EmptyKey)
+                return nullptr;
+            if (k == key)
+            {
+                // Keys of positions 2^21 apart collide, and the slot may have been recycled between the two loads
+                Value* value = table->slots[i].value.load(std::memory_order_acquire);
+                if (value && value->getPosition() == pos)
+                    return value;
+            }
+        }
+        return nullptr;
+    }
+
+    // Insert or replace. A replaced value is retired.
+    Value* insert(const Vec3i& pos, Value* value, ReleaseData data)
+    {
+        const size_t hash = Hasher()(pos);
+        Shard& shard = shardOf(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        if (Slot* slot = locate(table, hash, pos))
+        {
+            Value* old = slot->value.exchange(value, std::memory_order_acq_rel);
+            if (old != value)
+                retire(old, slot->data);
+            slot->data = data;
+            return value;
+        }
+        if ((table->used + 1) * 4 > table->capacity * 3)
+            table = grow(shard);
+        place(table, hash, packKey(pos), value, data);
+        ++mSize;
+        return value;
+    }
+
+    // Replace the value of an existing entry, keeping its release data. Inserts with `data` if absent.
+    Value* reset(const Vec3i& pos, Value* value, ReleaseData data)
+    {
+        const size_t hash = Hasher()(pos);
+        {
+            Shard& shard = shardOf(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (Slot* slot = locate(shard.table.load(std::memory_order_relaxed), hash, pos))
+            {
+                Value* old = slot->value.exchange(value, std::memory_order_acq_rel);
+                if (old != value)
+                    retire(old, slot->data);
+                return value;
+            }
+        }
+        return insert(pos, value, data);
+    }
+
+    bool erase(const Vec3i& pos)
+    {
+        const size_t hash = Hasher()(pos);
+        Shard& shard = shardOf(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Slot* slot = locate(shard.table.load(std::memory_order_relaxed), hash, pos);
+        if (!slot)
+            return false;
+        removeSlot(*slot);
+        return true;
+    }
+
+    // Calls func(Value&) for every entry, pinned throughout. Entries inserted or erased concurrently may or may not be visited.
+    template <typename Func>
+    void forEach(Func func) const
+    {
+        EpochReclaimer::Guard guard;
+        for (size_t i = 0; i < ShardCount; ++i)
+        {
+            const Table* table = mShards[i].table.load(std::memory_order_acquire);
+            for (size_t s = 0; s < table->capacity; ++s)
+                if (Value* value = table->slots[s].value.load(std::memory_order_acquire))
+                    func(*value);
+        }
+    }
+
+    // Erases (and retires) every entry for which pred(Value&) returns true
+    template <typename Pred>
+    void eraseIf(Pred pred)
+    {
+        for (size_t i = 0; i < ShardCount; ++i)
+        {
+            std::lock_guard<std::mutex> lock(mShards[i].mutex);
+            Table* table = mShards[i].table.load(std::memory_order_relaxed);
+            for (size_t s = 0; s < table->capacity; ++s)
+            {
+                Value* value = table->slots[s].value.load(std::memory_order_relaxed);
+                if (value && pred(*value))
+                    removeSlot(table->slots[s]);
+            }
+        }
+    }
+
+    // Release what was retired once no guard can reach it any more (see EpochReclaimer::collect)
+    void collect() { EpochReclaimer::collect(); }
+
+    // Bucket statistics for diagnostics: calls func(capacity, used, liveEntries, probeLengthSum) per shard
+    template <typename Func>
+    void forEachShardStats(Func func) const
+    {
+        for (size_t i = 0; i < ShardCount; ++i)
+        {
+            std::lock_guard<std::mutex> lock(mShards[i].mutex);
+            const Table* table = mShards[i].table.load(std::memory_order_relaxed);
+            size_t live = 0, probes = 0;
+            for (size_t s = 0; s < table->capacity; ++s)
+                if (Value* value = table->slots[s].value.load(std::memory_order_relaxed))
+                {
+                    ++live;
+                    probes += ((s - slotOf(Hasher()(value->getPosition()), table->capacity)) & (table->capacity - 1)) + 1;
+                }
+            func(table->capacity, table->used, live, probes);
+        }
+    }
+
+private:
+    static constexpr size_t ShardCount = 64, MinCapacity = 16;
+    static constexpr uint64_t EmptyKey = uint64_t(1) << 63, TombKey = EmptyKey | 1;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> key{ EmptyKey };
+        std::atomic<Value*> value{ nullptr };
+        ReleaseData data{};
+    };
+
+    struct Table
+    {
+        explicit Table(size_t capacity_) : capacity(capacity_), slots(new Slot[capacity_]) {}
+        const size_t capacity;
+        // Slots that are not empty (live entries and tombstones)
+        size_t used = 0;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    struct Shard
+    {
+        std::atomic<Table*> table{ nullptr };
+        mutable std::mutex mutex;
+    };
+
+    std::unique_ptr<Shard[]> mShards;
+    std::atomic<size_t> mSize{ 0 };
+
+    // 21 bits per axis. Positions that differ by a multiple of 2^21 share a key, so a matching key
+    // only narrows the search and the value's own position decides.
+    static uint64_t packKey(const Vec3i& pos) noexcept
+    {
+        return (uint64_t(pos.x & 0x1FFFFF) << 42) | (uint64_t(pos.y & 0x1FFFFF) << 21) | uint64_t(pos.z & 0x1FFFFF);
+    }
+
+    Shard& shardOf(size_t hash) const noexcept { return mShards[hash & (ShardCount - 1)]; }
+    static size_t slotOf(size_t hash, size_t capacity) noexcept { return (hash >> 6) & (capacity - 1); }
+
+    // Writer only, under the shard lock
+    static Slot* locate(Table* table, size_t hash, const Vec3i& pos) noexcept
+    {
+        const uint64_t key = packKey(pos);
+        for (size_t i = slotOf(hash, table->capacity), n = 0; n < table->capacity; i = (i + 1) & (table->capacity - 1), ++n)
+        {
+            Slot& slot = table->slots[i];
+            const uint64_t k = slot.key.load(std::memory_order_relaxed);
+            if (k == EmptyKey)
+                return nullptr;
+            if (k == key && slot.value.load(std::memory_order_relaxed)->getPosition() == pos)
+                return &slot;
+        }
+        return nullptr;
+    }
+
+    // Writer only: the value is published before the key so readers never see a key without its value
+    static void place(Table* table, size_t hash, uint64_t key, Value* value, ReleaseData data) noexcept
+    {
+        for (size_t i = slotOf(hash, table->capacity);; i = (i + 1) & (table->capacity - 1))
+        {
+            Slot& slot = table->slots[i];
+            const uint64_t k = slot.key.load(std::memory_order_relaxed);
+            if (k == EmptyKey || k == TombKey)
+            {
+                if (k == EmptyKey)
+                    ++table->used;
+                slot.data = data;
+                slot.value.store(value, std::memory_order_release);
+                slot.key.store(key, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    void removeSlot(Slot& slot)
+    {
+        Value* old = slot.value.exchange(nullptr, std::memory_order_acq_rel);
+        slot.key.store(TombKey, std::memory_order_release);
+        retire(old, slot.data);
+        --mSize;
+    }
+
+    // Rebuild the shard's table without tombstones, doubling it if live entries need the room
+    Table* grow(Shard& shard)
+    {
+        Table* old = shard.table.load(std::memory_order_relaxed);
+        size_t live = 0;
+        for (size_t s = 0; s < old->capacity; ++s)
+            if (old->slots[s].value.load(std::memory_order_relaxed))
+                ++live;
+        size_t capacity = old->capacity;
+        while ((live + 1) * 2 > capacity)
+            capacity *= 2;
+        Table* table = new Table(capacity);
+        for (size_t s = 0; s < old->capacity; ++s)
+            if (Value* value = old->slots[s].value.load(std::memory_order_relaxed))
+                place(table, Hasher()(value->getPosition()), old->slots[s].key.load(std::memory_order_relaxed), value, old->slots[s].data);
+        shard.table.store(table, std::memory_order_release);
+        EpochReclaimer::retire([old] { delete old; });
+        return table;
+    }
+
+    static void retire(Value* value, ReleaseData data)
+    {
+        if (value)
+            EpochReclaimer::retire([value, data]() mutable { data(value); });
+    }
+};
+
+#endif // !CHUNKMAP_H_
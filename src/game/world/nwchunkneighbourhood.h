@@ -0,0 +1,87 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKNEIGHBOURHOOD_H_
+#define CHUNKNEIGHBOURHOOD_H_
+
+#include "nwchunk.h"
+
+// A chunk together with its 26 neighbours, resolved once.
+// Block coordinates are relative to the centre chunk and may range over [-Size, 2 * Size) on each axis,
+// so code that looks across chunk borders (meshing, lighting, collision) needs no map lookups.
+// Blocks in neighbours that are not loaded read as `fallback`.
+class ChunkNeighbourhood
+{
+public:
+    ChunkNeighbourhood(const ChunkManager& chunks, const Vec3i& centerPos, BlockData fallback = BlockData()) :
+        mPosition(centerPos), mFallback(fallback)
+    {
+        resolve([&chunks](const Vec3i& pos) { return chunks.find(pos); });
+    }
+
+    // Resolves the chunks through an observer's chunk pointer array
+    ChunkNeighbourhood(const ChunkManager& chunks, ChunkManager::Cache& cache, const Vec3i& centerPos, BlockData fallback = BlockData()) :
+        mPosition(centerPos), mFallback(fallback)
+    {
+        resolve([&chunks, &cache](const Vec3i& pos) { return chunks.find(pos, cache); });
+    }
+
+    const Vec3i& getPosition() const noexcept { return mPosition; }
+
+    // The chunk at centre + (dx, dy, dz), each in [-1, 1]. nullptr if not loaded.
+    Chunk* getChunk(int dx, int dy, int dz) const noexcept { return mChunks[index(dx + 1, dy + 1, dz + 1)]; }
+    Chunk* getCenter() const noexcept { return mChunks[13]; }
+
+    // Whether all 27 chunks are loaded
+    bool isComplete() const noexcept
+    {
+        for (auto chunk : mChunks)
+            if (!chunk)
+                return false;
+        return true;
+    }
+
+    BlockData get(int x, int y, int z) const
+    {
+        constexpr int size = Chunk::Size(), log2 = Chunk::SizeLog2();
+        Chunk* chunk = mChunks[index((x + size) >> log2, (y + size) >> log2, (z + size) >> log2)];
+        return chunk ? chunk->getBlock(Vec3i(x & (size - 1), y & (size - 1), z & (size - 1))) : mFallback;
+    }
+
+    BlockData get(const Vec3i& pos) const { return get(pos.x, pos.y, pos.z); }
+
+private:
+    Vec3i mPosition;
+    BlockData mFallback;
+    Chunk* mChunks[27];
+
+    static constexpr int index(int x, int y, int z) noexcept { return (x * 3 + y) * 3 + z; }
+
+    template <typename Find>
+    void resolve(Find find)
+    {
+        Vec3i d;
+        for (d.x = -1; d.x <= 1; ++d.x)
+            for (d.y = -1; d.y <= 1; ++d.y)
+                for (d.z = -1; d.z <= 1; ++d.z)
+                    mChunks[index(d.x + 1, d.y + 1, d.z + 1)] = find(mPosition + d);
+    }
+};
+
+#endif // !CHUNKNEIGHBOURHOOD_H_
@@ -0,0 +1,89 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKPOINTERARRAY_H_
+#define CHUNKPOINTERARRAY_H_
+
+#include <memory>
+#include <cstdint>
+#include <engine/common.h>
+
+// Caches chunk pointers around one observer (usually a player) to accelerate chunk lookup.
+// A dense ring buffer of Size^3 slots addressed by chunk position modulo Size, so every chunk within
+// Radius of the centre has a slot of its own and moving the centre never shifts any data.
+// Each observer owns its array and uses it from one thread only. Slots hold the chunk's position and the
+// generation of the chunk map they were filled at, so a lookup validates them without touching the chunk:
+// the map bumps its generation whenever it erases or replaces a chunk, which invalidates every slot at once.
+template <class Value, int SizeLog2 = 5>
+class ChunkPointerArray : public NonCopyable
+{
+public:
+    static constexpr int Size = 1 << SizeLog2, Radius = Size / 2 - 1;
+
+    ChunkPointerArray() = default;
+    ChunkPointerArray(ChunkPointerArray&& rhs) noexcept : mSlots(std::move(rhs.mSlots)), mCenter(rhs.mCenter) {}
+
+    // nullptr if pos was not cached at `generation` (it may still be loaded)
+    Value* get(const Vec3i& pos, uint64_t generation) const noexcept
+    {
+        if (!mSlots)
+            return nullptr;
+        const Slot& s = slot(pos);
+        return (s.generation == generation && s.position == pos) ? s.value : nullptr;
+    }
+
+    // Cache a chunk found in the map at `generation` (read before the lookup) if it lies within range of the centre
+    void put(const Vec3i& pos, Value* value, uint64_t generation) noexcept
+    {
+        if (mSlots && inRange(pos))
+            slot(pos) = Slot{ value, pos, generation };
+    }
+
+    // Move the observer. Nothing is cached until the centre is first set.
+    void setCenter(const Vec3i& center)
+    {
+        if (!mSlots)
+            mSlots.reset(new Slot[Size * Size * Size]);
+        mCenter = center;
+    }
+
+    const Vec3i& getCenter() const noexcept { return mCenter; }
+
+    bool inRange(const Vec3i& pos) const noexcept { return mCenter.chebyshevDistance(pos) <= Radius; }
+
+private:
+    struct Slot
+    {
+        Value* value = nullptr;
+        Vec3i position;
+        // No map starts at this generation, so fresh slots never match
+        uint64_t generation = UINT64_MAX;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    Vec3i mCenter;
+
+    Slot& slot(const Vec3i& pos) const noexcept
+    {
+        constexpr int mask = Size - 1;
+        return mSlots[((pos.x & mask) << (SizeLog2 * 2)) | ((pos.y & mask) << SizeLog2) | (pos.z & mask)];
+    }
+};
+
+#endif // !CHUNKPOINTERARRAY_H_
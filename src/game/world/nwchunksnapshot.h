@@ -0,0 +1,142 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKSNAPSHOT_H_
+#define CHUNKSNAPSHOT_H_
+
+#include <vector>
+#include <algorithm>
+#include "nwchunkneighbourhood.h"
+
+// A copy of a chunk's blocks together with a one block border taken from its neighbours.
+// Owns its data, so it can be meshed on another thread while the chunks themselves change or unload.
+// Block coordinates are relative to the chunk and range over [-1, Size] on each axis.
+class ChunkSnapshot
+{
+public:
+    static constexpr int Padded = Chunk::Size() + 2;
+
+    explicit ChunkSnapshot(const ChunkNeighbourhood& chunks) :
+        mPosition(chunks.getPosition()), mWorld(chunks.getCenter()->getWorld()),
+        mUniform(chunks.getCenter()->isUniform()), mBlocks(Padded * Padded * Padded)
+    {
+        constexpr int size = Chunk::Size();
+        static thread_local std::vector<BlockData> flat(size * size * size);
+        chunks.getCenter()->getBlocks(flat.data());
+        for (int x = 0; x < size; ++x)
+            for (int y = 0; y < size; ++y)
+                std::copy_n(flat.data() + (x * size + y) * size, size, mBlocks.data() + index(x, y, 0));
+        for (int x = -1; x <= size; ++x)
+            for (int y = -1; y <= size; ++y)
+            {
+                const bool edge = x < 0 || x == size || y < 0 || y == size;
+                for (int z = -1; z <= size; z += (edge ? 1 : size + 1))
+                    mBlocks[index(x, y, z)] = chunks.get(x, y, z);
+            }
+    }
+
+    // The chunk at a coarser level of detail: each cube of 2^lod blocks on a side reads as a single block,
+    // the top-most non-air block in it if at least half of the cube is not air, otherwise the top-most air
+    // block, which carries the cube's light. The border
+    // comes from the neighbours' cubes the same way, so neighbouring chunks at the same level agree.
+    ChunkSnapshot(const ChunkNeighbourhood& chunks, int lod) : ChunkSnapshot(chunks)
+    {
+        constexpr int size = Chunk::Size();
+        Assert(lod >= 0 && (1 << lod) <= size);
+        mLod = lod;
+        if (lod == 0)
+            return;
+        const int scale = 1 << lod, cells = size >> lod;
+        Vec3i cell;
+        for (cell.x = -1; cell.x <= cells; ++cell.x)
+            for (cell.y = -1; cell.y <= cells; ++cell.y)
+                for (cell.z = -1; cell.z <= cells; ++cell.z)
+                {
+                    const bool inside = cell.x >= 0 && cell.x < cells && cell.y >= 0 && cell.y < cells &&
+                                        cell.z >= 0 && cell.z < cells;
+                    // Cells of the chunk come from the copy, each read before it is overwritten.
+                    // Border cells lie in one neighbour each, which is often uniform.
+                    const Vec3i side = cell.transform([cells](int v) { return v < 0 ? -1 : (v >= cells ? 1 : 0); });
+                    const Chunk* neighbour = chunks.getChunk(side.x, side.y, side.z);
+                    BlockData block;
+                    if (inside)
+                        block = downsample(cell * scale, scale, [this](int x, int y, int z) { return get(x, y, z); });
+                    else if (neighbour && neighbour->isUniform())
+                        block = neighbour->getBlock(Vec3i(0, 0, 0));
+                    else
+                        block = downsample(cell * scale, scale, [&chunks](int x, int y, int z) { return chunks.get(x, y, z); });
+                    const Vec3i begin = (cell * scale).transform([](int v) { return std::max(v, -1); });
+                    const Vec3i end = ((cell + Vec3i(1, 1, 1)) * scale).transform([](int v) { return std::min(v, size + 1); });
+                    for (int x = begin.x; x < end.x; ++x)
+                        for (int y = begin.y; y < end.y; ++y)
+                            std::fill_n(mBlocks.data() + index(x, y, begin.z), end.z - begin.z, block);
+                }
+    }
+
+    const Vec3i& getPosition() const noexcept { return mPosition; }
+    // Level of detail: blocks are cubes of 2^lod
+    int getLod() const noexcept { return mLod; }
+    // The world the chunk belongs to, for block types
+    World* getWorld() const noexcept { return mWorld; }
+    // Whether the chunk itself (not its border) holds a single block
+    bool isUniform() const noexcept { return mUniform; }
+
+    BlockData get(int x, int y, int z) const { return mBlocks[index(x, y, z)]; }
+    BlockData get(const Vec3i& pos) const { return get(pos.x, pos.y, pos.z); }
+
+    // All Padded^3 blocks, x-major, then y, then z
+    const BlockData* getData() const noexcept { return mBlocks.data(); }
+
+    static constexpr int index(int x, int y, int z) noexcept { return ((x + 1) * Padded + y + 1) * Padded + z + 1; }
+
+private:
+    Vec3i mPosition;
+    World* mWorld;
+    bool mUniform;
+    int mLod = 0;
+    std::vector<BlockData> mBlocks;
+
+    template <class Get>
+    static BlockData downsample(const Vec3i& begin, int scale, Get get)
+    {
+        const int volume = scale * scale * scale, half = (volume + 1) / 2;
+        int filled = 0, left = volume;
+        BlockData top, air;
+        bool seenAir = false;
+        // Top down, stopping as soon as the outcome is certain
+        for (int y = begin.y + scale - 1; y >= begin.y; --y)
+            for (int x = begin.x; x < begin.x + scale; ++x)
+                for (int z = begin.z; z < begin.z + scale; ++z)
+                {
+                    const BlockData block = get(x, y, z);
+                    --left;
+                    if (block.getID() != 0 && filled++ == 0)
+                        top = block;
+                    else if (block.getID() == 0 && !seenAir)
+                        air = block, seenAir = true;
+                    if (filled >= half)
+                        return top;
+                    if (filled + left < half)
+                        return air;
+                }
+        return air;
+    }
+};
+
+#endif // !CHUNKSNAPSHOT_H_
@@ -0,0 +1,177 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nwreclaimer.h"
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    // One per thread that ever pinned. Records are never freed: a thread exiting leaves its record for the next one.
+    struct ThreadRecord
+    {
+        // 0 while not pinned, otherwise the epoch the outermost guard started in
+        std::atomic<uint64_t> epoch{ 0 };
+        std::atomic<bool> used{ true };
+        ThreadRecord* next = nullptr;
+        // Guard nesting, only touched by the owning thread
+        int depth = 0;
+    };
+
+    struct Retired
+    {
+        uint64_t epoch;
+        std::function<void()> release;
+    };
+
+    struct State
+    {
+        // Starts at 1 so that 0 can mean "not pinned"
+        std::atomic<uint64_t> epoch{ 1 };
+        std::atomic<ThreadRecord*> records{ nullptr };
+        std::mutex mutex;
+        std::vector<Retired> retired;
+    };
+
+    State& state()
+    {
+        // Never destroyed: threads may still retire or pin while statics are torn down
+        static State* s = new State;
+        return *s;
+    }
+
+    ThreadRecord* acquireRecord()
+    {
+        State& s = state();
+        for (ThreadRecord* record = s.records.load(std::memory_order_acquire); record; record = record->next)
+        {
+            bool used = false;
+            if (!record->used.load(std::memory_order_relaxed) && record->used.compare_exchange_strong(used, true))
+                return record;
+        }
+        ThreadRecord* record = new ThreadRecord;
+        record->next = s.records.load(std::memory_order_relaxed);
+        while (!s.records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed));
+        return record;
+    }
+
+    // Plain pointer for the fast path; LocalRecord hands the record back when the thread exits
+    thread_local ThreadRecord* tRecord = nullptr;
+
+    struct LocalRecord
+    {
+        ThreadRecord* record = acquireRecord();
+        ~LocalRecord()
+        {
+            tRecord = nullptr;
+            record->depth = 0;
+            record->epoch.store(0, std::memory_order_release);
+            record->used.store(false, std::memory_order_release);
+        }
+    };
+
+    ThreadRecord& localRecord()
+    {
+        if (!tRecord)
+        {
+            static thread_local LocalRecord local;
+            tRecord = local.record;
+        }
+        return *tRecord;
+    }
+}
+
+void EpochReclaimer::pin()
+{
+    ThreadRecord& record = localRecord();
+    if (record.depth++ != 0)
+        return;
+    record.epoch.store(state().epoch.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+    // The announcement must be visible before any shared pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochReclaimer::unpin() noexcept
+{
+    ThreadRecord& record = localRecord();
+    Assert(record.depth > 0);
+    if (--record.depth == 0)
+        record.epoch.store(0, std::memory_order_release);
+}
+
+bool EpochReclaimer::isPinned() noexcept
+{
+    return localRecord().depth > 0;
+}
+
+void EpochReclaimer::retire(std::function<void()> release)
+{
+    State& s = state();
+    // Read after the caller unlinked the object: a guard announcing a later epoch cannot reach it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t epoch = s.epoch.load(std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.retired.push_back({ epoch, std::move(release) });
+}
+
+size_t EpochReclaimer::collect()
+{
+    State& s = state();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = s.epoch.load(std::memory_order_seq_cst);
+    bool caughtUp = true;
+    for (ThreadRecord* record = s.records.load(std::memory_order_acquire); record && caughtUp; record = record->next)
+    {
+        const uint64_t announced = record->epoch.load(std::memory_order_seq_cst);
+        caughtUp = announced == 0 || announced == epoch;
+    }
+    // On failure someone else advanced it, and epoch now holds their value
+    if (caughtUp && s.epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst))
+        ++epoch;
+
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto mid = std::partition(s.retired.begin(), s.retired.end(), [epoch](const Retired& r) { return r.epoch + 2 > epoch; });
+        ready.assign(std::make_move_iterator(mid), std::make_move_iterator(s.retired.end()));
+        s.retired.erase(mid, s.retired.end());
+    }
+    // Outside the lock: a release may retire more
+    for (auto&& r : ready)
+        r.release();
+    return ready.size();
+}
+
+EpochReclaimer::Stats EpochReclaimer::getStats()
+{
+    State& s = state();
+    Stats stats{ s.epoch.load(), 0, 0, 0 };
+    for (ThreadRecord* record = s.records.load(std::memory_order_acquire); record; record = record->next)
+    {
+        stats.threads += record->used.load(std::memory_order_relaxed);
+        stats.pinned += record->epoch.load(std::memory_order_relaxed) != 0;
+    }
+    std::lock_guard<std::mutex> lock(s.mutex);
+    stats.pending = s.retired.size();
+    return stats;
+}
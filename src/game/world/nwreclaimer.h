@@ -0,0 +1,67 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RECLAIMER_H_
+#define RECLAIMER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <engine/common.h>
+
+// Epoch based reclamation for the lock-free chunk structures.
+// A thread reading shared data holds a Guard, which announces the global epoch it started in.
+// Writers unlink an object, then retire() it. collect() advances the epoch only once every pinned
+// thread has announced the current one, and runs a release after the epoch has moved twice past its
+// retirement: by then every guard that could have reached the object has ended.
+// Guards nest, and only the outermost one announces anything. A thread staying pinned holds back all
+// reclamation, so guards must not be kept across blocking waits.
+class NWCOREAPI EpochReclaimer
+{
+public:
+    class Guard : public NonCopyable
+    {
+    public:
+        Guard() { pin(); }
+        ~Guard() { unpin(); }
+    };
+
+    struct Stats
+    {
+        uint64_t epoch;
+        // Retired and not yet released
+        size_t pending;
+        // Threads holding a record, and those pinned right now
+        size_t threads, pinned;
+    };
+
+    // Release an object, unlinked from every shared structure, once no guard can still hold it
+    static void retire(std::function<void()> release);
+    // Advance the epoch if every pinned thread has caught up, then run the releases that became safe.
+    // Any thread may call it, pinned or not. Returns the number of releases run.
+    static size_t collect();
+    static bool isPinned() noexcept;
+    static Stats getStats();
+
+private:
+    static void pin();
+    static void unpin() noexcept;
+};
+
+#endif // !RECLAIMER_H_
@@ -67,6 +67,15 @@ public:
         return mSpeed;
     }
 
+    // Chunk pointers around this player, for lookups on the thread that updates it
+    ChunkManager::Cache& getChunkCache() noexcept
+    {
+        return mChunkCache;
+    }
+
+protected:
+    ChunkManager::Cache mChunkCache;
+
 private:
     Vec3d mDirection; // Body direction, head direction is `mRotation` in class Object
     double mHeight, mWidth, mSpeed;
@@ -18,21 +18,32 @@
 */
 
 #include <world/world.h>
+#include <world/nwchunkneighbourhood.h>
 
 size_t World::IDCount = 0;
 
-std::vector<AABB> World::getHitboxes(const AABB& range) const
+std::vector<AABB> World::getHitboxes(const AABB& range, ChunkManager::Cache* cache) const
 {
     std::vector<AABB> res;
+    const Vec3i lo(int(floor(range.min.x)), int(floor(range.min.y)), int(floor(range.min.z)));
+    const Vec3i hi(int(ceil(range.max.x)), int(ceil(range.max.y)), int(ceil(range.max.z)));
+    // Entity sized ranges fit in the neighbourhood of their first chunk: resolve those chunks once
+    const Vec3i base = getChunkPos(lo) * Chunk::Size();
+    const bool local = hi.x - base.x <= Chunk::Size() * 2 && hi.y - base.y <= Chunk::Size() * 2 && hi.z - base.z <= Chunk::Size() * 2;
+    const ChunkNeighbourhood chunks = cache ? ChunkNeighbourhood(mChunks, *cache, getChunkPos(lo)) : ChunkNeighbourhood(mChunks, getChunkPos(lo));
     Vec3i curr;
-    for (curr.x = int(floor(range.min.x)); curr.x < int(ceil(range.max.x)); curr.x++)
-        for (curr.y = int(floor(range.min.y)); curr.y < int(ceil(range.max.y)); curr.y++)
-            for (curr.z = int(floor(range.min.z)); curr.z < int(ceil(range.max.z)); curr.z++)
+    for (curr.x = lo.x; curr.x < hi.x; curr.x++)
+        for (curr.y = lo.y; curr.y < hi.y; curr.y++)
+            for (curr.z = lo.z; curr.z < hi.z; curr.z++)
             {
                 // TODO: BlockType::getAABB
-                if (!isChunkLoaded(getChunkPos(curr)))
-                    continue;
-                if (getBlock(curr).getID() == 0)
+                // Blocks in chunks that are not loaded read as air
+                BlockData block;
+                if (local)
+                    block = chunks.get(curr - base);
+                else if (const Chunk* chunk = cache ? mChunks.find(getChunkPos(curr), *cache) : mChunks.find(getChunkPos(curr)))
+                    block = chunk->getBlock(getBlockPos(curr));
+                if (block.getID() == 0)
                     continue;
                 Vec3d currd = curr;
                 res.push_back(AABB(currd, currd + Vec3d(1.0, 1.0, 1.0)));
@@ -42,16 +53,13 @@ std::vector<AABB> World::getHitboxes(const AABB& range) const
 
 void World::update()
 {
+    // Release chunks unloaded earlier once no other thread's guard can still reach them
+    mChunks.collect();
 }
 
 void World::updateChunkLoadStatus()
 {
     std::unique_lock<std::mutex> lock(mMutex);
-    for (auto iter = mChunks.begin(); iter != mChunks.end();)
-    {
-        if (iter->second->checkReleaseable())
-            iter = mChunks.erase(iter);
-        else
-            ++iter;
-    }
+    mChunks.eraseIf([](Chunk& chunk) { return chunk.checkReleaseable(); });
+    mChunks.collect();
 }
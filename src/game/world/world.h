@@ -26,6 +26,7 @@
 #include <cstdlib>
 #include <algorithm>
 #include <world/nwchunk.h>
+#include <world/nwchunkloader.h>
 #include <engine/common.h>
 
 class PluginManager;
@@ -55,7 +56,6 @@ public:
     ////////////////////////////////////////
     // Chunk Management
     ////////////////////////////////////////
-    using ChunkIterator = ChunkManager::iterator;
     using ChunkReference = ChunkManager::reference;
     // Raw Access
     ChunkManager& getChunks() noexcept { return mChunks; }
@@ -64,25 +64,54 @@ public:
     size_t getChunkCount() const { return mChunks.size(); }
     ChunkReference getChunk(const Vec3i& ChunkPos) { return mChunks[ChunkPos]; }
     bool isChunkLoaded(const Vec3i& ChunkPos) const noexcept { return mChunks.isLoaded(ChunkPos); }
+    bool isChunkLoaded(const Vec3i& ChunkPos, ChunkManager::Cache& cache) const noexcept { return mChunks.isLoaded(ChunkPos, cache); }
     void deleteChunk(const Vec3i& ChunkPos) { mChunks.erase(ChunkPos); }
     static int getChunkAxisPos(int pos) { return ChunkManager::getAxisPos(pos); }
     static Vec3i getChunkPos(const Vec3i& pos) { return ChunkManager::getPos(pos); }
     static int getBlockAxisPos(int pos) { return ChunkManager::getBlockAxisPos(pos); }
     static Vec3i getBlockPos(const Vec3i& pos) { return ChunkManager::getBlockPos(pos); }
     BlockData getBlock(const Vec3i& pos) const { return mChunks.getBlock(pos); }
-    void setBlock(const Vec3i& pos, BlockData block) { mChunks.setBlock(pos, block); }
-    auto insertChunk(const Vec3i& pos, ChunkManager::data_t&& ptr) { return mChunks.insert(pos, std::move(ptr)); }
-    auto resetChunk(const Vec3i& pos, Chunk* ptr) { return mChunks.reset(pos, ptr); }
+    // Through the chunk pointer array of an observer on the calling thread
+    BlockData getBlock(const Vec3i& pos, ChunkManager::Cache& cache) const { return mChunks.getBlock(pos, cache); }
+    // Nothing propagates light yet, so air set without any takes daylight, as generated air has
+    void setBlock(const Vec3i& pos, BlockData block)
+    {
+        if (block.getID() == 0 && block.getBrightness() == 0)
+            block.setBrightness(static_cast<uint32_t>(mDaylightBrightness));
+        mChunks.setBlock(pos, block);
+    }
+    Chunk* insertChunk(const Vec3i& pos, ChunkManager::data_t&& ptr) { return mChunks.insert(pos, std::move(ptr)); }
+    Chunk* resetChunk(const Vec3i& pos, Chunk* ptr) { return mChunks.reset(pos, ptr); }
     template <typename... ArgType, typename Func>
     void doIfChunkLoaded(const Vec3i& ChunkPos, Func func, ArgType&&... args)
     {
         mChunks.doIfLoaded(ChunkPos, func, std::forward<ArgType>(args)...);
     };
 
-    // Add Chunk
+    // Flag the 26 chunks around chunkPos for re-rendering, after a chunk was added there.
+    // Only their blocks touching chunkPos can change faces or corner lighting.
+    void markNeighboursUpdated(const Vec3i& chunkPos)
+    {
+        Vec3i p;
+        for (p.x = -1; p.x <= 1; ++p.x)
+            for (p.y = -1; p.y <= 1; ++p.y)
+                for (p.z = -1; p.z <= 1; ++p.z)
+                {
+                    if (p == Vec3i(0, 0, 0))
+                        continue;
+                    // The layer, edge or corner of the neighbour touching chunkPos
+                    const Vec3i begin = p.transform([](int v) { return v < 0 ? Chunk::Size() - 1 : 0; });
+                    const Vec3i end = p.transform([](int v) { return v > 0 ? 1 : Chunk::Size(); });
+                    doIfChunkLoaded(chunkPos + p, [&](Chunk& chk) { chk.markDirty(begin, end); });
+                }
+    }
+
+    // Add Chunk (generated synchronously, see ChunkLoader for the asynchronous way)
     virtual Chunk* addChunk(const Vec3i& chunkPos, ChunkOnReleaseBehavior::Behavior behv = ChunkOnReleaseBehavior::Behavior::Release) 
     {
-        return insertChunk(chunkPos, std::move(ChunkManager::data_t(new Chunk(chunkPos, *this), ChunkOnReleaseBehavior(behv))))->second.get();
+        Chunk* chunk = insertChunk(chunkPos, std::move(ChunkManager::data_t(new Chunk(chunkPos, *this), ChunkOnReleaseBehavior(behv))));
+        markNeighboursUpdated(chunkPos);
+        return chunk;
     }
 
 
@@ -92,7 +121,8 @@ public:
     const BlockManager& getBlockTypes() const { return mBlocks; }
     const BlockType& getType(int id) const { return mBlocks[id]; }
 
-    NWCOREAPI std::vector<AABB> getHitboxes(const AABB& range) const;
+    // Chunks are resolved through `cache` when an observer on the calling thread supplies one
+    NWCOREAPI std::vector<AABB> getHitboxes(const AABB& range, ChunkManager::Cache* cache = nullptr) const;
 
     // Main update
     NWCOREAPI void update();
@@ -125,14 +155,19 @@ public:
 
     ~WorldManager()
     {
+        mLoader.stop();
         mWorlds.clear();
     }
 
     void clear()
     {
+        mLoader.stop();
         mWorlds.clear();
     }
 
+    // Generates chunks for all worlds in the background
+    ChunkLoader& getLoader() noexcept { return mLoader; }
+
     World* addWorld(const std::string& name)
     {
         mWorlds.emplace_back(new World(name, mPlugins, mBlocks));
@@ -171,6 +206,7 @@ private:
     std::vector<std::unique_ptr<World>> mWorlds;
     PluginManager& mPlugins;
     BlockManager& mBlocks;
+    ChunkLoader mLoader;
 };
 
 #endif // !WORLD_H_
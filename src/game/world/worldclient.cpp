@@ -20,86 +20,181 @@
 #include "worldclient.h"
 #include <network/clientgameconnection.h>
 
-void WorldClient::renderUpdate(const Vec3i& position)
+void WorldClient::renderUpdate(const Vec3i& position, ChunkManager::Cache& cache)
 {
     Vec3i chunkpos = getChunkPos(position);
-    for (auto&& chunk : mChunks)
+    // Renderers out of range, or of chunks unloaded since
+    for (auto iter = mChunkRenderers.begin(); iter != mChunkRenderers.end();)
     {
-        // In render range, pending to render
-        if (chunkpos.chebyshevDistance(chunk.second->getPosition()) <= mRenderDist)
-        {
-            if ((mChunkRenderers.find(chunk.second.get()) == mChunkRenderers.end()) &&
-                    neighbourChunkLoadCheck(chunk.second->getPosition()))
-                mChunkRenderList.insert((chunk.second->getPosition() * Chunk::Size() + middleOffset() - position).lengthSqr(), chunk.second.get());
-        }
+        if (chunkpos.chebyshevDistance(iter->first) > mRenderDist || !mChunks.find(iter->first))
+            iter = mChunkRenderers.erase(iter);
         else
+            ++iter;
+    }
+    mChunks.forEach([&](Chunk& chunk)
+    {
+        // In render range, pending to render, or rendered and changed since, or at another level of detail
+        if (chunkpos.chebyshevDistance(chunk.getPosition()) <= mRenderDist)
         {
-            auto iter = mChunkRenderers.find(chunk.second.get());
-            if (iter != mChunkRenderers.end())
-                mChunkRenderers.erase(iter);
+            auto renderer = mChunkRenderers.find(chunk.getPosition());
+            if ((renderer == mChunkRenderers.end() || chunk.isUpdated() ||
+                    (renderer->second.getLod() != getLod(chunk.getPosition(), chunkpos) && !isAir(chunk))) &&
+                    !mMeshesInFlight.count(chunk.getPosition()) &&
+                    neighbourChunkLoadCheck(chunk.getPosition(), cache))
+                mChunkRenderList.insert((chunk.getPosition() * Chunk::Size() + middleOffset() - position).lengthSqr(), &chunk);
         }
-    }
+    });
 
     for (auto&& op : mChunkRenderList)
     {
-        op.second->setUpdated(false);
-        mChunkRenderers.insert(std::pair<Chunk*, ChunkRenderer>(op.second, std::move(ChunkRenderer(op.second))));
+        if (mMeshesInFlight.size() >= MaxChunkMeshesInFlight)
+            break;
+        Chunk* chunk = op.second;
+        auto renderer = mChunkRenderers.find(chunk->getPosition());
+        const int lod = getLod(chunk->getPosition(), chunkpos);
+        // Rendered chunks only remesh the sections their edits touched, unless the level of detail changed
+        const unsigned sections = (renderer != mChunkRenderers.end() && renderer->second.getLod() == lod) ?
+                                  ChunkMesh::getSections(chunk->getDirtyCells()) : ChunkMesh::AllSections;
+        chunk->setUpdated(false);
+        // All air: nothing to mesh, at any level of detail
+        if (renderer == mChunkRenderers.end() && isAir(*chunk))
+        {
+            mChunkRenderers.emplace(chunk->getPosition(), ChunkRenderer());
+            continue;
+        }
+        // Copy the blocks now; the builder never touches live chunks.
+        // Neighbours not loaded yet read as daylit air, so faces toward them aren't lit black until they arrive.
+        const BlockData daylight(0, getDaylightBrightness(), 0);
+        std::unique_ptr<ChunkSnapshot> snapshot(new ChunkSnapshot(ChunkNeighbourhood(mChunks, cache, chunk->getPosition(), daylight), lod));
+        if (mMeshBuilder.request(std::move(snapshot), ChunkRenderer::getMergeFace(), ChunkRenderer::getPackedVertices(),
+                                 sections, op.first))
+            mMeshesInFlight.emplace(chunk->getPosition(), chunk);
     }
     mChunkRenderList.clear();
 }
 
-size_t WorldClient::render(const Vec3i& position) const
+size_t WorldClient::uploadMeshes()
 {
-    Vec3i chunkpos = getChunkPos(position);
-    size_t renderedChunks = 0;
-    for (auto&& c : mChunkRenderers)
+    auto meshes = mMeshBuilder.poll(mMeshUploadBudget);
+    for (auto&& mesh : meshes)
     {
-        if (chunkpos.chebyshevDistance(c.first->getPosition()) <= mRenderDist)
-            c.second.render(c.first->getPosition());
+        auto iter = mMeshesInFlight.find(mesh.position);
+        if (iter == mMeshesInFlight.end())
+            continue;
+        Chunk* chunk = iter->second;
+        mMeshesInFlight.erase(iter);
+        // Drop meshes of chunks unloaded (or replaced) while they were built
+        if (mChunks.find(mesh.position) != chunk)
+            continue;
+        auto renderer = mChunkRenderers.find(mesh.position);
+        // Sections of another level of detail don't fit: mesh the whole chunk again
+        if (renderer != mChunkRenderers.end() && mesh.sections != ChunkMesh::AllSections &&
+                renderer->second.getLod() != mesh.lod)
+            chunk->setUpdated(true);
+        else if (renderer != mChunkRenderers.end())
+            renderer->second.update(mesh);
+        // A partial mesh needs the rest of the chunk: its renderer went out of range meanwhile,
+        // so the chunk is meshed in full when it comes back
+        else if (mesh.sections == ChunkMesh::AllSections)
+            mChunkRenderers.emplace(mesh.position, ChunkRenderer(mesh));
     }
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    return meshes.size();
+}
+
+size_t WorldClient::render(const Vec3f& eye, const Mat4f& viewProjection)
+{
+    Vec3i chunkpos = getChunkPos(Vec3i(eye));
+    const Frustum frustum(viewProjection);
+    mDrawList.clear();
+    if (mOcclusionCulling)
+    {
+        auto&& visible = mCuller.cull(chunkpos, mRenderDist, mFrustumCulling ? &frustum : nullptr, [this](const Vec3i& pos)
+        {
+            // Chunks not loaded or not meshed yet could hold anything, so they hide nothing
+            auto iter = mChunkRenderers.find(pos);
+            return iter != mChunkRenderers.end() ? iter->second.getVisibility() : ChunkVisibility::All;
+        });
+        for (auto&& pos : visible)
+        {
+            auto iter = mChunkRenderers.find(pos);
+            if (iter != mChunkRenderers.end())
+                mDrawList.emplace_back(pos, &iter->second);
+        }
+    }
+
+    // Renderers in range: drawn, outside the frustum, or else hidden
+    size_t inRange = 0, outside = 0;
     for (auto&& c : mChunkRenderers)
     {
-        if (chunkpos.chebyshevDistance(c.first->getPosition()) <= mRenderDist)
-            c.second.renderTrans(c.first->getPosition());
+        const Vec3i& pos = c.first;
+        if (chunkpos.chebyshevDistance(pos) > mRenderDist)
+            continue;
+        ++inRange;
+        const bool inside = !mFrustumCulling || ChunkCuller::inFrustum(frustum, pos);
+        outside += !inside;
+        if (!mOcclusionCulling && inside)
+            mDrawList.emplace_back(pos, &c.second);
     }
+    mRenderStats = { mDrawList.size(), outside, inRange - mDrawList.size() - outside, 0 };
+
+    ChunkRenderer::beginRender();
+    for (auto&& c : mDrawList)
+        c.second->render(c.first);
+    ChunkRenderer::drawQueued();
+    ChunkRenderer::endRender();
+    for (auto&& c : mDrawList)
+        c.second->renderFallback(c.first);
+    ChunkRenderer::beginRender();
+    // Blending needs what is behind drawn first
+    const Vec3f centre = eye - Vec3f(float(Chunk::Size() / 2), float(Chunk::Size() / 2), float(Chunk::Size() / 2));
+    std::sort(mDrawList.begin(), mDrawList.end(), [&centre](const std::pair<Vec3i, ChunkRenderer*>& a, const std::pair<Vec3i, ChunkRenderer*>& b)
+    {
+        return (Vec3f(a.first * Chunk::Size()) - centre).lengthSqr() > (Vec3f(b.first * Chunk::Size()) - centre).lengthSqr();
+    });
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (auto&& c : mDrawList)
+        mRenderStats.sorted += c.second->renderTrans(c.first, eye);
     glDisable(GL_BLEND);
-    return renderedChunks;
+    ChunkRenderer::endRender();
+    return mDrawList.size();
 }
 
-void WorldClient::sortChunkLoadUnloadList(const Vec3i& centerPos)
+void WorldClient::sortChunkLoadUnloadList(const Vec3i& centerPos, ChunkManager::Cache& cache)
 {
     // centerPos to chunk coords
     Vec3i centerCPos = getChunkPos(centerPos);
+    mLoadCenter = centerCPos;
 
-    for (auto&& chunk : mChunks)
+    mChunks.forEach([&](Chunk& chunk)
     {
-        Vec3i curPos = chunk.second->getPosition();
+        Vec3i curPos = chunk.getPosition();
         // Out of load range, pending to unload
         if (centerCPos.chebyshevDistance(curPos) > mLoadRange)
-            mChunkUnloadList.insert((curPos * Chunk::Size() + middleOffset() - centerPos).lengthSqr(), chunk.second.get());
-    }
+            mChunkUnloadList.insert((curPos * Chunk::Size() + middleOffset() - centerPos).lengthSqr(), &chunk);
+    });
 
     for (int x = centerCPos.x - mLoadRange; x <= centerCPos.x + mLoadRange; x++)
         for (int y = centerCPos.y - mLoadRange; y <= centerCPos.y + mLoadRange; y++)
             for (int z = centerCPos.z - mLoadRange; z <= centerCPos.z + mLoadRange; z++)
                 // In load range, pending to load
-                if (!isChunkLoaded(Vec3i(x, y, z)))
+                if (!isChunkLoaded(Vec3i(x, y, z), cache))
                     mChunkLoadList.insert((Vec3i(x, y, z) * Chunk::Size() + middleOffset() - centerPos).lengthSqr(), Vec3i(x, y, z));
 }
 
 void WorldClient::tryLoadChunks(ClientGameConnection& conn)
 {
     for (auto&& op : mChunkLoadList)
-        conn.getChunk(op.second);
+        conn.getChunk(op.second, mLoadCenter);
     for (auto&& op : mChunkUnloadList)
         deleteChunk(op.second->getPosition());
+    mChunks.collect();
+    conn.flushChunkRequests(mLoadCenter);
     mChunkLoadList.clear();
     mChunkUnloadList.clear();
 }
 
-bool WorldClient::neighbourChunkLoadCheck(const Vec3i& pos)
+bool WorldClient::neighbourChunkLoadCheck(const Vec3i& pos, ChunkManager::Cache& cache)
 {
     constexpr std::array<Vec3i, 6> delta
     {
@@ -107,7 +202,7 @@ bool WorldClient::neighbourChunkLoadCheck(const Vec3i& pos)
             Vec3i(0,-1, 0), Vec3i(0, 0, 1), Vec3i(0, 0,-1)
     };
     for (auto&& p : delta)
-        if (!isChunkLoaded(pos + p))
+        if (!isChunkLoaded(pos + p, cache))
             return false;
     return true;
 }
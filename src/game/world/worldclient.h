@@ -21,13 +21,20 @@
 #define WORLDCLIENT_H_
 
 #include <array>
+#include <climits>
 #include <unordered_map>
 #include <world/world.h>
 #include "renderer/chunkrenderer.h"
+#include "renderer/chunkmeshbuilder.h"
+#include "renderer/chunkculler.h"
 
 class ClientGameConnection;
 
-const int MaxChunkRenderCount = 4;
+const int MaxChunkRenderCount = 16;
+// Levels of detail beyond full resolution: 2x, 4x and 8x blocks
+constexpr int MaxChunkLod = 3;
+// Snapshots handed to the mesh builder and not yet uploaded
+constexpr size_t MaxChunkMeshesInFlight = 64;
 constexpr int MaxChunkLoadCount = 64, MaxChunkUnloadCount = 64;
 
 // POD ONLY!
@@ -72,6 +79,14 @@ private:
 class WorldClient : public World
 {
 public:
+    // Chunk renderers in render range during the last render()
+    struct RenderStats
+    {
+        size_t drawn, frustumCulled, occlusionCulled;
+        // Chunks whose translucent faces were sorted again for the camera
+        size_t sorted;
+    };
+
     WorldClient(const std::string& name, const PluginManager& plugins, const BlockManager& blocks)
         : World(name, plugins, blocks)
     {
@@ -87,27 +102,108 @@ public:
         mLoadRange = x + 1;
     }
 
-    // Build/Destroy VBO
-    void renderUpdate(const Vec3i& position);
-    // Render all chunks
-    size_t render(const Vec3i& position) const;
+    // Chunks further (Chebyshev) from the player's chunk are unloaded
+    int getLoadRange() const noexcept { return mLoadRange; }
+
+    // Chunks at least distances[i] chunks away (Chebyshev) are meshed at level of detail i + 1, with blocks
+    // merged into cubes of 2^(i + 1). A distance below the one before it is raised to it; levels starting
+    // past the render distance are unused.
+    void setLodDistances(const std::array<int, MaxChunkLod>& distances)
+    {
+        mLodDistances = distances;
+        for (int i = 1; i < MaxChunkLod; ++i)
+            mLodDistances[i] = std::max(mLodDistances[i], mLodDistances[i - 1]);
+    }
+
+    // Level of detail for a chunk seen from the chunk center
+    int getLod(const Vec3i& chunkPos, const Vec3i& center) const noexcept
+    {
+        const int distance = center.chebyshevDistance(chunkPos);
+        int lod = 0;
+        while (lod < MaxChunkLod && distance >= mLodDistances[lod])
+            ++lod;
+        return lod;
+    }
+
+    // Switch greedy face merging on or off, rebuilding all chunk meshes. Returns the mode in effect.
+    bool setMergeFace(bool merge)
+    {
+        if (merge != ChunkRenderer::getMergeFace() && ChunkRenderer::setMergeFace(merge))
+            clearMeshes();
+        return ChunkRenderer::getMergeFace();
+    }
+
+    // Switch packed vertexes on or off, rebuilding all chunk meshes. Returns the mode in effect.
+    bool setPackedVertices(bool packed)
+    {
+        if (packed != ChunkRenderer::getPackedVertices() && ChunkRenderer::setPackedVertices(packed))
+            clearMeshes();
+        return ChunkRenderer::getPackedVertices();
+    }
+
+    // Start the mesh builder threads; without any, meshes are built on the render thread in uploadMeshes
+    void startMeshBuilder(size_t threads) { mMeshBuilder.start(threads); }
+    // Queue chunks in range for meshing, destroy VBOs out of range.
+    // Chunks are resolved through the chunk pointer array of the player at position.
+    void renderUpdate(const Vec3i& position, ChunkManager::Cache& cache);
+    // Upload finished meshes into VBOs, about the upload budget per call. Returns the number uploaded.
+    size_t uploadMeshes();
+    // Bytes of meshes uploadMeshes takes at a time, so a burst of finished meshes doesn't stall one frame
+    size_t getMeshUploadBudget() const noexcept { return mMeshUploadBudget; }
+    void setMeshUploadBudget(size_t bytes) noexcept { mMeshUploadBudget = bytes; }
+    ChunkMeshBuilder::Stats getMeshStats() const { return mMeshBuilder.getStats(); }
+    // Render the chunks in range that may be visible from eye. viewProjection is the camera's projection * view
+    // matrix. Translucent faces are drawn last, far chunks first. Returns the number of chunks drawn.
+    size_t render(const Vec3f& eye, const Mat4f& viewProjection);
+    RenderStats getRenderStats() const noexcept { return mRenderStats; }
+    // Skip chunks outside the view frustum
+    bool getFrustumCulling() const noexcept { return mFrustumCulling; }
+    void setFrustumCulling(bool culling) noexcept { mFrustumCulling = culling; }
+    // Skip chunks no path of open blocks leads to from the camera (see ChunkCuller)
+    bool getOcclusionCulling() const noexcept { return mOcclusionCulling; }
+    void setOcclusionCulling(bool culling) noexcept { mOcclusionCulling = culling; }
     // Find the nearest chunks in load range to load, fartherest chunks out of load range to unload
-    void sortChunkLoadUnloadList(const Vec3i& centerPos);
+    void sortChunkLoadUnloadList(const Vec3i& centerPos, ChunkManager::Cache& cache);
 
     void tryLoadChunks(ClientGameConnection& conn);
 
 private:
     // Ranges
     int mRenderDist = 0, mLoadRange = 0;
-    // Chunk Renderers
-    std::unordered_map<Chunk*, ChunkRenderer> mChunkRenderers;
+    // Distance each level of detail starts at; full resolution everywhere by default
+    std::array<int, MaxChunkLod> mLodDistances{ { INT_MAX, INT_MAX, INT_MAX } };
+    // Player chunk position at the last sortChunkLoadUnloadList
+    Vec3i mLoadCenter;
+    // Chunk renderers by position. A chunk replaced in the map keeps the renderer of its position until remeshed.
+    std::unordered_map<Vec3i, ChunkRenderer, ChunkHasher> mChunkRenderers;
     // Chunk load list [position, distance]
     OrderedList<int, Vec3i, MaxChunkLoadCount> mChunkLoadList;
     // Render build list
     OrderedList<int, Chunk*, MaxChunkRenderCount> mChunkRenderList;
+    // Chunks being meshed (the builder's in flight positions), and the chunk each snapshot was taken from
+    std::unordered_map<Vec3i, Chunk*, ChunkHasher> mMeshesInFlight;
+    ChunkMeshBuilder mMeshBuilder;
+    size_t mMeshUploadBudget = 4 << 20;
+    // Culling, and the renderers picked for this frame
+    ChunkCuller mCuller;
+    bool mFrustumCulling = true, mOcclusionCulling = true;
+    std::vector<std::pair<Vec3i, ChunkRenderer*>> mDrawList;
+    RenderStats mRenderStats{};
     // Chunk unload list [pointer, distance]
     OrderedList<int, Chunk*, MaxChunkUnloadCount, std::greater> mChunkUnloadList;
-    bool neighbourChunkLoadCheck(const Vec3i& pos);
+    bool neighbourChunkLoadCheck(const Vec3i& pos, ChunkManager::Cache& cache);
+    // All air, so there is nothing to mesh at any level of detail
+    static bool isAir(const Chunk& chunk)
+    {
+        return chunk.isUniform() && chunk.getBlock(Vec3i(0, 0, 0)).getID() == 0;
+    }
+    // Drop all meshes, built or in flight, so they are rebuilt in the current mode
+    void clearMeshes()
+    {
+        mChunkRenderers.clear();
+        mMeshBuilder.clear();
+        mMeshesInFlight.clear();
+    }
     static constexpr Vec3i middleOffset() noexcept
     { return Vec3i(Chunk::Size() / 2 - 1, Chunk::Size() / 2 - 1, Chunk::Size() / 2 - 1); }
 };
@@ -18,6 +18,7 @@
 */
 
 #define NEWORLD_PLUGIN_CLIENT_SIDE
+#include <string>
 #include "worldgen.h"
 
 int32_t GrassID, RockID, DirtID, SandID, WaterID;
@@ -54,6 +55,7 @@ extern "C"
         if (type & nwPluginTypeServerOnly)
         {
             nwRegisterChunkGenerator(generator);
+            nwRegisterBatchChunkGenerator(batchGenerator);
             GrassID = registerBlock("Grass", true, false, true, 0, 2);
             RockID = registerBlock("Rock", true, false, true, 0, 2);
             DirtID = registerBlock("Dirt", true, false, true, 0, 2);
@@ -87,5 +89,11 @@ extern "C"
     // Unload function
     NWAPIEXPORT void NWAPICALL unload()
     {
+        auto stats = WorldGen::Heights.getStats();
+        if (stats.hits + stats.misses == 0)
+            return;
+        std::string info = "Heightmap cache: " + std::to_string(stats.hits) + " hits, " + std::to_string(stats.misses) + " misses ("
+            + std::to_string(stats.hits * 100 / (stats.hits + stats.misses)) + "% hit rate)";
+        nwLog(&info[0]);
     }
 }
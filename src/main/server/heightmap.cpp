@@ -0,0 +1,54 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "heightmap.h"
+#include "worldgen.h"
+
+void HeightMap::get(int x, int z, int* heights)
+{
+    const uint64_t k = key(x, z);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mTiles.find(k);
+        if (iter != mTiles.end())
+        {
+            ++mHits;
+            mLru.splice(mLru.begin(), mLru, iter->second.lru);
+            std::copy(iter->second.heights.begin(), iter->second.heights.end(), heights);
+            return;
+        }
+        ++mMisses;
+    }
+
+    Tile tile;
+    WorldGen::getHeightTile(x * NWChunkSize, z * NWChunkSize, tile.data());
+    std::copy(tile.begin(), tile.end(), heights);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCapacity == 0 || mTiles.count(k))
+        return;
+    if (mTiles.size() >= mCapacity)
+    {
+        mTiles.erase(mLru.back());
+        mLru.pop_back();
+    }
+    mLru.push_front(k);
+    mTiles.emplace(k, Entry{ tile, mLru.begin() });
+}
@@ -0,0 +1,72 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HEIGHTMAP_H_
+#define HEIGHTMAP_H_
+
+#include <list>
+#include <array>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include "./../../game/api/nwapi.h"
+
+// Caches the terrain heights of chunk columns, so all chunks of a vertical stack share one noise evaluation.
+// Holds at most `capacity` columns and evicts the least recently used one. Thread safe: heights are
+// computed outside the lock, so two threads missing the same column at once may both compute it.
+class HeightMap
+{
+public:
+    using Tile = std::array<int, NWChunkSize * NWChunkSize>;
+
+    struct Stats
+    {
+        uint64_t hits, misses;
+        size_t size;
+    };
+
+    explicit HeightMap(size_t capacity) : mCapacity(capacity) {}
+
+    // Copy the heights of chunk column (x, z) into heights, stored [x][z]
+    void get(int x, int z, int* heights);
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return{ mHits, mMisses, mTiles.size() };
+    }
+
+private:
+    struct Entry
+    {
+        Tile heights;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    mutable std::mutex mMutex;
+    size_t mCapacity;
+    // Most recently used first
+    std::list<uint64_t> mLru;
+    std::unordered_map<uint64_t, Entry> mTiles;
+    uint64_t mHits = 0, mMisses = 0;
+
+    static uint64_t key(int x, int z) noexcept { return (uint64_t(uint32_t(x)) << 32) | uint32_t(z); }
+};
+
+#endif // !HEIGHTMAP_H_
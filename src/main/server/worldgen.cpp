@@ -18,21 +18,32 @@
 */
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include "worldgen.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NEWORLD_WORLDGEN_SSE2
+#endif
+
 int WorldGen::seed = 1025;
 double WorldGen::NoiseScaleX = 64;
 double WorldGen::NoiseScaleZ = 64;
+// 16 MiB, every column within a render distance of 31 chunks
+HeightMap WorldGen::Heights(4096);
 
 extern int32_t GrassID, RockID, DirtID, SandID, WaterID;
 
-// Chunk generator
-void NWAPICALL generator(const NWvec3i *pos, NWblockdata * blocks, int daylightBrightness)
+// Fill one chunk from the heights of its column
+static void fillChunk(const NWvec3i *pos, const int* heights, NWblockdata * blocks, int daylightBrightness)
 {
     for (int x = 0; x < NWChunkSize; x++)
         for (int z = 0; z < NWChunkSize; z++)
         {
-            int absHeight = WorldGen::getHeight(pos->x * NWChunkSize + x, pos->z * NWChunkSize + z);
+            int absHeight = heights[x * NWChunkSize + z];
             int height = absHeight - pos->y * NWChunkSize;
             bool underWater = (absHeight) <= 0;
             for (int y = 0; y < NWChunkSize; y++)
@@ -64,6 +75,34 @@ void NWAPICALL generator(const NWvec3i *pos, NWblockdata * blocks, int daylightB
         }
 }
 
+// Chunk generator
+void NWAPICALL generator(const NWvec3i *pos, NWblockdata * blocks, int daylightBrightness)
+{
+    int heights[NWChunkSize * NWChunkSize];
+    WorldGen::Heights.get(pos->x, pos->z, heights);
+    fillChunk(pos, heights, blocks, daylightBrightness);
+}
+
+// Batch chunk generator: chunks of the same column share one height lookup
+void NWAPICALL batchGenerator(const NWvec3i* positions, NWblockdata* const* blocks, size_t count, int32_t daylightBrightness)
+{
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [positions](size_t a, size_t b)
+    {
+        return positions[a].x != positions[b].x ? positions[a].x < positions[b].x : positions[a].z < positions[b].z;
+    });
+    int heights[NWChunkSize * NWChunkSize];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const NWvec3i& pos = positions[order[i]];
+        if (i == 0 || pos.x != positions[order[i - 1]].x || pos.z != positions[order[i - 1]].z)
+            WorldGen::Heights.get(pos.x, pos.z, heights);
+        fillChunk(&pos, heights, blocks[order[i]], daylightBrightness);
+    }
+}
+
 double WorldGen::InterpolatedNoise(double x, double y)
 {
     int int_X, int_Y;
@@ -92,3 +131,80 @@ double WorldGen::PerlinNoise2D(double x, double y)
     }
     return total;
 }
+
+namespace
+{
+    // total[i] += Interpolate(lo[i], hi[i], f[i]) * amplitude, with the operations in the same order as
+    // the scalar InterpolatedNoise/PerlinNoise2D so that results are bit-identical
+    void accumulateOctave(double* total, const double* lo, const double* hi, const double* f, double amplitude, int count)
+    {
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256d one = _mm256_set1_pd(1.0), amp = _mm256_set1_pd(amplitude);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m256d x = _mm256_loadu_pd(f + i);
+            const __m256d v = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(lo + i), _mm256_sub_pd(one, x)),
+                                            _mm256_mul_pd(_mm256_loadu_pd(hi + i), x));
+            _mm256_storeu_pd(total + i, _mm256_add_pd(_mm256_loadu_pd(total + i), _mm256_mul_pd(v, amp)));
+        }
+#elif defined(NEWORLD_WORLDGEN_SSE2)
+        const __m128d one = _mm_set1_pd(1.0), amp = _mm_set1_pd(amplitude);
+        for (; i + 2 <= count; i += 2)
+        {
+            const __m128d x = _mm_loadu_pd(f + i);
+            const __m128d v = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(lo + i), _mm_sub_pd(one, x)),
+                                         _mm_mul_pd(_mm_loadu_pd(hi + i), x));
+            _mm_storeu_pd(total + i, _mm_add_pd(_mm_loadu_pd(total + i), _mm_mul_pd(v, amp)));
+        }
+#endif
+        for (; i < count; ++i)
+            total[i] += WorldGen::Interpolate(lo[i], hi[i], f[i]) * amplitude;
+    }
+}
+
+void WorldGen::getHeightTile(int x, int y, int* heights)
+{
+    constexpr int size = NWChunkSize;
+    double total[size * size] = {};
+    double frequency = 1, amplitude = 1;
+    int intX[size], intY[size];
+    double fracX[size], fracY[size], lo[size], hi[size];
+    std::vector<double> lattice, row;
+    for (int octave = 0; octave <= 4; octave++)
+    {
+        // Lattice cell and position inside it, per column along each axis
+        for (int i = 0; i < size; i++)
+        {
+            const double nx = (x + i) / NoiseScaleX * frequency, ny = (y + i) / NoiseScaleZ * frequency;
+            intX[i] = int(floor(nx));
+            fracX[i] = nx - intX[i];
+            intY[i] = int(floor(ny));
+            fracY[i] = ny - intY[i];
+        }
+        // Noise at every lattice point the tile touches
+        const int width = intX[size - 1] - intX[0] + 2, height = intY[size - 1] - intY[0] + 2;
+        lattice.resize(width * height);
+        row.resize(height);
+        for (int a = 0; a < width; a++)
+            for (int b = 0; b < height; b++)
+                lattice[a * height + b] = Noise(intX[0] + a, intY[0] + b);
+        for (int i = 0; i < size; i++)
+        {
+            // Interpolate along x once per lattice row, then along y per column
+            const double* left = &lattice[(intX[i] - intX[0]) * height];
+            for (int b = 0; b < height; b++)
+                row[b] = Interpolate(left[b], left[b + height], fracX[i]);
+            for (int j = 0; j < size; j++)
+            {
+                lo[j] = row[intY[j] - intY[0]];
+                hi[j] = row[intY[j] - intY[0] + 1];
+            }
+            accumulateOctave(total + i * size, lo, hi, fracY, amplitude, size);
+        }
+        frequency *= 2;
+        amplitude /= 2.0;
+    }
+    for (int i = 0; i < size * size; i++)
+        heights[i] = int(total[i]) / 2 - 64;
+}
@@ -21,6 +21,7 @@
 #define WORLDGEN_H_
 
 #include "./../../game/api/nwapi.h"
+#include "heightmap.h"
 #include <cmath>
 
 // Perlin Noise 2D
@@ -29,6 +30,8 @@ namespace WorldGen
     extern int seed;
     extern double NoiseScaleX;
     extern double NoiseScaleZ;
+    // Column heights used by the generator
+    extern HeightMap Heights;
 
     inline double Noise(int x, int y)
     {
@@ -50,9 +53,16 @@ namespace WorldGen
     {
         return int(PerlinNoise2D(x / NoiseScaleX, y / NoiseScaleZ)) / 2 - 64;
     }
+
+    // Heights of the NWChunkSize x NWChunkSize columns starting at (x, y), stored [x][y].
+    // Bit-identical to calling getHeight for every column, but evaluates each noise lattice point once
+    // and interpolates a whole row of columns at a time (SSE2/AVX2 when the compiler targets them).
+    // Identical only without fused multiply-adds: the plugin is built with -ffp-contract=off (see worldgen_test).
+    void getHeightTile(int x, int y, int* heights);
 }
 
-// Chunk generator
+// Chunk generators
 void NWAPICALL generator(const NWvec3i* pos, NWblockdata* blocks, int daylightBrightness);
+void NWAPICALL batchGenerator(const NWvec3i* positions, NWblockdata* const* blocks, size_t count, int32_t daylightBrightness);
 
 #endif
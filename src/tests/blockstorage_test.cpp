@@ -0,0 +1,152 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/nwblockstorage.h>
+#include <thread>
+#include <random>
+#include "testing.h"
+
+// PalettedBlockStorage against a flat reference array, and readers racing a writer that keeps
+// widening, compacting and refilling the storage.
+
+namespace
+{
+    constexpr size_t Count = 4096;
+    using Storage = PalettedBlockStorage<Count>;
+
+    bool matches(const Storage& storage, const std::vector<BlockData>& reference)
+    {
+        std::vector<BlockData> flat(Count);
+        storage.copyTo(flat.data());
+        for (size_t i = 0; i < Count; ++i)
+            if (!(storage.get(i) == reference[i]) || !(flat[i] == reference[i]))
+                return false;
+        return true;
+    }
+
+    void testAgainstReference()
+    {
+        Storage storage(BlockData(7));
+        std::vector<BlockData> reference(Count, BlockData(7));
+        CHECK(storage.isUniform() && storage.getMemoryUsage() == 0);
+        std::mt19937 rng(3);
+        // Growing variety up to a few hundred distinct values, so every index width is passed through
+        for (int round = 1; round <= 9; ++round)
+        {
+            const uint32_t distinct = 1u << round;
+            for (int i = 0; i < 3000; ++i)
+            {
+                const size_t index = rng() % Count;
+                const BlockData block(rng() % distinct);
+                storage.set(index, block);
+                reference[index] = block;
+            }
+            CHECK(matches(storage, reference));
+        }
+        CHECK(storage.getBitsPerBlock() == 16);
+        storage.compact();
+        CHECK(matches(storage, reference));
+
+        storage.assign(reference.data());
+        CHECK(matches(storage, reference));
+
+        // Overwriting everything with one value lets compaction return to uniform
+        for (size_t i = 0; i < Count; ++i)
+            storage.set(i, reference[i] = BlockData(1));
+        storage.compact();
+        CHECK(storage.isUniform());
+        CHECK(matches(storage, reference));
+
+        storage.fill(BlockData(9));
+        std::fill(reference.begin(), reference.end(), BlockData(9));
+        CHECK(storage.isUniform() && matches(storage, reference));
+        storage.set(5, reference[5] = BlockData(9));
+        CHECK(storage.isUniform());
+        storage.set(5, reference[5] = BlockData(2));
+        CHECK(storage.getBitsPerBlock() == 1 && storage.getPaletteSize() == 2 && matches(storage, reference));
+    }
+
+    // A full palette with entries no longer used is compacted instead of widened
+    void testFullPaletteCompacts()
+    {
+        Storage storage;
+        storage.set(0, BlockData(1));
+        storage.set(0, BlockData(0));
+        storage.set(0, BlockData(2));
+        CHECK(storage.getBitsPerBlock() == 1);
+        CHECK(storage.get(0) == BlockData(2) && storage.get(1) == BlockData(0));
+    }
+
+    // Writers only ever store values whose low byte is the block index, so any torn or stale read shows
+    void testConcurrentReaders()
+    {
+        Storage storage;
+        std::atomic<bool> stop{ false };
+        std::atomic<size_t> reads{ 0 };
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 2; ++r)
+            readers.emplace_back([&]
+            {
+                std::vector<BlockData> flat(Count);
+                while (!stop)
+                {
+                    EpochReclaimer::Guard guard;
+                    for (size_t i = 0; i < Count; i += 7)
+                    {
+                        const uint32_t value = storage.get(i).getData();
+                        CHECK(value == 0 || (value & 0xff) == (i & 0xff));
+                    }
+                    storage.copyTo(flat.data());
+                    for (size_t i = 0; i < Count; ++i)
+                        CHECK(flat[i].getData() == 0 || (flat[i].getData() & 0xff) == (i & 0xff));
+                    ++reads;
+                }
+            });
+        std::mt19937 rng(5);
+        for (int round = 0; round < 300; ++round)
+        {
+            const uint32_t distinct = 1u << (round % 10);
+            for (int i = 0; i < 200; ++i)
+            {
+                const size_t index = rng() % Count;
+                storage.set(index, BlockData(((rng() % distinct + 1) << 8) | (index & 0xff)));
+            }
+            if (round % 10 == 9)
+                storage.compact();
+            if (round % 50 == 49)
+                storage.fill(BlockData());
+            EpochReclaimer::collect();
+        }
+        stop = true;
+        for (auto&& reader : readers)
+            reader.join();
+        CHECK(reads > 0);
+        for (int i = 0; i < 3; ++i)
+            EpochReclaimer::collect();
+        CHECK(EpochReclaimer::getStats().pending == 0);
+    }
+}
+
+int main()
+{
+    testAgainstReference();
+    testFullPaletteCompacts();
+    testConcurrentReaders();
+    return Testing::result("blockstorage_test");
+}
@@ -0,0 +1,133 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <network/builderpool.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "testing.h"
+
+// Leases go back to the size class their builder's buffer fits, so a large builder used for a small packet
+// stays large and a small one grown by a large packet becomes large. Threads building packets at once each
+// get builders of their own, read back what they built, and create builders only until their pool is warm.
+
+namespace
+{
+    constexpr int LargeBlocks = 16384;
+
+    void buildSmall(flatbuffers::FlatBufferBuilder& fbb, int thread, int i)
+    {
+        const s2c::Vec3 pos(thread, i, -i);
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, 0, static_cast<uint32_t>(i)));
+    }
+
+    bool isSmall(const flatbuffers::FlatBufferBuilder& fbb, int thread, int i)
+    {
+        const s2c::Chunk* packet = s2c::GetChunk(fbb.GetBufferPointer());
+        return packet->pos()->x() == thread && packet->pos()->y() == i && packet->pos()->z() == -i &&
+               packet->uniform() == static_cast<uint32_t>(i) && !packet->blocks();
+    }
+
+    // Well past BuilderPool::SmallLimit
+    void buildLarge(flatbuffers::FlatBufferBuilder& fbb, int thread, int i)
+    {
+        const s2c::Vec3 pos(thread, i, 0);
+        const auto blocks = fbb.CreateVector(std::vector<int32_t>(LargeBlocks, thread * 65536 + i));
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, blocks));
+    }
+
+    bool isLarge(const flatbuffers::FlatBufferBuilder& fbb, int thread, int i)
+    {
+        const s2c::Chunk* packet = s2c::GetChunk(fbb.GetBufferPointer());
+        const auto* blocks = packet->blocks();
+        return packet->pos()->x() == thread && packet->pos()->y() == i && blocks && blocks->size() == LargeBlocks &&
+               blocks->Get(0) == thread * 65536 + i && blocks->Get(LargeBlocks - 1) == thread * 65536 + i;
+    }
+}
+
+int main()
+{
+    using SizeClass = BuilderPool::SizeClass;
+    {
+        const BuilderPool::Stats start = BuilderPool::getStats();
+        auto created = [&start] { return BuilderPool::getStats().created - start.created; };
+        {
+            auto large = BuilderPool::acquire(SizeClass::Large);
+            buildSmall(*large, 0, 1);
+            CHECK(isSmall(*large, 0, 1));
+        }
+        // The large builder only held a small packet but stays large
+        {
+            auto small = BuilderPool::acquire(SizeClass::Small);
+            CHECK(created() == 2);
+        }
+        {
+            auto large = BuilderPool::acquire(SizeClass::Large);
+            CHECK(created() == 2);
+        }
+        // A small builder grown by a large packet goes back large
+        {
+            auto small = BuilderPool::acquire(SizeClass::Small);
+            buildLarge(*small, 0, 2);
+            CHECK(isLarge(*small, 0, 2));
+        }
+        {
+            auto a = BuilderPool::acquire(SizeClass::Large), b = BuilderPool::acquire(SizeClass::Large);
+            CHECK(created() == 2);
+        }
+        {
+            auto small = BuilderPool::acquire(SizeClass::Small);
+            CHECK(created() == 3);
+        }
+    }
+
+    // Every 16th packet large, as chunk packets among requests
+    const int threads = 4, packets = 20000;
+    const BuilderPool::Stats before = BuilderPool::getStats();
+    std::atomic<int> wrong{ 0 };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+        workers.emplace_back([t, &wrong]
+        {
+            for (int i = 0; i < packets; ++i)
+            {
+                if (i % 16 == 0)
+                {
+                    auto fbb = BuilderPool::acquire(SizeClass::Large);
+                    buildLarge(*fbb, t, i);
+                    wrong += !isLarge(*fbb, t, i);
+                }
+                else
+                {
+                    auto fbb = BuilderPool::acquire();
+                    buildSmall(*fbb, t, i);
+                    wrong += !isSmall(*fbb, t, i);
+                }
+            }
+        });
+    for (auto&& worker : workers)
+        worker.join();
+    const BuilderPool::Stats after = BuilderPool::getStats();
+    CHECK(wrong == 0);
+    CHECK(after.acquired - before.acquired == static_cast<size_t>(threads * packets));
+    // One builder per class per thread, freed as the threads exit
+    CHECK(after.created - before.created == static_cast<size_t>(threads * 2));
+    CHECK(after.destroyed - before.destroyed == after.created - before.created);
+    return Testing::result("builderpool_test");
+}
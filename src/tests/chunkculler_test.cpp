@@ -0,0 +1,128 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/chunkculler.h>
+#include <algorithm>
+#include "testing.h"
+
+// Chunk visibility and culling without a GPU: which faces a chunk connects, the walk over chunks in range
+// with and without occlusion and a frustum, and a chunk reached only by the second face it is entered by.
+
+namespace
+{
+    bool contains(const std::vector<Vec3i>& chunks, const Vec3i& pos)
+    {
+        return std::find(chunks.begin(), chunks.end(), pos) != chunks.end();
+    }
+}
+
+int main()
+{
+    using V = ChunkVisibility;
+    PluginManager plugins;
+    BlockManager blocks;
+    const uint32_t stone = static_cast<uint32_t>(blocks.registerBlock(BlockType("Stone", true, false, true, 0, 2)));
+    World world("test", plugins, blocks);
+    auto visibility = [&](const Vec3i& pos, Chunk* chunk)
+    {
+        world.insertChunk(pos, ChunkManager::data_t(chunk));
+        return V::compute(ChunkSnapshot(ChunkNeighbourhood(world.getChunks(), pos)));
+    };
+
+    // Air and stone
+    CHECK(visibility(Vec3i(0, 0, 0), new Chunk(Vec3i(0, 0, 0), world, BlockData())) == V::All);
+    CHECK(visibility(Vec3i(1, 0, 0), new Chunk(Vec3i(1, 0, 0), world, BlockData(stone, 0, 0))) == 0);
+    // A wall across x splits the chunk in two halves touching everything but the far x face
+    Chunk* wall = new Chunk(Vec3i(2, 0, 0), world, BlockData());
+    Vec3i pos;
+    for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+        for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+            wall->setBlock(Vec3i(Chunk::Size() / 2, pos.y, pos.z), BlockData(stone, 0, 0));
+    uint16_t walled = visibility(Vec3i(2, 0, 0), wall);
+    CHECK(!V::connected(walled, V::PosX, V::NegX));
+    CHECK(V::connected(walled, V::PosY, V::NegY) && V::connected(walled, V::NegX, V::PosZ) && V::connected(walled, V::PosX, V::NegY));
+    // A hole in the wall joins them
+    wall->setBlock(Vec3i(Chunk::Size() / 2, 3, 30), BlockData());
+    world.markNeighboursUpdated(Vec3i(2, 0, 0));
+    walled = V::compute(ChunkSnapshot(ChunkNeighbourhood(world.getChunks(), Vec3i(2, 0, 0))));
+    CHECK(walled == V::All);
+    // A stone chunk with a tunnel along y connects only its ends
+    Chunk* tunnel = new Chunk(Vec3i(3, 0, 0), world, BlockData(stone, 0, 0));
+    for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+        tunnel->setBlock(Vec3i(5, pos.y, 7), BlockData());
+    CHECK(visibility(Vec3i(3, 0, 0), tunnel) == (1u << V::pairBit(V::PosY, V::NegY)));
+
+    ChunkCuller culler;
+    const Vec3i center(10, -4, 7);
+    const int range = 4, width = range * 2 + 1;
+
+    // Without occlusion or frustum every chunk in range, the camera chunk first and nearer walk steps before farther ones
+    const std::vector<Vec3i> all = culler.cull(center, range, nullptr, nullptr);
+    CHECK(all.size() == size_t(width * width * width));
+    CHECK(all.front() == center);
+    for (size_t i = 1; i < all.size(); ++i)
+    {
+        const Vec3i a = all[i - 1] - center, b = all[i] - center;
+        CHECK(std::abs(a.x) + std::abs(a.y) + std::abs(a.z) <= std::abs(b.x) + std::abs(b.y) + std::abs(b.z));
+    }
+
+    // A shell of solid chunks at distance 2 hides everything behind it. Of the shell, the chunks facing the
+    // open ones are drawn, the 44 along its edges and corners (reached only through the shell) are not.
+    const std::vector<Vec3i> shelled = culler.cull(center, range, nullptr, [&](const Vec3i& p)
+    {
+        return center.chebyshevDistance(p) >= 2 ? uint16_t(0) : V::All;
+    });
+    CHECK(shelled.size() == 125 - 44);
+    for (auto&& p : shelled)
+        CHECK(center.chebyshevDistance(p) <= 2);
+    CHECK(contains(shelled, center + Vec3i(1, -1, 1)) && contains(shelled, center + Vec3i(-2, 1, 0)));
+
+    // Only center, +x, +y and the chunk at +x+y are open, the last connecting -x to +x alone. The walk enters
+    // that chunk first by -y from +x, which leads nowhere, and only then by -x from +y, which leads on to +2x+y.
+    const Vec3i px = center + Vec3i(1, 0, 0), py = center + Vec3i(0, 1, 0), pxy = center + Vec3i(1, 1, 0);
+    const std::vector<Vec3i> turned = culler.cull(center, range, nullptr, [&](const Vec3i& p) -> uint16_t
+    {
+        if (p == px || p == py)
+            return V::All;
+        if (p == pxy)
+            return uint16_t(1u << V::pairBit(V::NegX, V::PosX));
+        return 0;
+    });
+    CHECK(contains(turned, pxy));
+    CHECK(contains(turned, center + Vec3i(2, 1, 0)));
+    CHECK(!contains(turned, center + Vec3i(1, 2, 0)));
+    CHECK(std::count(turned.begin(), turned.end(), pxy) == 1);
+
+    // Looking down -z from the middle of the camera chunk: what lies ahead is kept, what lies behind dropped
+    const Vec3f eye(Vec3f(center * Chunk::Size()) + Vec3f(16.0f, 16.0f, 16.0f));
+    const Frustum frustum(Mat4f::perspective(70.0f, 1.0f, 0.1f, 3000.0f) * Mat4f::translation(-eye));
+    CHECK(ChunkCuller::inFrustum(frustum, center + Vec3i(0, 0, -3)));
+    CHECK(!ChunkCuller::inFrustum(frustum, center + Vec3i(0, 0, 3)));
+    const std::vector<Vec3i> ahead = culler.cull(center, range, &frustum, nullptr);
+    CHECK(contains(ahead, center));
+    CHECK(contains(ahead, center + Vec3i(0, 0, -range)));
+    CHECK(contains(ahead, center + Vec3i(1, -1, -3)));
+    CHECK(ahead.size() < all.size() / 2);
+    for (auto&& p : ahead)
+        CHECK(p == center || ChunkCuller::inFrustum(frustum, p));
+    return Testing::result("chunkculler_test");
+}
@@ -0,0 +1,112 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/chunkrenderer.h>
+#include "testing.h"
+
+// Dirty cells decide which y-slab sections of a chunk are meshed again. Each cell maps to the section of
+// its y, replacing all blocks dirties every cell, and setting a block marks only the cells of
+// neighbouring chunks that hold blocks next to it.
+
+namespace
+{
+    uint64_t cell(int x, int y, int z)
+    {
+        return uint64_t(1) << ((x * Chunk::CellsPerAxis() + y) * Chunk::CellsPerAxis() + z);
+    }
+}
+
+int main()
+{
+    // Cells to sections
+    CHECK(ChunkMesh::getSections(0) == 0);
+    CHECK(ChunkMesh::getSections(~uint64_t(0)) == ChunkMesh::AllSections);
+    for (int x = 0; x < Chunk::CellsPerAxis(); ++x)
+        for (int y = 0; y < Chunk::CellsPerAxis(); ++y)
+            for (int z = 0; z < Chunk::CellsPerAxis(); ++z)
+                CHECK(ChunkMesh::getSections(cell(x, y, z)) == 1u << y);
+    CHECK(ChunkMesh::getSections(cell(3, 0, 1) | cell(0, 2, 3) | cell(1, 2, 0)) == 0x5u);
+    // Blocks y 8 to 15 are the second section, whatever their x and z
+    CHECK(ChunkMesh::getSections(Chunk::getCellMask(Vec3i(0, 8, 0), Vec3i(Chunk::Size(), 16, Chunk::Size()))) == 0x2u);
+    CHECK(ChunkMesh::getSections(Chunk::getCellMask(Vec3i(5, 15, 5), Vec3i(6, 17, 6))) == 0x6u);
+
+    PluginManager plugins;
+    BlockManager blocks;
+    World world("test", plugins, blocks);
+    Vec3i d;
+    for (d.x = -1; d.x <= 1; ++d.x)
+        for (d.y = -1; d.y <= 1; ++d.y)
+            for (d.z = -1; d.z <= 1; ++d.z)
+                world.insertChunk(d, ChunkManager::data_t(new Chunk(d, world, BlockData())));
+    ChunkManager& chunks = world.getChunks();
+    auto clean = [&]
+    {
+        for (d.x = -1; d.x <= 1; ++d.x)
+            for (d.y = -1; d.y <= 1; ++d.y)
+                for (d.z = -1; d.z <= 1; ++d.z)
+                    chunks[d].setUpdated(false);
+    };
+
+    // New chunks and whole chunk replacements are dirty everywhere
+    Chunk& centre = chunks[Vec3i(0, 0, 0)];
+    CHECK(centre.isUpdated() && centre.getDirtyCells() == ~uint64_t(0));
+    clean();
+    centre.fill(BlockData(1, 0, 0));
+    CHECK(centre.isUpdated() && centre.getDirtyCells() == ~uint64_t(0));
+    centre.setUpdated(false);
+    std::vector<BlockData> replacement(Chunk::Size() * Chunk::Size() * Chunk::Size());
+    centre.setBlocks(replacement.data());
+    CHECK(centre.isUpdated() && centre.getDirtyCells() == ~uint64_t(0));
+
+    // Within a chunk only the cells of the block and the blocks around it
+    clean();
+    chunks.setBlock(Vec3i(12, 12, 12), BlockData(1, 0, 0));
+    CHECK(centre.getDirtyCells() == cell(1, 1, 1));
+    for (d.x = -1; d.x <= 1; ++d.x)
+        for (d.y = -1; d.y <= 1; ++d.y)
+            for (d.z = -1; d.z <= 1; ++d.z)
+                CHECK(d == Vec3i(0, 0, 0) || (!chunks[d].isUpdated() && chunks[d].getDirtyCells() == 0));
+
+    // On the -x and +z faces: the neighbours across both faces and the edge between them get the cell touching it
+    clean();
+    chunks.setBlock(Vec3i(0, 9, Chunk::Size() - 1), BlockData(1, 0, 0));
+    CHECK(centre.getDirtyCells() == cell(0, 1, 3));
+    CHECK(chunks[Vec3i(-1, 0, 0)].getDirtyCells() == cell(3, 1, 3));
+    CHECK(chunks[Vec3i(0, 0, 1)].getDirtyCells() == cell(0, 1, 0));
+    CHECK(chunks[Vec3i(-1, 0, 1)].getDirtyCells() == cell(3, 1, 0));
+    for (d.x = -1; d.x <= 1; ++d.x)
+        for (d.y = -1; d.y <= 1; ++d.y)
+            for (d.z = -1; d.z <= 1; ++d.z)
+            {
+                const bool touched = d.y == 0 && d.x <= 0 && d.z >= 0;
+                CHECK(chunks[d].isUpdated() == touched);
+                CHECK(ChunkMesh::getSections(chunks[d].getDirtyCells()) == (touched ? 0x2u : 0u));
+            }
+
+    // On the bottom face the chunk below remeshes only its top section
+    clean();
+    chunks.setBlock(Vec3i(7, 0, 20), BlockData(1, 0, 0));
+    CHECK(centre.getDirtyCells() == (cell(0, 0, 2) | cell(1, 0, 2)));
+    CHECK(chunks[Vec3i(0, -1, 0)].getDirtyCells() == (cell(0, 3, 2) | cell(1, 3, 2)));
+    CHECK(ChunkMesh::getSections(chunks[Vec3i(0, -1, 0)].getDirtyCells()) == 1u << (ChunkMesh::SectionCount - 1));
+    CHECK(!chunks[Vec3i(0, 1, 0)].isUpdated() && !chunks[Vec3i(1, 0, 0)].isUpdated());
+    return Testing::result("chunkdirty_test");
+}
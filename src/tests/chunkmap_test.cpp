@@ -0,0 +1,198 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/nwchunk.h>
+#include <thread>
+#include <random>
+#include "testing.h"
+
+// ConcurrentChunkMap under concurrent readers and a writer that keeps erasing, inserting and collecting.
+// Released entries are poisoned and kept instead of freed, so a reader reaching one is caught reliably.
+
+namespace
+{
+    constexpr int Alive = 0x600d, Dead = 0xdead;
+
+    struct Entry
+    {
+        explicit Entry(const Vec3i& position) : pos(position) {}
+        Vec3i pos;
+        std::atomic<int> state{ Alive };
+        const Vec3i& getPosition() const noexcept { return pos; }
+    };
+
+    struct Graveyard
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Entry>> entries;
+    } graveyard;
+
+    struct Release
+    {
+        void operator()(Entry* entry) const
+        {
+            entry->state = Dead;
+            std::lock_guard<std::mutex> lock(graveyard.mutex);
+            graveyard.entries.emplace_back(entry);
+        }
+    };
+
+    using Map = ConcurrentChunkMap<Entry, Release, ChunkHasher>;
+
+    size_t released()
+    {
+        std::lock_guard<std::mutex> lock(graveyard.mutex);
+        return graveyard.entries.size();
+    }
+
+    void testBasics()
+    {
+        Map map;
+        const Vec3i a(3, -2, 7), b(-40, 5, 1000);
+        map.insert(a, new Entry(a), Release());
+        map.insert(b, new Entry(b), Release());
+        CHECK(map.size() == 2);
+        CHECK(map.find(a) && map.find(a)->getPosition() == a);
+        CHECK(map.find(Vec3i(3, -2, 8)) == nullptr);
+        CHECK(map.erase(a));
+        CHECK(!map.erase(a));
+        CHECK(map.find(a) == nullptr);
+        CHECK(map.size() == 1);
+        Entry* replacement = new Entry(b);
+        map.reset(b, replacement, Release());
+        CHECK(map.find(b) == replacement);
+    }
+
+    // Positions 2^21 apart pack to the same key and must still be told apart
+    void testAliasedKeys()
+    {
+        Map map;
+        const Vec3i positions[] = { Vec3i(5, 6, 7), Vec3i(5 + (1 << 21), 6, 7), Vec3i(5, 6 - (1 << 21), 7), Vec3i(5, 6, 7 + (1 << 22)) };
+        for (auto&& pos : positions)
+            map.insert(pos, new Entry(pos), Release());
+        CHECK(map.size() == 4);
+        for (auto&& pos : positions)
+            CHECK(map.find(pos) && map.find(pos)->getPosition() == pos);
+        CHECK(map.erase(positions[1]));
+        CHECK(map.find(positions[0]) && map.find(positions[2]) && map.find(positions[3]));
+        CHECK(map.find(positions[1]) == nullptr);
+    }
+
+    // A guard blocks reclamation however many collects run meanwhile
+    void testGuardBlocksRelease()
+    {
+        std::atomic<bool> done{ false };
+        {
+            EpochReclaimer::Guard guard;
+            std::thread([&] { EpochReclaimer::retire([&] { done = true; }); }).join();
+            for (int i = 0; i < 8; ++i)
+                EpochReclaimer::collect();
+            CHECK(!done);
+        }
+        for (int i = 0; i < 3 && !done; ++i)
+            EpochReclaimer::collect();
+        CHECK(done);
+    }
+
+    void testStress()
+    {
+        constexpr int Range = 12, WriterOps = 300000, Readers = 3;
+        const size_t before = released();
+        size_t inserted = 0;
+        {
+            Map map;
+            std::atomic<bool> stop{ false };
+            std::atomic<size_t> lookups{ 0 }, hits{ 0 };
+            std::vector<std::thread> readers;
+            for (int r = 0; r < Readers; ++r)
+                readers.emplace_back([&, r]
+                {
+                    std::mt19937 rng(r);
+                    std::uniform_int_distribution<int> axis(0, Range - 1);
+                    while (!stop)
+                    {
+                        EpochReclaimer::Guard guard;
+                        // Keep what was found for the whole guard, as a reader working on chunks would
+                        Entry* held[64];
+                        size_t count = 0;
+                        for (int i = 0; i < 64; ++i)
+                        {
+                            const Vec3i pos(axis(rng), axis(rng), axis(rng));
+                            if (Entry* entry = map.find(pos))
+                            {
+                                CHECK(entry->getPosition() == pos);
+                                held[count++] = entry;
+                            }
+                        }
+                        if (r == 0)
+                            map.forEach([&](Entry& entry) { CHECK(entry.state == Alive); });
+                        for (size_t i = 0; i < count; ++i)
+                            CHECK(held[i]->state == Alive);
+                        lookups += 64;
+                        hits += count;
+                    }
+                });
+
+            std::mt19937 rng(42);
+            std::uniform_int_distribution<int> axis(0, Range - 1);
+            for (int op = 0; op < WriterOps; ++op)
+            {
+                const Vec3i pos(axis(rng), axis(rng), axis(rng));
+                if (op % 5 == 0)
+                {
+                    map.reset(pos, new Entry(pos), Release());
+                    ++inserted;
+                }
+                else if (!map.erase(pos))
+                {
+                    map.insert(pos, new Entry(pos), Release());
+                    ++inserted;
+                }
+                // Several collects back to back, as World::update and updateChunkLoadStatus may do
+                if (op % 64 == 0)
+                    for (int i = 0; i < 3; ++i)
+                        map.collect();
+            }
+            stop = true;
+            for (auto&& reader : readers)
+                reader.join();
+            CHECK(lookups > 0);
+            CHECK(hits > 0);
+            std::printf("stress: %zu lookups, %zu hits, %zu inserts\n", lookups.load(), hits.load(), inserted);
+        }
+        // The map released its live entries, everything erased goes once no thread is pinned
+        for (int i = 0; i < 4; ++i)
+            EpochReclaimer::collect();
+        CHECK(EpochReclaimer::getStats().pending == 0);
+        CHECK(released() - before == inserted);
+    }
+}
+
+int main()
+{
+    testBasics();
+    testAliasedKeys();
+    testGuardBlocksRelease();
+    testStress();
+    {
+        std::lock_guard<std::mutex> lock(graveyard.mutex);
+        graveyard.entries.clear();
+    }
+    return Testing::result("chunkmap_test");
+}
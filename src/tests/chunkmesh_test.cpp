@@ -0,0 +1,146 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/chunkrenderer.h>
+#include <algorithm>
+#include "testing.h"
+
+// Blocks whose renderer has no face textures (any shape but a full cube) are left out by GreedyMesher:
+// merged and packed meshes must carry them as fallback quads drawn by their renderer, and only them.
+// At levels of detail every cube face is at most one quad, in every meshing mode.
+
+namespace
+{
+    // Not a full cube as far as the mesher knows: draws itself through renderBlock like a plugin's renderer would
+    class ShapedRenderer : public BlockRenderer
+    {
+    public:
+        void flushTexture() override {}
+        void render(const ChunkSnapshot& chunk, const Vec3i& pos) override { ChunkRenderer::renderBlock(chunk, mTex, pos); }
+    private:
+        BlockTexCoord mTex[6];
+    };
+
+    size_t vertexes(const std::vector<float>& data, const VertexFormat& format)
+    {
+        return data.size() / format.vertexAttributeCount;
+    }
+}
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager blocks;
+    const size_t stone = blocks.registerBlock(BlockType("Stone", true, false, true, 0, 2));
+    const size_t torch = blocks.registerBlock(BlockType("Torch", false, false, false, 0, 0));
+    size_t tiles[6] = { 1, 1, 1, 1, 1, 1 };
+    BlockRendererManager::setBlockRenderer(stone, std::make_shared<DefaultBlockRenderer>(tiles));
+    BlockRendererManager::setBlockRenderer(torch, std::make_shared<ShapedRenderer>());
+
+    World world("test", plugins, blocks);
+    const Vec3i pos(2, -1, 5);
+    Chunk* chunk = world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world, BlockData())));
+    const Vec3i stoneAt(3, 3, 3), torchAt(10, 20, 12);
+    chunk->setBlock(stoneAt, BlockData(static_cast<uint32_t>(stone), 0, 0));
+    chunk->setBlock(torchAt, BlockData(static_cast<uint32_t>(torch), 0, 0));
+    const ChunkSnapshot snapshot{ ChunkNeighbourhood(world.getChunks(), pos) };
+    const int torchSection = torchAt.y / ChunkMesh::SectionHeight;
+    const VertexFormat faceFormat(2, 3, 0, 3);
+
+    // Per face meshes draw both blocks themselves, 6 faces each
+    const ChunkMesh faces = ChunkRenderer::buildMesh(snapshot, false, false);
+    size_t faceVertexes = 0, fallbackVertexes = 0;
+    for (auto&& section : faces.data)
+    {
+        faceVertexes += vertexes(section.opaque, faces.format) + vertexes(section.translucent, faces.format);
+        fallbackVertexes += vertexes(section.fallback, faceFormat);
+    }
+    CHECK(faceVertexes == 48);
+    CHECK(fallbackVertexes == 0);
+
+    for (bool packed : { false, true })
+    {
+        const ChunkMesh mesh = ChunkRenderer::buildMesh(snapshot, true, packed);
+        size_t meshed = 0;
+        for (int s = 0; s < ChunkMesh::SectionCount; ++s)
+        {
+            const ChunkMesh::Section& section = mesh.data[s];
+            meshed += section.packedOpaque.size() + section.packedTranslucent.size() +
+                      vertexes(section.opaque, mesh.format) + vertexes(section.translucent, mesh.format);
+            // The shaped block, and nothing else, in the section it lies in
+            CHECK(vertexes(section.fallback, faceFormat) == (s == torchSection ? 24u : 0u));
+            for (size_t v = 0; v < vertexes(section.fallback, faceFormat); ++v)
+            {
+                const float* coord = section.fallback.data() + (v + 1) * faceFormat.vertexAttributeCount - 3;
+                CHECK(coord[0] >= torchAt.x && coord[0] <= torchAt.x + 1);
+                CHECK(coord[1] >= torchAt.y && coord[1] <= torchAt.y + 1);
+                CHECK(coord[2] >= torchAt.z && coord[2] <= torchAt.z + 1);
+            }
+        }
+        // The cube is meshed as usual, its 6 faces not merging with anything
+        CHECK(meshed == 24);
+        CHECK(mesh.getSize() > 0);
+    }
+
+    // A chunk with no shaped block has no fallback at all
+    chunk->setBlock(torchAt, BlockData());
+    const ChunkMesh plain = ChunkRenderer::buildMesh(ChunkSnapshot(ChunkNeighbourhood(world.getChunks(), pos)), true, true);
+    for (auto&& section : plain.data)
+        CHECK(section.fallback.empty());
+
+    // A cube of 8 blocks a side, lined up with the cubes of every level: 64 quads a face at full resolution,
+    // down to a quad a face once its blocks are one cube. Merged meshes take a quad a face at any level.
+    chunk->setBlock(stoneAt, BlockData());
+    Vec3i block;
+    for (block.x = 8; block.x < 16; ++block.x)
+        for (block.y = 8; block.y < 16; ++block.y)
+            for (block.z = 8; block.z < 16; ++block.z)
+                chunk->setBlock(block, BlockData(static_cast<uint32_t>(stone), 0, 0));
+    for (int lod = 0; lod < 4; ++lod)
+    {
+        const ChunkSnapshot coarse(ChunkNeighbourhood(world.getChunks(), pos), lod);
+        const size_t perFace = (8 >> lod) * (8 >> lod);
+        for (int mode = 0; mode < 3; ++mode)
+        {
+            const bool merge = mode == 1, packed = mode == 2;
+            const ChunkMesh mesh = ChunkRenderer::buildMesh(coarse, merge, packed);
+            size_t quads = 0;
+            float low = 1e9f, high = -1e9f;
+            for (auto&& section : mesh.data)
+            {
+                quads += (section.packedOpaque.size() + vertexes(section.opaque, mesh.format)) / 4;
+                for (size_t v = 0; v < vertexes(section.opaque, mesh.format); ++v)
+                    for (int axis = 1; axis <= 3; ++axis)
+                    {
+                        const float coord = section.opaque[(v + 1) * mesh.format.vertexAttributeCount - axis];
+                        low = std::min(low, coord), high = std::max(high, coord);
+                    }
+            }
+            // Packed meshes are unmerged at full resolution only
+            CHECK(quads == 6 * (mode == 0 || (packed && lod == 0) ? perFace : 1));
+            // Covering the same cube whatever the level
+            if (!packed)
+                CHECK(low == 8.0f && high == 16.0f);
+        }
+    }
+    return Testing::result("chunkmesh_test");
+}
@@ -0,0 +1,149 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunkneighbourhood.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/chunkmeshbuilder.h>
+#include <chrono>
+#include <thread>
+#include "testing.h"
+
+// Without a window: the builder meshes lowest priority value first, on its workers or, without any, inline
+// in poll(). poll() hands out meshes up to its byte budget, one at least. clear() drops meshes queued, ready
+// and still being built. A position has one mesh in flight until poll() returns it.
+
+namespace
+{
+    std::unique_ptr<ChunkSnapshot> snapshot(World& world, const Vec3i& pos)
+    {
+        return std::unique_ptr<ChunkSnapshot>(new ChunkSnapshot(ChunkNeighbourhood(world.getChunks(), pos)));
+    }
+
+    template <class Pred>
+    bool waitFor(Pred pred)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (!pred())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    std::vector<int> xs(const std::vector<ChunkMesh>& meshes)
+    {
+        std::vector<int> result;
+        for (auto&& mesh : meshes)
+            result.push_back(mesh.position.x);
+        return result;
+    }
+}
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager blocks;
+    const size_t stone = blocks.registerBlock(BlockType("Stone", true, false, true, 0, 2));
+    size_t tiles[6] = { 1, 1, 1, 1, 1, 1 };
+    BlockRendererManager::setBlockRenderer(stone, std::make_shared<DefaultBlockRenderer>(tiles));
+
+    // A row of chunks with the same few blocks, so every mesh is the same size
+    World world("test", plugins, blocks);
+    for (int x = 0; x < 8; ++x)
+    {
+        const Vec3i pos(x, 0, 0);
+        Chunk* chunk = world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world, BlockData())));
+        for (int i = 1; i < 8; ++i)
+            chunk->setBlock(Vec3i(i * 3, i * 2, i), BlockData(static_cast<uint32_t>(stone), 0, 0));
+    }
+    const size_t meshSize = ChunkRenderer::buildMesh(*snapshot(world, Vec3i(0, 0, 0)), false, false).getSize();
+    CHECK(meshSize > 0);
+    auto request = [&world](ChunkMeshBuilder& builder, int x, int priority)
+    {
+        return builder.request(snapshot(world, Vec3i(x, 0, 0)), false, false, ChunkMesh::AllSections, priority);
+    };
+
+    // Inline, by priority, one in flight per position
+    {
+        ChunkMeshBuilder builder;
+        CHECK(request(builder, 0, 3));
+        CHECK(request(builder, 1, 1));
+        CHECK(request(builder, 2, 2));
+        CHECK(!request(builder, 1, 0));
+        CHECK(builder.isInFlight(Vec3i(1, 0, 0)) && !builder.isInFlight(Vec3i(3, 0, 0)));
+        CHECK(builder.getStats().queued == 3 && builder.getStats().built == 0);
+        CHECK(xs(builder.poll(SIZE_MAX)) == std::vector<int>({ 1, 2, 0 }));
+        CHECK(builder.getStats().built == 3 && builder.getPending() == 0);
+        CHECK(!builder.isInFlight(Vec3i(1, 0, 0)));
+        CHECK(request(builder, 1, 0));
+    }
+
+    // Inline within the budget: meshing stops once it is reached, one mesh at least
+    {
+        ChunkMeshBuilder builder;
+        for (int x = 0; x < 4; ++x)
+            request(builder, x, x);
+        CHECK(builder.poll(1).size() == 1);
+        CHECK(builder.getStats().queued == 3);
+        CHECK(builder.poll(meshSize * 2).size() == 2);
+        CHECK(builder.poll(0).size() == 1);
+        CHECK(builder.poll(SIZE_MAX).empty());
+    }
+
+    // Workers: by priority when one takes them all, then handed out within the budget
+    {
+        ChunkMeshBuilder builder;
+        const int priorities[] = { 4, 2, 7, 1, 3 };
+        for (int x = 0; x < 5; ++x)
+            request(builder, x, priorities[x]);
+        builder.start(1);
+        CHECK(waitFor([&builder] { return builder.getStats().ready == 5; }));
+        auto meshes = builder.poll(meshSize * 2 + meshSize / 2);
+        CHECK(xs(meshes) == std::vector<int>({ 3, 1 }));
+        meshes = builder.poll(0);
+        CHECK(xs(meshes) == std::vector<int>({ 4 }));
+        meshes = builder.poll(SIZE_MAX);
+        CHECK(xs(meshes) == std::vector<int>({ 0, 2 }));
+        CHECK(builder.getPending() == 0);
+    }
+
+    // clear() while workers mesh: nothing requested before comes out, and positions are free again
+    {
+        ChunkMeshBuilder builder;
+        builder.start(2);
+        for (int round = 0; round < 20; ++round)
+        {
+            for (int x = 0; x < 8; ++x)
+                request(builder, x, x);
+            builder.clear();
+            CHECK(!builder.isInFlight(Vec3i(0, 0, 0)));
+        }
+        CHECK(waitFor([&builder] { auto stats = builder.getStats(); return stats.building == 0 && stats.queued == 0; }));
+        CHECK(builder.poll(SIZE_MAX).empty());
+        CHECK(request(builder, 5, 0));
+        std::vector<ChunkMesh> meshes;
+        CHECK(waitFor([&] { auto polled = builder.poll(SIZE_MAX); meshes.insert(meshes.end(), polled.begin(), polled.end()); return !meshes.empty(); }));
+        CHECK(xs(meshes) == std::vector<int>({ 5 }));
+        builder.stop();
+    }
+    return Testing::result("chunkmeshbuilder_test");
+}
@@ -0,0 +1,169 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <plugin/pluginmanager.h>
+#include <network/chunkpacket.h>
+#include <random>
+#include "terrain.h"
+#include "testing.h"
+
+// Chunk packets decode to the chunk they were encoded from with every codec, for uniform chunks, generated
+// terrain and chunks of more distinct blocks than the palette searches linearly; malformed packets are refused.
+
+namespace
+{
+    constexpr size_t BlockCount = Chunk::Size() * Chunk::Size() * Chunk::Size();
+
+    bool roundTrip(flatbuffers::FlatBufferBuilder& fbb, const Chunk& chunk, ChunkCodec codec, World& world)
+    {
+        static std::vector<BlockData> expected(BlockCount), actual(BlockCount);
+        ChunkPacket::encode(fbb, chunk, codec);
+        std::unique_ptr<Chunk> decoded = ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, world.getBlockTypes().size());
+        if (!decoded || decoded->getPosition() != chunk.getPosition() || decoded->isUniform() != chunk.isUniform())
+            return false;
+        chunk.getBlocks(expected.data());
+        decoded->getBlocks(actual.data());
+        return expected == actual;
+    }
+
+    // Whether a PaletteRle packet of these palette entries and run bytes decodes
+    bool decodesRuns(flatbuffers::FlatBufferBuilder& fbb, const std::vector<uint32_t>& palette, const std::vector<uint8_t>& runs, World& world)
+    {
+        fbb.Clear();
+        const s2c::Vec3 pos(1, 2, 3);
+        const auto paletteOffset = fbb.CreateVector(palette);
+        const auto runsOffset = fbb.CreateVector(runs);
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &pos, 0, 0, static_cast<uint8_t>(ChunkCodec::PaletteRle), paletteOffset, runsOffset));
+        return ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, world.getBlockTypes().size()) != nullptr;
+    }
+
+    // A LEB128 varint, as the runs hold them
+    void varint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager types;
+    Terrain::registerBlocks(types);
+    Terrain::useGenerator();
+    World world("test", plugins, types);
+    flatbuffers::FlatBufferBuilder fbb;
+    const ChunkCodec codecs[] = { ChunkCodec::Raw, ChunkCodec::PaletteRle };
+
+    // Uniform chunks, generated terrain down through the surface, and noise of blocks and brightness
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    chunks.emplace_back(new Chunk(Vec3i(0, 5, 0), world, BlockData()));
+    chunks.emplace_back(new Chunk(Vec3i(0, -9, 0), world, BlockData(static_cast<uint32_t>(RockID), 0, 0)));
+    size_t terrain = 0;
+    Vec3i pos;
+    for (pos.x = -1; pos.x <= 1; ++pos.x)
+        for (pos.y = -4; pos.y <= 1; ++pos.y)
+            for (pos.z = -1; pos.z <= 1; ++pos.z)
+            {
+                chunks.emplace_back(new Chunk(pos, world));
+                terrain += !chunks.back()->isUniform();
+            }
+    CHECK(terrain > 0);
+    std::mt19937 random(1);
+    std::vector<BlockData> noise(BlockCount);
+    for (auto&& block : noise)
+        block = BlockData(random() % types.size(), random() % 16, random() % 4);
+    chunks.emplace_back(new Chunk(Vec3i(-7, 3, 11), world, noise.data()));
+    for (auto&& chunk : chunks)
+        for (ChunkCodec codec : codecs)
+            CHECK(roundTrip(fbb, *chunk, codec, world));
+
+    // Runs compress terrain well below the raw ints
+    for (auto&& chunk : chunks)
+        if (!chunk->isUniform() && chunk.get() != chunks.back().get())
+        {
+            ChunkPacket::encode(fbb, *chunk, ChunkCodec::Raw);
+            const size_t raw = fbb.GetSize();
+            ChunkPacket::encode(fbb, *chunk, ChunkCodec::PaletteRle);
+            CHECK(fbb.GetSize() * 10 < raw);
+        }
+
+    // Malformed raw packets: too few blocks, unknown block ids, an unknown codec
+    const s2c::Vec3 packetPos(1, 2, 3);
+    {
+        fbb.Clear();
+        const auto blocks = fbb.CreateVector(std::vector<int32_t>(100, 0));
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &packetPos, blocks));
+        CHECK(!ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, types.size()));
+    }
+    {
+        std::vector<int32_t> ints(BlockCount, 0);
+        ints[BlockCount / 2] = static_cast<int32_t>(types.size());
+        fbb.Clear();
+        const auto blocks = fbb.CreateVector(ints);
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &packetPos, blocks));
+        CHECK(!ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, types.size()));
+    }
+    {
+        fbb.Clear();
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &packetPos, 0, BlockData(static_cast<uint32_t>(types.size()), 0, 0).getData()));
+        CHECK(!ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, types.size()));
+        fbb.Clear();
+        s2c::FinishChunkBuffer(fbb, s2c::CreateChunk(fbb, &packetPos, 0, 0, 7));
+        CHECK(!ChunkPacket::decode(*s2c::GetChunk(fbb.GetBufferPointer()), world, types.size()));
+    }
+
+    // Malformed runs around one that fills the chunk with two blocks
+    const std::vector<uint32_t> palette = { BlockData(0, 15, 0).getData(), BlockData(static_cast<uint32_t>(RockID), 0, 0).getData() };
+    std::vector<uint8_t> runs;
+    varint(runs, 1), varint(runs, BlockCount / 2 - 1), varint(runs, 0), varint(runs, BlockCount / 2 - 1);
+    CHECK(decodesRuns(fbb, palette, runs, world));
+    // Truncated, inside the last varint and before the last run
+    CHECK(!decodesRuns(fbb, palette, std::vector<uint8_t>(runs.begin(), runs.end() - 1), world));
+    CHECK(!decodesRuns(fbb, palette, std::vector<uint8_t>(runs.begin(), runs.begin() + runs.size() / 2), world));
+    // Bytes after the last run
+    std::vector<uint8_t> trailing = runs;
+    trailing.push_back(0);
+    CHECK(!decodesRuns(fbb, palette, trailing, world));
+    // A palette index past the palette, a block id past the block types, no palette at all
+    std::vector<uint8_t> badIndex;
+    varint(badIndex, 2), varint(badIndex, BlockCount - 1);
+    CHECK(!decodesRuns(fbb, palette, badIndex, world));
+    CHECK(!decodesRuns(fbb, { BlockData(static_cast<uint32_t>(types.size()), 0, 0).getData() }, { 0, 0 }, world));
+    CHECK(!decodesRuns(fbb, {}, runs, world));
+    // Runs longer than the chunk, alone or added up
+    std::vector<uint8_t> tooLong;
+    varint(tooLong, 0), varint(tooLong, BlockCount);
+    CHECK(!decodesRuns(fbb, palette, tooLong, world));
+    std::vector<uint8_t> overflowing = runs;
+    varint(overflowing, 0), varint(overflowing, 0);
+    CHECK(!decodesRuns(fbb, palette, overflowing, world));
+    // A varint of more than 32 bits
+    CHECK(!decodesRuns(fbb, palette, { 0, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F }, world));
+
+    // The best codec both sides know
+    const uint8_t both[] = { 0, 1 }, rawOnly[] = { 0 }, unknown[] = { 9 };
+    CHECK(ChunkPacket::negotiate(both, 2) == ChunkCodec::PaletteRle);
+    CHECK(ChunkPacket::negotiate(rawOnly, 1) == ChunkCodec::Raw);
+    CHECK(ChunkPacket::negotiate(unknown, 1) == ChunkCodec::Raw);
+    CHECK(ChunkPacket::negotiate(nullptr, 0) == ChunkCodec::Raw);
+    return Testing::result("chunkpacket_test");
+}
@@ -0,0 +1,91 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <plugin/pluginmanager.h>
+#include "testing.h"
+
+// Lookups through an observer's chunk pointer array agree with the chunk map, and an array never
+// returns a chunk that was erased or replaced, even one it cached before.
+
+namespace
+{
+    Chunk* addChunk(World& world, const Vec3i& pos, int id)
+    {
+        return world.insertChunk(pos, ChunkManager::data_t(new Chunk(pos, world, BlockData(id, 0, 0))));
+    }
+}
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager blocks;
+    World world("test", plugins, blocks);
+    ChunkManager& chunks = world.getChunks();
+    ChunkManager::Cache cache;
+
+    const Vec3i center(-3, 7, 1 << 20);
+    Chunk* near = addChunk(world, center + Vec3i(1, 0, -2), 1);
+    // Same slot as `near` in the ring buffer, but out of range
+    Chunk* far = addChunk(world, center + Vec3i(1 + ChunkManager::Cache::Size, 0, -2), 2);
+
+    // Nothing is cached before the centre is set
+    CHECK(chunks.find(near->getPosition(), cache) == near);
+    cache.setCenter(center);
+    CHECK(chunks.find(near->getPosition(), cache) == near);
+    CHECK(chunks.find(near->getPosition(), cache) == near);
+    CHECK(chunks.find(far->getPosition(), cache) == far);
+    CHECK(chunks.find(near->getPosition(), cache) == near);
+    CHECK(chunks.find(center, cache) == nullptr);
+    CHECK(world.getBlock(near->getPosition() * Chunk::Size(), cache).getID() == 1);
+    CHECK(world.getBlock(far->getPosition() * Chunk::Size(), cache).getID() == 2);
+
+    // Erasing drops it from the array
+    const Vec3i nearPos = near->getPosition();
+    world.deleteChunk(nearPos);
+    CHECK(chunks.find(nearPos, cache) == nullptr);
+    CHECK(!world.isChunkLoaded(nearPos, cache));
+
+    // A replaced chunk is not returned either, nor is the new one before it is looked up
+    Chunk* first = addChunk(world, nearPos, 3);
+    CHECK(chunks.find(nearPos, cache) == first);
+    Chunk* second = addChunk(world, nearPos, 4);
+    CHECK(chunks.find(nearPos, cache) == second);
+    Chunk* third = new Chunk(nearPos, world, BlockData(5, 0, 0));
+    world.resetChunk(nearPos, third);
+    CHECK(chunks.find(nearPos, cache) == third);
+    CHECK(world.getBlock(nearPos * Chunk::Size(), cache).getID() == 5);
+
+    // Every lookup agrees with the map while chunks come and go
+    for (int i = 0; i < 2000; ++i)
+    {
+        const Vec3i pos = center + Vec3i(i % 5 - 2, i / 5 % 5 - 2, i / 25 % 5 - 2);
+        if (i % 7 == 0)
+            world.deleteChunk(pos);
+        else if (i % 3 == 0 && !chunks.find(pos))
+            addChunk(world, pos, 1);
+        CHECK(chunks.find(pos, cache) == chunks.find(pos));
+    }
+    chunks.collect();
+
+    // Moving the observer away leaves nothing stale behind
+    cache.setCenter(center + Vec3i(ChunkManager::Cache::Size));
+    CHECK(chunks.find(far->getPosition(), cache) == far);
+    return Testing::result("chunkpointerarray_test");
+}
@@ -0,0 +1,171 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <network/chunkrequests.h>
+#include <map>
+#include <random>
+#include <unordered_set>
+#include "testing.h"
+
+// Requests are made once until answered, and again only when not acknowledged in time or refused, and only
+// while still wanted. A stand-in server that acknowledges at once but answers slowly never gets a request twice.
+
+namespace
+{
+    using Clock = ChunkRequestTracker::Clock;
+    using std::chrono::milliseconds;
+}
+
+int main()
+{
+    // Offsets reach INT8_MAX chunks each way
+    {
+        const Vec3i centre(1000, -5, -300);
+        const std::vector<Vec3i> positions{ { 1000, -5, -300 }, { 1127, -132, -173 }, { 873, 122, -427 } };
+        std::vector<int8_t> offsets;
+        for (auto&& pos : positions)
+        {
+            CHECK(ChunkOffsets::fits(centre, pos));
+            ChunkOffsets::append(centre, pos, offsets);
+        }
+        CHECK(!ChunkOffsets::fits(centre, Vec3i(1128, -5, -300)));
+        std::vector<Vec3i> read;
+        // The partial triple at the end is ignored
+        offsets.push_back(1);
+        ChunkOffsets::forEach(centre, offsets.data(), offsets.size(), [&read](const Vec3i& pos) { read.push_back(pos); });
+        CHECK(read == positions);
+    }
+
+    const auto all = [](const Vec3i&) { return true; };
+    const Clock::time_point start = Clock::now();
+
+    // New requests once each, in order; then retried with the timeout doubling while not acknowledged
+    {
+        ChunkRequestTracker tracker;
+        tracker.request(Vec3i(0, 0, 0));
+        tracker.request(Vec3i(1, 0, 0));
+        tracker.request(Vec3i(0, 0, 0));
+        CHECK(tracker.collect(start, all) == std::vector<Vec3i>({ Vec3i(0, 0, 0), Vec3i(1, 0, 0) }));
+        CHECK(tracker.collect(start + milliseconds(999), all).empty());
+        CHECK(tracker.answer(Vec3i(1, 0, 0)));
+        CHECK(!tracker.answer(Vec3i(1, 0, 0)));
+        CHECK(tracker.collect(start + milliseconds(1000), all) == std::vector<Vec3i>({ Vec3i(0, 0, 0) }));
+        CHECK(tracker.collect(start + milliseconds(2999), all).empty());
+        CHECK(tracker.collect(start + milliseconds(3000), all).size() == 1);
+        const ChunkRequestTracker::Stats stats = tracker.getStats();
+        CHECK(stats.outstanding == 1 && stats.sent == 4 && stats.retried == 2 && stats.answered == 1);
+    }
+
+    // Acknowledged: no timeout, however long the answer takes
+    {
+        ChunkRequestTracker tracker;
+        tracker.request(Vec3i(0, 0, 0));
+        CHECK(!tracker.acknowledge(Vec3i(0, 0, 0)));
+        tracker.collect(start, all);
+        CHECK(tracker.acknowledge(Vec3i(0, 0, 0)));
+        CHECK(!tracker.acknowledge(Vec3i(5, 0, 0)));
+        CHECK(tracker.collect(start + std::chrono::hours(1), all).empty());
+        CHECK(tracker.answer(Vec3i(0, 0, 0)));
+        CHECK(tracker.getStats().outstanding == 0 && tracker.getStats().retried == 0);
+    }
+
+    // Refused, even after an acknowledgement: asked again MaxTimeout after the refusal, if still wanted
+    {
+        ChunkRequestTracker tracker;
+        tracker.request(Vec3i(0, 0, 0));
+        tracker.request(Vec3i(1, 0, 0));
+        tracker.collect(start, all);
+        tracker.acknowledge(Vec3i(0, 0, 0));
+        const Clock::time_point refused = start + milliseconds(500);
+        CHECK(tracker.refuse(Vec3i(0, 0, 0), refused));
+        CHECK(tracker.refuse(Vec3i(1, 0, 0), refused));
+        CHECK(tracker.collect(refused + ChunkRequestTracker::MaxTimeout - milliseconds(1), all).empty());
+        auto wanted = [](const Vec3i& pos) { return pos.x == 0; };
+        CHECK(tracker.collect(refused + ChunkRequestTracker::MaxTimeout, wanted) == std::vector<Vec3i>({ Vec3i(0, 0, 0) }));
+        CHECK(tracker.getStats().outstanding == 1 && tracker.getStats().refused == 2);
+    }
+
+    // A stand-in server, one tick of 16 ms at a time: it acknowledges requests at once and answers them
+    // after up to 20 s, past MaxTimeout. The player moves away, and the requests of the first ticks after
+    // are refused as the server still has it where it was; then it moves back, past the chunks unloaded.
+    {
+        ChunkRequestTracker tracker;
+        std::mt19937 rng(1);
+        std::uniform_int_distribution<int> delay(1, 1250);
+        const int range = 4;
+        Vec3i player(0, 0, 0);
+        std::unordered_set<Vec3i, ChunkHasher> loaded;
+        std::map<int, std::vector<Vec3i>> answers;
+        std::unordered_set<Vec3i, ChunkHasher> taken;
+        size_t duplicates = 0, refusals = 0;
+        Clock::time_point now = start;
+        int tick = 0;
+        for (; tick < 10000; ++tick, now += milliseconds(16))
+        {
+            if (tick == 50)
+                player = Vec3i(range * 2, 0, 0);
+            else if (tick == 700)
+                player = Vec3i(0, 0, 0);
+            // The world client: unload out of range, load and request in range. Chunks loaded again are
+            // requested again.
+            for (auto iter = loaded.begin(); iter != loaded.end();)
+            {
+                if (player.chebyshevDistance(*iter) <= range)
+                {
+                    ++iter;
+                    continue;
+                }
+                taken.erase(*iter);
+                iter = loaded.erase(iter);
+            }
+            for (int x = -range; x <= range; ++x)
+                for (int y = -range; y <= range; ++y)
+                    for (int z = -range; z <= range; ++z)
+                    {
+                        const Vec3i pos(player.x + x, player.y + y, player.z + z);
+                        if (loaded.insert(pos).second)
+                            tracker.request(pos);
+                    }
+            for (auto&& pos : tracker.collect(now, [&loaded](const Vec3i& pos) { return loaded.count(pos) > 0; }))
+            {
+                // Near where the player was, beyond where it is
+                if (tick >= 50 && tick < 52 && pos.x < range * 2)
+                {
+                    tracker.refuse(pos, now);
+                    ++refusals;
+                    continue;
+                }
+                duplicates += !taken.insert(pos).second;
+                tracker.acknowledge(pos);
+                answers[tick + delay(rng)].push_back(pos);
+            }
+            for (auto&& pos : answers[tick])
+                tracker.answer(pos);
+            answers.erase(tick);
+            if (tick > 700 && answers.empty() && tracker.getStats().outstanding == 0)
+                break;
+        }
+        const ChunkRequestTracker::Stats stats = tracker.getStats();
+        CHECK(tick < 10000);
+        CHECK(stats.outstanding == 0);
+        CHECK(duplicates == 0);
+        CHECK(refusals > 0 && stats.retried == refusals);
+    }
+    return Testing::result("chunkrequests_test");
+}
@@ -0,0 +1,97 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <network/chunksendqueue.h>
+#include <set>
+#include <vector>
+#include "testing.h"
+
+// The queue sends the nearest chunks first within the budget, drops those past the client's load range when
+// their turn comes and names them for the client, and counts those the sender found unloaded apart so they
+// can be loaded and pushed again.
+
+namespace
+{
+    constexpr size_t ChunkBytes = 100;
+}
+
+int main()
+{
+    {
+        ChunkSendQueue queue(ChunkBytes * 2, 4);
+        for (int x = 3; x >= 0; --x)
+            queue.push(Vec3i(x, 0, 0));
+        queue.push(Vec3i(2, 0, 0));
+        CHECK(queue.getStats().queued == 4);
+        std::vector<Vec3i> sent;
+        auto send = [&sent](const Vec3i& pos) { sent.push_back(pos); return ChunkBytes; };
+        CHECK(queue.flush(send) == 2);
+        CHECK(sent.size() == 2 && sent[0] == Vec3i(0, 0, 0) && sent[1] == Vec3i(1, 0, 0));
+        CHECK(queue.flush(send) == 2);
+        CHECK(queue.getStats().queued == 0 && queue.getStats().sent == 4 && queue.getStats().sentBytes == ChunkBytes * 4);
+    }
+
+    // Past the range set before the client's handshake, within the load range it gives
+    {
+        ChunkSendQueue queue(0, 2);
+        for (int x = 0; x <= 6; ++x)
+            queue.push(Vec3i(x, 0, 0));
+        CHECK(!queue.inRange(Vec3i(0, 3, 0)));
+        queue.setRange(4);
+        CHECK(queue.inRange(Vec3i(0, 3, 0)) && !queue.inRange(Vec3i(0, 0, -5)));
+        std::set<int> sent, dropped;
+        queue.flush([&sent](const Vec3i& pos) { sent.insert(pos.x); return ChunkBytes; },
+                    [&dropped](const Vec3i& pos) { dropped.insert(pos.x); });
+        CHECK(sent == std::set<int>({ 0, 1, 2, 3, 4 }));
+        CHECK(dropped == std::set<int>({ 5, 6 }));
+        CHECK(queue.getStats().dropped == 2 && queue.getStats().reloaded == 0);
+
+        // The player moved: in range of it again, so kept
+        queue.push(Vec3i(8, 0, 0));
+        queue.push(Vec3i(-1, 0, 0));
+        queue.setObserver(Vec3i(5, 0, 0));
+        sent.clear();
+        queue.flush([&sent](const Vec3i& pos) { sent.insert(pos.x); return ChunkBytes; });
+        CHECK(sent == std::set<int>({ 8 }));
+        CHECK(queue.getStats().dropped == 3);
+    }
+
+    // Unloaded on the server while it waited: counted apart, and queued again once pushed again
+    {
+        ChunkSendQueue queue(0, 4);
+        queue.push(Vec3i(0, 0, 0));
+        queue.push(Vec3i(1, 0, 0));
+        std::vector<Vec3i> unloaded;
+        CHECK(queue.flush([&unloaded](const Vec3i& pos) -> size_t
+        {
+            if (pos.x == 1)
+            {
+                unloaded.push_back(pos);
+                return 0;
+            }
+            return ChunkBytes;
+        }) == 1);
+        CHECK(unloaded.size() == 1 && queue.getStats().reloaded == 1 && queue.getStats().dropped == 0);
+        for (auto&& pos : unloaded)
+            queue.push(pos);
+        CHECK(queue.flush([](const Vec3i&) { return ChunkBytes; }) == 1);
+        CHECK(queue.getStats().sent == 2 && queue.getStats().queued == 0);
+    }
+    return Testing::result("chunksendqueue_test");
+}
@@ -0,0 +1,114 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <renderer/mesharena.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "testing.h"
+
+// Churns an arena kept about 90% full with random section sized allocations and frees, compacting when it
+// fragments, and checks every live range against a shadow copy moved the way ChunkMeshPool copies buffers.
+
+int main()
+{
+    // Freed neighbours merge back into one range
+    {
+        MeshArena arena(100);
+        const MeshArena::Handle a = arena.allocate(30), b = arena.allocate(30), c = arena.allocate(40);
+        CHECK(a != MeshArena::Invalid && b != MeshArena::Invalid && c != MeshArena::Invalid);
+        CHECK(arena.allocate(1) == MeshArena::Invalid);
+        arena.free(a);
+        arena.free(c);
+        CHECK(arena.getStats().freeBlocks == 2);
+        CHECK(arena.fitsAfterCompact(70));
+        arena.free(b);
+        CHECK(arena.isEmpty());
+        CHECK(arena.getStats().freeBlocks == 1 && arena.getStats().largestFree == 100);
+    }
+
+    // Compaction keeps the order of the ranges and leaves one free range at the end
+    {
+        MeshArena arena(100);
+        const MeshArena::Handle a = arena.allocate(20), b = arena.allocate(20), c = arena.allocate(20);
+        arena.free(b);
+        CHECK(arena.getOffset(c) == 40);
+        arena.compact([](size_t from, size_t to, size_t) { CHECK(to <= from); });
+        CHECK(arena.getOffset(a) == 0 && arena.getOffset(c) == 20);
+        CHECK(arena.getStats().freeBlocks == 1 && arena.getStats().largestFree == 60);
+        arena.grow(150);
+        CHECK(arena.getStats().largestFree == 110);
+    }
+
+    constexpr size_t capacity = 1 << 20, operations = 200000;
+    MeshArena arena(capacity);
+    // Each range is filled with its tag
+    std::vector<uint32_t> memory(capacity);
+    std::vector<std::pair<MeshArena::Handle, uint32_t>> live;
+    std::mt19937 random(1);
+    size_t compactions = 0;
+    for (size_t op = 0; op < operations; ++op)
+    {
+        // Hover around the fill level, as a pool buffer of a settled view would
+        const bool fill = arena.getStats().used < capacity * 9 / 10;
+        if (live.empty() || random() % 100 < (fill ? 60u : 40u))
+        {
+            // Sections hold up to a few thousand vertexes
+            const size_t size = 4 + random() % 3000;
+            MeshArena::Handle handle = arena.allocate(size);
+            if (handle == MeshArena::Invalid && arena.fitsAfterCompact(size))
+            {
+                arena.compact([&memory](size_t from, size_t to, size_t n)
+                {
+                    std::copy(memory.begin() + from, memory.begin() + from + n, memory.begin() + to);
+                });
+                ++compactions;
+                handle = arena.allocate(size);
+                CHECK(handle != MeshArena::Invalid);
+            }
+            if (handle == MeshArena::Invalid)
+                continue;
+            CHECK(arena.getOffset(handle) + size <= capacity);
+            const uint32_t tag = static_cast<uint32_t>(op);
+            std::fill_n(memory.begin() + arena.getOffset(handle), size, tag);
+            live.emplace_back(handle, tag);
+        }
+        else
+        {
+            const size_t i = random() % live.size();
+            arena.free(live[i].first);
+            live[i] = live.back();
+            live.pop_back();
+        }
+    }
+    CHECK(compactions > 0);
+    size_t used = 0, mismatches = 0;
+    for (auto&& range : live)
+    {
+        const size_t offset = arena.getOffset(range.first), size = arena.getSize(range.first);
+        used += size;
+        mismatches += static_cast<size_t>(std::count_if(memory.begin() + offset, memory.begin() + offset + size,
+                                                        [&range](uint32_t tag) { return tag != range.second; }));
+    }
+    const MeshArena::Stats stats = arena.getStats();
+    CHECK(mismatches == 0);
+    CHECK(used == stats.used);
+    CHECK(stats.allocations == live.size());
+    return Testing::result("mesharena_test");
+}
@@ -0,0 +1,106 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/blockrenderer.h>
+#include <renderer/greedymesher.h>
+#include <renderer/packedvertex.h>
+#include <random>
+#include <algorithm>
+#include "testing.h"
+
+// GreedyMesher's packed vertexes decode to exactly its floats, merged or not, smoothly lit or not and at every
+// level of detail, and every face shade and corner decodes to its own colour, even where colours collide.
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager blocks;
+    const size_t stone = blocks.registerBlock(BlockType("Stone", true, false, true, 0, 2));
+    const size_t glass = blocks.registerBlock(BlockType("Glass", true, true, false, 0, 2));
+    for (size_t id : { stone, glass })
+    {
+        size_t tiles[6] = { id, id + 1, id + 2, id + 3, id + 4, 1023 };
+        BlockRendererManager::setBlockRenderer(id, std::make_shared<DefaultBlockRenderer>(tiles));
+    }
+
+    // Random caves of both blocks across a whole neighbourhood, with bright and dark air
+    World world("test", plugins, blocks);
+    std::mt19937 random(1);
+    Vec3i d, pos;
+    for (d.x = -1; d.x <= 1; ++d.x)
+        for (d.y = -1; d.y <= 1; ++d.y)
+            for (d.z = -1; d.z <= 1; ++d.z)
+            {
+                Chunk* chunk = world.insertChunk(d, ChunkManager::data_t(new Chunk(d, world, BlockData())));
+                for (pos.x = 0; pos.x < Chunk::Size(); ++pos.x)
+                    for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+                        for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+                        {
+                            const uint32_t roll = random() % 8;
+                            const uint32_t id = roll < 3 ? static_cast<uint32_t>(stone) : roll == 3 ? static_cast<uint32_t>(glass) : 0;
+                            chunk->setBlock(pos, BlockData(id, id ? 0 : random() % 16, 0));
+                        }
+            }
+
+    VertexArray opaque(262144, GreedyMesher::format()), translucent(262144, GreedyMesher::format());
+    const int attributes = GreedyMesher::format().vertexAttributeCount;
+    std::vector<PackedVertex> packedOpaque, packedTranslucent;
+    size_t vertexes = 0;
+    for (int lod = 0; lod < 4; ++lod)
+        for (bool merge : { false, true })
+            for (bool light : { false, true })
+            {
+                const ChunkSnapshot chunk(ChunkNeighbourhood(world.getChunks(), Vec3i(0, 0, 0)), lod);
+                const Vec3i end(Chunk::Size(), Chunk::Size(), Chunk::Size());
+                opaque.clear(), translucent.clear();
+                packedOpaque.clear(), packedTranslucent.clear();
+                GreedyMesher::build(chunk, opaque, translucent, merge, Vec3i(0, 0, 0), end, light);
+                GreedyMesher::build(chunk, packedOpaque, packedTranslucent, merge, Vec3i(0, 0, 0), end, light);
+                for (auto&& pair : { std::make_pair(&opaque, &packedOpaque), std::make_pair(&translucent, &packedTranslucent) })
+                {
+                    const VertexArray* va = pair.first;
+                    const std::vector<PackedVertex>& packed = *pair.second;
+                    CHECK(va->getVertexCount() > 0);
+                    CHECK(packed.size() == va->getVertexCount());
+                    float v[9];
+                    for (size_t i = 0; i < packed.size(); ++i)
+                    {
+                        packed[i].unpack(v);
+                        CHECK(std::equal(v, v + 9, va->getData() + i * attributes));
+                    }
+                    vertexes += packed.size();
+                }
+            }
+    CHECK(vertexes > 100000);
+
+    // Each face and corner unpacks to the colour GreedyMesher gives it, and the rest of the vertex is kept
+    for (int face = 0; face < 6; ++face)
+        for (uint32_t corner = 0; corner < 64; ++corner)
+        {
+            float v[9];
+            PackedVertex::pack(1, 2, 32, 4, 5, 1023, face, static_cast<uint8_t>(corner)).unpack(v);
+            const float colour = VertexLight::colour(VertexLight::FaceShades[face], static_cast<uint8_t>(corner));
+            CHECK(v[3] == colour && v[4] == colour && v[5] == colour);
+            CHECK(v[0] == 4.0f && v[1] == 5.0f && v[2] == 1023.0f && v[6] == 1.0f && v[7] == 2.0f && v[8] == 32.0f);
+        }
+    return Testing::result("packedvertex_test");
+}
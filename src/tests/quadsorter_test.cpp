@@ -0,0 +1,113 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/blockrenderer.h>
+#include <renderer/greedymesher.h>
+#include <renderer/packedvertex.h>
+#include <renderer/quadsorter.h>
+#include <random>
+#include <algorithm>
+#include "testing.h"
+
+// Translucent quads of a chunk of scattered glass come out back to front from eyes inside, on and around
+// the chunk; cells clamp one past the chunk's edges, and the sort is redone only when the eye changes cell,
+// which is what ChunkRenderer::renderTrans goes by.
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager blocks;
+    const size_t glass = blocks.registerBlock(BlockType("Glass", true, true, false, 0, 2));
+    size_t tiles[6] = { glass, glass, glass, glass, glass, glass };
+    BlockRendererManager::setBlockRenderer(glass, std::make_shared<DefaultBlockRenderer>(tiles));
+
+    World world("test", plugins, blocks);
+    Chunk* chunk = world.insertChunk(Vec3i(0, 0, 0), ChunkManager::data_t(new Chunk(Vec3i(0, 0, 0), world, BlockData())));
+    std::mt19937 random(1);
+    Vec3i pos;
+    for (pos.x = 0; pos.x < Chunk::Size(); ++pos.x)
+        for (pos.y = 0; pos.y < Chunk::Size(); ++pos.y)
+            for (pos.z = 0; pos.z < Chunk::Size(); ++pos.z)
+                if (random() % 6 == 0)
+                    chunk->setBlock(pos, BlockData(static_cast<uint32_t>(glass), 0, 0));
+
+    const ChunkSnapshot snapshot(ChunkNeighbourhood(world.getChunks(), Vec3i(0, 0, 0)));
+    const Vec3i begin(0, 0, 0), end(Chunk::Size(), Chunk::Size(), Chunk::Size());
+    VertexArray opaque(262144, GreedyMesher::format()), translucent(262144, GreedyMesher::format());
+    GreedyMesher::build(snapshot, opaque, translucent, false, begin, end);
+    std::vector<Vec3f> centroids;
+    QuadSorter::getCentroids(translucent, centroids);
+    CHECK(centroids.size() == translucent.getVertexCount() / 4 && centroids.size() > 1000);
+
+    // Packed vertexes give the same centres
+    std::vector<PackedVertex> packedOpaque, packedTranslucent;
+    GreedyMesher::build(snapshot, packedOpaque, packedTranslucent, false, begin, end);
+    std::vector<Vec3f> packedCentroids;
+    QuadSorter::getCentroids(packedTranslucent, packedCentroids);
+    CHECK(packedCentroids == centroids);
+
+    // Every quad once, its 4 vertexes in order, farthest first
+    std::vector<uint32_t> indexes;
+    for (const Vec3f& eye : { Vec3f(16.0f, 16.0f, 16.0f), Vec3f(0.5f, 31.5f, 7.0f), Vec3f(-40.0f, 12.0f, 70.0f),
+                              Vec3f(16.0f, 200.0f, 16.0f), Vec3f(32.0f, 0.0f, 32.0f) })
+    {
+        QuadSorter::sort(centroids, eye, indexes);
+        CHECK(indexes.size() == centroids.size() * 4);
+        std::vector<bool> seen(centroids.size());
+        float last = 1e30f;
+        for (size_t i = 0; i < indexes.size(); i += 4)
+        {
+            const uint32_t quad = indexes[i] / 4;
+            CHECK(indexes[i] % 4 == 0 && !seen[quad]);
+            seen[quad] = true;
+            for (uint32_t j = 1; j < 4; ++j)
+                CHECK(indexes[i + j] == indexes[i] + j);
+            const float distance = (centroids[quad] - eye).lengthSqr();
+            CHECK(distance <= last);
+            last = distance;
+        }
+    }
+
+    // Cells of QuadSorter::CellSize blocks inside, one past either end outside
+    const int cells = Chunk::Size() / QuadSorter::CellSize;
+    CHECK(QuadSorter::getCell(Vec3f(0.0f, 7.99f, 8.0f)) == Vec3i(0, 0, 1));
+    CHECK(QuadSorter::getCell(Vec3f(-0.01f, 31.99f, 32.0f)) == Vec3i(-1, cells - 1, cells));
+    CHECK(QuadSorter::getCell(Vec3f(-1000.0f, 1000.0f, 16.0f)) == Vec3i(-1, cells, 2));
+    CHECK(QuadSorter::getCell(Vec3f(-8.5f, 40.0f, 1e9f)) == Vec3i(-1, cells, cells));
+
+    // Sorted on the first use, then again only on entering another cell or after the quads changed
+    QuadSorter::Tracker tracker;
+    CHECK(tracker.update(Vec3f(3.0f, 3.0f, 3.0f)));
+    CHECK(!tracker.update(Vec3f(3.0f, 3.0f, 3.0f)));
+    CHECK(!tracker.update(Vec3f(7.9f, 0.1f, 5.0f)));
+    CHECK(tracker.update(Vec3f(8.1f, 0.1f, 5.0f)));
+    CHECK(!tracker.update(Vec3f(15.0f, 7.0f, 0.0f)));
+    CHECK(tracker.update(Vec3f(7.9f, 7.0f, 0.0f)));
+    // Far away, moving along the same side of the chunk keeps the order
+    CHECK(tracker.update(Vec3f(-50.0f, 100.0f, 16.0f)));
+    CHECK(!tracker.update(Vec3f(-500.0f, 40.0f, 17.0f)));
+    CHECK(tracker.update(Vec3f(-500.0f, 40.0f, 24.0f)));
+    tracker.invalidate();
+    CHECK(tracker.update(Vec3f(-500.0f, 40.0f, 24.0f)));
+    CHECK(!tracker.update(Vec3f(-500.0f, 40.0f, 24.0f)));
+    return Testing::result("quadsorter_test");
+}
@@ -0,0 +1,52 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TERRAIN_H_
+#define TERRAIN_H_
+
+#include <world/nwchunk.h>
+#include <main/server/worldgen.h>
+
+// The main plugin's terrain for tests and benchmarks, without loading the plugin. Executables including
+// this get the generator's sources built in (see release/tests), so include it from one file per executable.
+
+// Block ids the generator fills chunks with
+int32_t GrassID, RockID, DirtID, SandID, WaterID;
+
+namespace Terrain
+{
+    // Register the plugin's block types, as its entry point does
+    inline void registerBlocks(BlockManager& blocks)
+    {
+        GrassID = static_cast<int32_t>(blocks.registerBlock(BlockType("Grass", true, false, true, 0, 2)));
+        RockID = static_cast<int32_t>(blocks.registerBlock(BlockType("Rock", true, false, true, 0, 2)));
+        DirtID = static_cast<int32_t>(blocks.registerBlock(BlockType("Dirt", true, false, true, 0, 2)));
+        SandID = static_cast<int32_t>(blocks.registerBlock(BlockType("Sand", true, false, true, 0, 2)));
+        WaterID = static_cast<int32_t>(blocks.registerBlock(BlockType("Water", false, true, false, 0, 2)));
+    }
+
+    // Make new chunks generate through the plugin's generator
+    inline void useGenerator()
+    {
+        Chunk::ChunkGeneratorLoaded = true;
+        Chunk::ChunkGen = reinterpret_cast<ChunkGenerator*>(&generator);
+    }
+}
+
+#endif // !TERRAIN_H_
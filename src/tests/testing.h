@@ -0,0 +1,58 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TESTING_H_
+#define TESTING_H_
+
+#include <atomic>
+#include <cstdio>
+
+// Checks for the test executables. A failed check is reported and continues; the test then exits non-zero.
+namespace Testing
+{
+    inline std::atomic<int>& failures()
+    {
+        static std::atomic<int> count{ 0 };
+        return count;
+    }
+
+    inline bool check(bool passed, const char* expr, const char* file, int line)
+    {
+        if (!passed)
+        {
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+            ++failures();
+        }
+        return passed;
+    }
+
+    // Exit code for main()
+    inline int result(const char* name)
+    {
+        if (failures())
+            std::fprintf(stderr, "%s: %d checks failed\n", name, failures().load());
+        else
+            std::printf("%s: passed\n", name);
+        return failures() ? 1 : 0;
+    }
+}
+
+#define CHECK(expr) Testing::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+#endif // !TESTING_H_
@@ -0,0 +1,159 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <world/world.h>
+#include <world/nwchunksnapshot.h>
+#include <plugin/pluginmanager.h>
+#include <renderer/blockrenderer.h>
+#include <renderer/chunkrenderer.h>
+#include <renderer/greedymesher.h>
+#include <renderer/packedvertex.h>
+#include <renderer/vertexlight.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include "testing.h"
+
+// Smooth lighting and ambient occlusion of face corners on synthetic chunks: a lone block, a floor by a pillar,
+// an inner corner, a dark cave, a pillar across a chunk border and a dug out block; and that merged, per face
+// and packed meshes light alike.
+
+namespace
+{
+    constexpr int Top = 2;
+
+    // Position and colour of every vertex of a mesh whose vertexes end in colour (3) and position (3)
+    std::vector<std::array<float, 4>> litVertexes(const VertexArray& va)
+    {
+        const size_t attributes = va.getFormat().vertexAttributeCount;
+        std::vector<std::array<float, 4>> vertexes;
+        for (size_t i = 0; i < va.getVertexCount(); ++i)
+        {
+            const float* v = va.getData() + (i + 1) * attributes - 6;
+            vertexes.push_back({ { v[3], v[4], v[5], v[0] } });
+        }
+        std::sort(vertexes.begin(), vertexes.end());
+        return vertexes;
+    }
+
+    // Lowest occlusion and brightness over the corners of a face
+    std::pair<int, int> darkestCorner(const ChunkSnapshot& snapshot, const Vec3i& pos, int face)
+    {
+        const BlockManager& types = snapshot.getWorld()->getBlockTypes();
+        uint8_t corners[4];
+        VertexLight::getCorners(snapshot.getData() + ChunkSnapshot::index(pos.x, pos.y, pos.z), face,
+                                [&types](BlockData data) { return types[data.getID()].isOpaque(); }, corners);
+        int occlusion = 3, light = 15;
+        for (uint8_t corner : corners)
+        {
+            occlusion = std::min(occlusion, VertexLight::getOcclusion(corner));
+            light = std::min(light, VertexLight::getLight(corner));
+        }
+        return{ occlusion, light };
+    }
+}
+
+int main()
+{
+    PluginManager plugins;
+    BlockManager types;
+    const size_t stone = types.registerBlock(BlockType("Stone", true, false, true, 0, 2));
+    size_t tiles[6] = { stone, stone, stone, stone, stone, stone };
+    BlockRendererManager::setBlockRenderer(stone, std::make_shared<DefaultBlockRenderer>(tiles));
+
+    // 27 chunks of daylit air, blocks placed by world position
+    World world("test", plugins, types);
+    const int daylight = world.getDaylightBrightness();
+    Vec3i p;
+    for (p.x = -1; p.x <= 1; ++p.x)
+        for (p.y = -1; p.y <= 1; ++p.y)
+            for (p.z = -1; p.z <= 1; ++p.z)
+                world.insertChunk(p, ChunkManager::data_t(new Chunk(p, world, BlockData(0, daylight, 0))));
+    const BlockData block(static_cast<uint32_t>(stone), 0, 0);
+    // Lone block
+    world.setBlock(Vec3i(4, 4, 4), block);
+    // Floor with a pillar in the middle
+    for (int x = 8; x < 16; ++x)
+        for (int z = 8; z < 16; ++z)
+            world.setBlock(Vec3i(x, 8, z), block);
+    world.setBlock(Vec3i(12, 9, 12), block);
+    // Floor block in the inner corner of two walls
+    world.setBlock(Vec3i(20, 8, 20), block);
+    for (int i = 19; i < 22; ++i)
+    {
+        world.setBlock(Vec3i(19, 9, i), block);
+        world.setBlock(Vec3i(i, 9, 19), block);
+    }
+    // Block in a closed cave of dim air
+    for (int x = 23; x < 28; ++x)
+        for (int y = 20; y < 25; ++y)
+            for (int z = 4; z < 9; ++z)
+            {
+                const bool inside = x > 23 && x < 27 && y > 20 && y < 24 && z > 4 && z < 8;
+                world.setBlock(Vec3i(x, y, z), inside ? BlockData(0, 2, 0) : block);
+            }
+    world.setBlock(Vec3i(25, 21, 6), block);
+    // Block on the chunk's +x edge, a pillar just across it
+    world.setBlock(Vec3i(Chunk::Size() - 1, 12, 4), block);
+    world.setBlock(Vec3i(Chunk::Size(), 13, 4), block);
+
+    {
+        const ChunkSnapshot snapshot(ChunkNeighbourhood(world.getChunks(), Vec3i(0, 0, 0)));
+        CHECK(darkestCorner(snapshot, Vec3i(4, 4, 4), Top) == std::make_pair(3, daylight));
+        CHECK(darkestCorner(snapshot, Vec3i(11, 8, 12), Top) == std::make_pair(2, daylight));
+        CHECK(darkestCorner(snapshot, Vec3i(9, 8, 9), Top) == std::make_pair(3, daylight));
+        CHECK(darkestCorner(snapshot, Vec3i(20, 8, 20), Top) == std::make_pair(0, daylight));
+        CHECK(darkestCorner(snapshot, Vec3i(25, 21, 6), Top) == std::make_pair(3, 2));
+        CHECK(darkestCorner(snapshot, Vec3i(Chunk::Size() - 1, 12, 4), Top) == std::make_pair(2, daylight));
+
+        // Merged quads only join faces with equal corners, so their vertexes repeat those of single faces,
+        // which per face and GreedyMesher meshing light alike
+        VertexArray faces0(262144, VertexFormat(2, 3, 0, 3)), faces1(262144, VertexFormat(2, 3, 0, 3));
+        VertexArray merged0(262144, GreedyMesher::format()), merged1(262144, GreedyMesher::format());
+        VertexArray single0(262144, GreedyMesher::format()), single1(262144, GreedyMesher::format());
+        ChunkRenderer::buildFaces(snapshot, faces0, faces1);
+        GreedyMesher::build(snapshot, merged0, merged1);
+        GreedyMesher::build(snapshot, single0, single1, false);
+        const auto singleVertexes = litVertexes(single0);
+        CHECK(litVertexes(faces0) == singleVertexes);
+        CHECK(merged0.getVertexCount() < single0.getVertexCount());
+        for (auto&& vertex : litVertexes(merged0))
+            CHECK(std::binary_search(singleVertexes.begin(), singleVertexes.end(), vertex));
+
+        std::vector<PackedVertex> packed, packed1;
+        GreedyMesher::build(snapshot, packed, packed1, true, Vec3i(0, 0, 0), Vec3i(Chunk::Size(), Chunk::Size(), Chunk::Size()));
+        CHECK(packed.size() == merged0.getVertexCount());
+        float v[9];
+        for (size_t i = 0; i < packed.size(); ++i)
+        {
+            packed[i].unpack(v);
+            CHECK(std::equal(v, v + 9, merged0.getData() + i * 9));
+        }
+    }
+
+    // Air dug out without a brightness takes daylight, so the floor the pillar stood on is lit again
+    world.setBlock(Vec3i(12, 9, 12), BlockData());
+    CHECK(world.getBlock(Vec3i(12, 9, 12)).getBrightness() == static_cast<uint32_t>(daylight));
+    {
+        const ChunkSnapshot snapshot(ChunkNeighbourhood(world.getChunks(), Vec3i(0, 0, 0)));
+        CHECK(darkestCorner(snapshot, Vec3i(11, 8, 12), Top) == std::make_pair(3, daylight));
+        CHECK(darkestCorner(snapshot, Vec3i(12, 8, 12), Top) == std::make_pair(3, daylight));
+    }
+    return Testing::result("vertexlight_test");
+}
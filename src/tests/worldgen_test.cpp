@@ -0,0 +1,44 @@
+/*
+* NEWorld: A free game with similar rules to Minecraft.
+* Copyright (C) 2016 NEWorld Team
+*
+* This file is part of NEWorld.
+* NEWorld is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* NEWorld is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with NEWorld.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "terrain.h"
+#include "testing.h"
+
+// WorldGen::getHeightTile matches getHeight for every column, across tiles on both sides of the origin
+// and of noise lattice cells. Needs the generator built with -ffp-contract=off, as the plugin is.
+
+int main()
+{
+    int tile[NWChunkSize * NWChunkSize];
+    size_t tiles = 0;
+    for (int cx = -9; cx <= 9; cx += 3)
+        for (int cz = -700; cz <= 700; cz += 77)
+        {
+            const int x = cx * NWChunkSize, z = cz * NWChunkSize;
+            WorldGen::getHeightTile(x, z, tile);
+            int mismatches = 0;
+            for (int i = 0; i < NWChunkSize; i++)
+                for (int j = 0; j < NWChunkSize; j++)
+                    mismatches += tile[i * NWChunkSize + j] != WorldGen::getHeight(x + i, z + j);
+            CHECK(mismatches == 0);
+            ++tiles;
+        }
+    CHECK(tiles > 100);
+    return Testing::result("worldgen_test");
+}